@@ -9,6 +9,7 @@
 #include <stb_image.h>
 
 #include "learnopengl/camera.h"
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -64,7 +65,7 @@ int main() {
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   Shader ourShader(v_shader, f_shader);
 
@@ -103,7 +104,7 @@ int main() {
   unsigned int VBO, VAO;
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &VBO);
-  glBindVertexArray(VAO);
+  glState().bindVertexArray(VAO);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   // position
@@ -117,7 +118,7 @@ int main() {
   unsigned int texture1, texture2;
 
   glGenTextures(1, &texture1);
-  glBindTexture(GL_TEXTURE_2D, texture1);
+  glState().bindTexture(GL_TEXTURE_2D, texture1);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -138,7 +139,7 @@ int main() {
   stbi_image_free(data);
 
   glGenTextures(1, &texture2);
-  glBindTexture(GL_TEXTURE_2D, texture2);
+  glState().bindTexture(GL_TEXTURE_2D, texture2);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -170,10 +171,10 @@ int main() {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glState().activeTexture(0);
+    glState().bindTexture(GL_TEXTURE_2D, texture1);
+    glState().activeTexture(1);
+    glState().bindTexture(GL_TEXTURE_2D, texture2);
 
     // activate shader
     ourShader.use();
@@ -186,7 +187,7 @@ int main() {
     glm::mat4 view = camera.GetViewMatrix();
     ourShader.setMat4("view", view);
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
     for (unsigned int i = 0; i < 10; i += 1) {
       glm::mat4 model = glm::mat4(1.0f);
       model = glm::translate(model, cubePositions[i]);
@@ -202,7 +203,7 @@ int main() {
     glfwPollEvents();
   }
 
-  glDeleteVertexArrays(1, &VAO);
+  glState().deleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
 
   glfwTerminate();
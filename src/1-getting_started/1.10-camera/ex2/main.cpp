@@ -8,6 +8,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -114,7 +115,7 @@ int main() {
   glGenBuffers(1, &VBO);
   glGenBuffers(1, &EBO);
 
-  glBindVertexArray(VAO);
+  glState().bindVertexArray(VAO);
 
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -132,7 +133,7 @@ int main() {
   unsigned int texture1, texture2;
 
   glGenTextures(1, &texture1);
-  glBindTexture(GL_TEXTURE_2D, texture1);
+  glState().bindTexture(GL_TEXTURE_2D, texture1);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -153,7 +154,7 @@ int main() {
   stbi_image_free(data);
 
   glGenTextures(1, &texture2);
-  glBindTexture(GL_TEXTURE_2D, texture2);
+  glState().bindTexture(GL_TEXTURE_2D, texture2);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -180,7 +181,7 @@ int main() {
       glm::vec3(1.3f, -2.0f, -2.5f),  glm::vec3(1.5f, 2.0f, -2.5f),
       glm::vec3(1.5f, 0.2f, -1.5f),   glm::vec3(-1.3f, 1.0f, -1.5f)};
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   // render loop
   while (!glfwWindowShouldClose(window)) {
@@ -189,10 +190,10 @@ int main() {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glState().activeTexture(0);
+    glState().bindTexture(GL_TEXTURE_2D, texture1);
+    glState().activeTexture(1);
+    glState().bindTexture(GL_TEXTURE_2D, texture2);
 
     // activate shader
     ourShader.use();
@@ -209,7 +210,7 @@ int main() {
     ourShader.setMat4("view", view);
     ourShader.setMat4("projection", projection);
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
 
     // Disegna tutti i cubi
     for (unsigned int i = 0; i < 10; i++) {
@@ -228,7 +229,7 @@ int main() {
     glfwPollEvents();
   }
 
-  glDeleteVertexArrays(1, &VAO);
+  glState().deleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
   glDeleteBuffers(1, &EBO);
 
@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <iostream>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -63,7 +64,7 @@ int main() {
   unsigned int VBO, VAO;
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &VBO);
-  glBindVertexArray(VAO);
+  glState().bindVertexArray(VAO);
 
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -76,7 +77,7 @@ int main() {
                         (void *)(3 * sizeof(float)));
   glEnableVertexAttribArray(1);
 
-  glBindVertexArray(0);
+  glState().bindVertexArray(0);
 
   // render loop
   while (!glfwWindowShouldClose(window)) {
@@ -91,16 +92,16 @@ int main() {
     ourShader.setFloat("xOffset", offset);
     ourShader.use();
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 
     // glfw: swap buffers and poll IO events (keyboard, mouse, etc.)
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
 
-  glDeleteVertexArrays(1, &VAO);
+  glState().deleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
 
   glfwTerminate();
@@ -4,6 +4,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -70,7 +71,7 @@ int main() {
   glGenBuffers(1, &VBO);
   glGenBuffers(1, &EBO);
 
-  glBindVertexArray(VAO);
+  glState().bindVertexArray(VAO);
 
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -91,12 +92,12 @@ int main() {
                         (void *)(6 * sizeof(float)));
   glEnableVertexAttribArray(2);
 
-  glBindVertexArray(0);
+  glState().bindVertexArray(0);
 
   // gl: create texture
   unsigned int texture;
   glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  glState().bindTexture(GL_TEXTURE_2D, texture);
   // set the texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -125,11 +126,11 @@ int main() {
     glClear(GL_COLOR_BUFFER_BIT);
 
     // gl: bind texture
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glState().bindTexture(GL_TEXTURE_2D, texture);
 
     // gl: draw container
     ourShader.use();
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
     // glfw: swap buffers and poll IO events (keyboard, mouse, etc.)
@@ -137,7 +138,7 @@ int main() {
     glfwPollEvents();
   }
 
-  glDeleteVertexArrays(1, &VAO);
+  glState().deleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
   glDeleteBuffers(1, &EBO);
 
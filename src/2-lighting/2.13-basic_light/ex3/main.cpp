@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include "learnopengl/camera.h"
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -71,7 +72,7 @@ int main() {
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   Shader lightingShader(v_lighting, f_lighting);
   Shader lightCubeShader(v_cube, f_cube);
@@ -114,7 +115,7 @@ int main() {
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-  glBindVertexArray(cubeVAO);
+  glState().bindVertexArray(cubeVAO);
 
   // position attribute
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
@@ -126,7 +127,7 @@ int main() {
 
   unsigned int lightCubeVAO;
   glGenVertexArrays(1, &lightCubeVAO);
-  glBindVertexArray(lightCubeVAO);
+  glState().bindVertexArray(lightCubeVAO);
 
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
@@ -164,7 +165,7 @@ int main() {
     lightingShader.setMat4("model", model);
 
     // cube
-    glBindVertexArray(cubeVAO);
+    glState().bindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
     // lamp
@@ -176,15 +177,15 @@ int main() {
     model = glm::scale(model, glm::vec3(0.2f));
     lightCubeShader.setMat4("model", model);
 
-    glBindVertexArray(lightCubeVAO);
+    glState().bindVertexArray(lightCubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
     glfwSwapBuffers(window);
     glfwPollEvents();
   }
 
-  glDeleteVertexArrays(1, &cubeVAO);
-  glDeleteVertexArrays(1, &lightCubeVAO);
+  glState().deleteVertexArrays(1, &cubeVAO);
+  glState().deleteVertexArrays(1, &lightCubeVAO);
   glDeleteBuffers(1, &VBO);
 
   glfwTerminate();
@@ -5,6 +5,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/model.h"
 #include "learnopengl/shader.h"
 
@@ -53,7 +54,7 @@ int main() {
 
   stbi_set_flip_vertically_on_load(true);
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   Shader ourShader(v_shader, f_shader);
 
@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include "learnopengl/camera.h"
+#include "learnopengl/gl_state.h"
 #include "learnopengl/model.h"
 #include "learnopengl/shader.h"
 
@@ -73,7 +74,7 @@ int main() {
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   Shader shader(v_shader, f_shader);
   Shader cubeShader(v_cube, f_cube);
@@ -116,10 +117,10 @@ int main() {
     shader.setMat4("model", model);
     shader.setVec3("viewPos", camera.Position);
     shader.setVec3("lightPos", lightPos);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, diffuseMap);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, normalMap);
+    glState().activeTexture(0);
+    glState().bindTexture(GL_TEXTURE_2D, diffuseMap);
+    glState().activeTexture(1);
+    glState().bindTexture(GL_TEXTURE_2D, normalMap);
     renderQuad();
 
     cubeShader.use();
@@ -217,7 +218,7 @@ void renderQuad() {
     // configure plane VAO
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    glState().bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
                  GL_STATIC_DRAW);
@@ -237,9 +238,9 @@ void renderQuad() {
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
                           (void *)(11 * sizeof(float)));
   }
-  glBindVertexArray(quadVAO);
+  glState().bindVertexArray(quadVAO);
   glDrawArrays(GL_TRIANGLES, 0, 6);
-  glBindVertexArray(0);
+  glState().bindVertexArray(0);
 }
 
 unsigned int cubeVAO = 0;
@@ -296,7 +297,7 @@ void renderCube() {
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     // set vertex attributes
-    glBindVertexArray(cubeVAO);
+    glState().bindVertexArray(cubeVAO);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)0);
@@ -307,12 +308,12 @@ void renderCube() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)(6 * sizeof(float)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
   }
   // render
-  glBindVertexArray(cubeVAO);
+  glState().bindVertexArray(cubeVAO);
   glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0);
+  glState().bindVertexArray(0);
 }
 
 void processInput(GLFWwindow *window) {
@@ -371,7 +372,7 @@ unsigned int loadTexture(char const *path) {
     else if (nrComponents == 4)
       format = GL_RGBA;
 
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState().bindTexture(GL_TEXTURE_2D, textureID);
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                  GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -0,0 +1,187 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+// Nothing here may allocate: it runs inside operator new.
+struct ScopeCounters {
+  std::atomic<const char *> Name; //!< NULL until the slot is claimed.
+  std::atomic<unsigned long long> FrameCount, FrameBytes;
+};
+
+ScopeCounters Scopes[MAX_ALLOCATION_SCOPES];
+std::atomic<unsigned int> NumScopes(1); //!< Slot 0 is the unscoped code.
+
+std::atomic<unsigned long long> FrameCount(0), FrameBytes(0);
+std::atomic<unsigned long long> TotalCount(0), TotalBytes(0);
+
+thread_local const char *CurrentScope = NULL;
+
+// Slot of a scope name, claimed the first time the name is seen.
+unsigned int FindScope(const char *Name) {
+  if (!Name) {
+    return 0;
+  }
+
+  for (unsigned int i = 1; i < MAX_ALLOCATION_SCOPES; i++) {
+    const char *SlotName = Scopes[i].Name.load(std::memory_order_acquire);
+    if (SlotName == Name) {
+      return i;
+    }
+    if (!SlotName) {
+      const char *Expected = NULL;
+      if (Scopes[i].Name.compare_exchange_strong(Expected, Name)) {
+        NumScopes.fetch_add(1);
+        return i;
+      }
+      // Claimed meanwhile, maybe by the same name.
+      if (Expected == Name) {
+        return i;
+      }
+    }
+  }
+  return 0;
+}
+
+AllocationStats Load(const std::atomic<unsigned long long> &Count,
+                     const std::atomic<unsigned long long> &Bytes) {
+  AllocationStats Stats;
+  Stats.Count = Count.load(std::memory_order_relaxed);
+  Stats.Bytes = Bytes.load(std::memory_order_relaxed);
+  return Stats;
+}
+} // namespace
+
+bool AllocationTracker::IsEnabled() {
+#ifdef TRACK_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void AllocationTracker::BeginFrame() {
+  FrameCount.store(0, std::memory_order_relaxed);
+  FrameBytes.store(0, std::memory_order_relaxed);
+  for (unsigned int i = 0; i < MAX_ALLOCATION_SCOPES; i++) {
+    Scopes[i].FrameCount.store(0, std::memory_order_relaxed);
+    Scopes[i].FrameBytes.store(0, std::memory_order_relaxed);
+  }
+}
+
+AllocationStats AllocationTracker::GetFrameStats() {
+  return Load(FrameCount, FrameBytes);
+}
+
+AllocationStats AllocationTracker::GetTotalStats() {
+  return Load(TotalCount, TotalBytes);
+}
+
+unsigned int AllocationTracker::GetNumScopes() {
+  return NumScopes.load(std::memory_order_relaxed);
+}
+
+const char *AllocationTracker::GetScopeName(unsigned int Scope) {
+  const char *Name = Scopes[Scope].Name.load(std::memory_order_acquire);
+  return Name ? Name : "unscoped";
+}
+
+AllocationStats AllocationTracker::GetScopeFrameStats(unsigned int Scope) {
+  return Load(Scopes[Scope].FrameCount, Scopes[Scope].FrameBytes);
+}
+
+void AllocationTracker::PrintFrameReport() {
+  if (!IsEnabled()) {
+    printf("Allocations: not tracked, build with the track_allocations "
+           "option\n");
+    return;
+  }
+
+  AllocationStats Frame = GetFrameStats();
+  printf("Allocations: %llu this frame (%llu bytes), %llu in total\n",
+         Frame.Count, Frame.Bytes, GetTotalStats().Count);
+  for (unsigned int i = 0; i < GetNumScopes(); i++) {
+    AllocationStats Scope = GetScopeFrameStats(i);
+    if (Scope.Count > 0) {
+      printf("  %s: %llu (%llu bytes)\n", GetScopeName(i), Scope.Count,
+             Scope.Bytes);
+    }
+  }
+}
+
+void AllocationTracker::Record(size_t Size) {
+  FrameCount.fetch_add(1, std::memory_order_relaxed);
+  FrameBytes.fetch_add(Size, std::memory_order_relaxed);
+  TotalCount.fetch_add(1, std::memory_order_relaxed);
+  TotalBytes.fetch_add(Size, std::memory_order_relaxed);
+
+  ScopeCounters &Scope = Scopes[FindScope(CurrentScope)];
+  Scope.FrameCount.fetch_add(1, std::memory_order_relaxed);
+  Scope.FrameBytes.fetch_add(Size, std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope(const char *Name) {
+  m_Previous = CurrentScope;
+  CurrentScope = Name;
+}
+
+AllocationScope::~AllocationScope() { CurrentScope = m_Previous; }
+
+const char *AllocationScope::GetCurrent() { return CurrentScope; }
+
+#ifdef TRACK_ALLOCATIONS
+// The nothrow forms of operator new and delete end up in these.
+void *operator new(size_t Size) {
+  AllocationTracker::Record(Size);
+  void *p = malloc(Size ? Size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t Size) { return operator new(Size); }
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+// The sized forms, which C++14 compilers call, are replaced along with them.
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+void operator delete[](void *p, size_t) noexcept { operator delete[](p); }
+
+#ifdef __cpp_aligned_new
+// Types aligned beyond __STDCPP_DEFAULT_NEW_ALIGNMENT__ (the alignas(16) SIMD
+// ones on 32-bit targets) use the std::align_val_t forms, which don't forward
+// to the ones above.
+void *operator new(size_t Size, std::align_val_t Alignment) {
+  AllocationTracker::Record(Size);
+  // aligned_alloc wants the size to be a multiple of the alignment.
+  size_t Align = (size_t)Alignment;
+  size_t Rounded = ((Size ? Size : 1) + Align - 1) / Align * Align;
+  void *p = aligned_alloc(Align, Rounded);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t Size, std::align_val_t Alignment) {
+  return operator new(Size, Alignment);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  free(p);
+}
+#endif
+#endif
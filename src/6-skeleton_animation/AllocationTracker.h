@@ -0,0 +1,58 @@
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+#include <stddef.h>
+
+// Most scopes the tracker tells apart, the others count as unscoped.
+#define MAX_ALLOCATION_SCOPES 16
+
+struct AllocationStats {
+  unsigned long long Count; //!< Calls to operator new.
+  unsigned long long Bytes; //!< Bytes requested.
+};
+
+// Counts the heap allocations made through operator new, for the current
+// frame and in total, and attributes them to the AllocationScope active on
+// the allocating thread. The steady state frame is expected to make none.
+//
+// The global operator new is only replaced when building with the
+// track_allocations option, otherwise IsEnabled() is false and every count
+// stays 0. The counters are relaxed atomics, safe from any thread.
+class AllocationTracker {
+public:
+  static bool IsEnabled(); //!< Built with TRACK_ALLOCATIONS.
+
+  static void BeginFrame(); //!< Resets the frame counters.
+
+  static AllocationStats GetFrameStats(); //!< Since the last BeginFrame.
+  static AllocationStats GetTotalStats(); //!< Since the start.
+
+  static unsigned int GetNumScopes(); //!< Scopes seen so far, the first one
+                                      //!< is the unscoped code.
+  static const char *GetScopeName(unsigned int Scope);
+  static AllocationStats
+  GetScopeFrameStats(unsigned int Scope); //!< Since the last BeginFrame.
+
+  static void PrintFrameReport(); //!< Prints the frame counts per scope.
+
+  static void Record(size_t Size); //!< Called by operator new.
+};
+
+// Attributes the allocations of the current thread to a name while alive.
+// The name must outlive the program, a string literal: only the pointer is
+// kept. Scopes nest, the innermost one wins.
+class AllocationScope {
+public:
+  explicit AllocationScope(const char *Name); //!< NULL for unscoped.
+  ~AllocationScope();
+
+  static const char *GetCurrent(); //!< Innermost scope of this thread.
+
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope &operator=(const AllocationScope &) = delete;
+
+private:
+  const char *m_Previous;
+};
+
+#endif
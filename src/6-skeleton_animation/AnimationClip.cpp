@@ -0,0 +1,281 @@
+#include "AnimationClip.h"
+
+#include <algorithm>
+
+AnimationClip::AnimationClip() {
+  m_Duration = 0.0f;
+  m_TicksPerSecond = 0.0f;
+  m_SampleInterval = 0.0f;
+}
+
+void AnimationClip::Load(const aiAnimation *pAnimation,
+                         const std::map<std::string, int> &JointMapping,
+                         unsigned int NumJoints) {
+  m_Duration = (float)pAnimation->mDuration;
+  // Many FBX and Collada exporters leave the rate unset: Assimp reports 0,
+  // which would make every conversion between seconds and ticks divide by 0.
+  m_TicksPerSecond = pAnimation->mTicksPerSecond != 0.0
+                         ? (float)pAnimation->mTicksPerSecond
+                         : DEFAULT_TICKS_PER_SECOND;
+  m_SampleInterval = 0.0f;
+
+  m_Tracks.assign(NumJoints, JointTrack());
+  m_RotationTimes.clear();
+  m_RotationKeys.clear();
+  m_TranslationTimes.clear();
+  m_TranslationKeys.clear();
+
+  for (unsigned int i = 0; i < pAnimation->mNumChannels; i++) {
+    const aiNodeAnim *pNodeAnim = pAnimation->mChannels[i];
+
+    // Channels of nodes that aren't part of the skeleton are dropped.
+    std::map<std::string, int>::const_iterator Joint =
+        JointMapping.find(pNodeAnim->mNodeName.data);
+    if (Joint == JointMapping.end() || pNodeAnim->mNumRotationKeys == 0 ||
+        pNodeAnim->mNumPositionKeys == 0) {
+      continue;
+    }
+    JointTrack &Track = m_Tracks[Joint->second];
+
+    Track.Rotations.First = (unsigned int)m_RotationKeys.size();
+    Track.Rotations.Count = pNodeAnim->mNumRotationKeys;
+    for (unsigned int k = 0; k < pNodeAnim->mNumRotationKeys; k++) {
+      const aiQuatKey &Key = pNodeAnim->mRotationKeys[k];
+      m_RotationTimes.push_back((float)Key.mTime);
+      m_RotationKeys.push_back(
+          Quaternion(Key.mValue.x, Key.mValue.y, Key.mValue.z, Key.mValue.w));
+    }
+
+    Track.Translations.First = (unsigned int)m_TranslationKeys.size();
+    Track.Translations.Count = pNodeAnim->mNumPositionKeys;
+    for (unsigned int k = 0; k < pNodeAnim->mNumPositionKeys; k++) {
+      const aiVectorKey &Key = pNodeAnim->mPositionKeys[k];
+      m_TranslationTimes.push_back((float)Key.mTime);
+      m_TranslationKeys.push_back(
+          Vector3f(Key.mValue.x, Key.mValue.y, Key.mValue.z));
+    }
+  }
+}
+
+void AnimationClip::Resample(float SamplesPerSecond) {
+  if (SamplesPerSecond <= 0.0f || m_SampleInterval > 0.0f) {
+    return;
+  }
+
+  float SampleInterval = m_TicksPerSecond / SamplesPerSecond;
+
+  // The grid covers the whole duration, so the last interval always has a
+  // key on both ends.
+  unsigned int NumSamples =
+      (unsigned int)ceilf(m_Duration / SampleInterval) + 1;
+  NumSamples = std::max(NumSamples, 2u);
+
+  std::vector<Quaternion> RotationKeys;
+  std::vector<Vector3f> TranslationKeys;
+
+  for (unsigned int i = 0; i < m_Tracks.size(); i++) {
+    JointTrack &Track = m_Tracks[i];
+    if (Track.Rotations.Count == 0) {
+      continue;
+    }
+
+    JointTrack Resampled;
+    Resampled.Rotations.First = (unsigned int)RotationKeys.size();
+    Resampled.Rotations.Count = NumSamples;
+    Resampled.Translations.First = (unsigned int)TranslationKeys.size();
+    Resampled.Translations.Count = NumSamples;
+
+    // Sampled in order, so the cursor makes each lookup O(1).
+    KeyCursor Cursor;
+    for (unsigned int k = 0; k < NumSamples; k++) {
+      float Time = std::min(k * SampleInterval, m_Duration);
+      Quaternion Rotation;
+      Vector3f Translation;
+      SampleRotation(i, Time, Cursor, Rotation);
+      SampleTranslation(i, Time, Cursor, Translation);
+      RotationKeys.push_back(Rotation);
+      TranslationKeys.push_back(Translation);
+    }
+    Track = Resampled;
+  }
+
+  // The key times are implicit from now on.
+  m_SampleInterval = SampleInterval;
+  m_RotationKeys.swap(RotationKeys);
+  m_TranslationKeys.swap(TranslationKeys);
+  std::vector<float>().swap(m_RotationTimes);
+  std::vector<float>().swap(m_TranslationTimes);
+}
+
+void AnimationClip::MakeAdditive(float ReferenceTime) {
+  for (unsigned int i = 0; i < m_Tracks.size(); i++) {
+    const JointTrack &Track = m_Tracks[i];
+    if (Track.Rotations.Count == 0) {
+      continue;
+    }
+
+    KeyCursor Cursor;
+    Quaternion Reference;
+    Vector3f ReferenceTranslation;
+    Sample(i, ReferenceTime, Cursor, Reference, ReferenceTranslation);
+
+    // Key = Reference * Delta, so adding the layer on top of another pose is
+    // Pose * Delta.
+    Quaternion Inverse = Reference.Conjugate();
+    for (unsigned int k = 0; k < Track.Rotations.Count; k++) {
+      Quaternion &Key = m_RotationKeys[Track.Rotations.First + k];
+      Key = Inverse * Key;
+      Key.Normalize();
+    }
+    for (unsigned int k = 0; k < Track.Translations.Count; k++) {
+      Vector3f &Key = m_TranslationKeys[Track.Translations.First + k];
+      Key.x -= ReferenceTranslation.x;
+      Key.y -= ReferenceTranslation.y;
+      Key.z -= ReferenceTranslation.z;
+    }
+  }
+}
+
+unsigned int AnimationClip::FindKey(const std::vector<float> &Times,
+                                    const KeyRange &Range, float AnimationTime,
+                                    unsigned int &Cursor, float &Factor) const {
+  assert(Range.Count > 1);
+
+  // Uniform grid: the key index comes straight from the time. The last key is
+  // at the end of the clip, which may be closer than one interval, so the
+  // factor is taken from the real times of the two keys (as GetKeyTimes).
+  if (m_SampleInterval > 0.0f) {
+    float Frame = AnimationTime / m_SampleInterval;
+    unsigned int Index = std::min((unsigned int)Frame, Range.Count - 2);
+    float Start = Index * m_SampleInterval;
+    float End = std::min((Index + 1) * m_SampleInterval, m_Duration);
+    Factor = End > Start ? (AnimationTime - Start) / (End - Start) : 0.0f;
+    return Index;
+  }
+
+  const float *Keys = &Times[Range.First];
+  unsigned int NumKeys = Range.Count;
+
+  // Start from the key found the previous time: during forward playback the
+  // time is either still in the same interval or in the next one. A seek (or
+  // the animation looping back to the start) falls back to a binary search.
+  unsigned int i = Cursor;
+  bool Found = false;
+  if (i + 1 < NumKeys && (i == 0 || Keys[i] <= AnimationTime)) {
+    if (AnimationTime < Keys[i + 1]) {
+      Found = true;
+    } else if (i + 2 < NumKeys && AnimationTime < Keys[i + 2]) {
+      i++;
+      Found = true;
+    }
+  }
+  if (!Found) {
+    // First key after the given time, the last interval is used for times
+    // past the end of the track.
+    const float *Next =
+        std::upper_bound(Keys + 1, Keys + NumKeys - 1, AnimationTime);
+    i = (unsigned int)(Next - Keys) - 1;
+  }
+  Cursor = i;
+
+  // Calculate the elapsed time within the delta time between the two keys.
+  Factor = (AnimationTime - Keys[i]) / (Keys[i + 1] - Keys[i]);
+  return i;
+}
+
+void AnimationClip::SampleRotation(unsigned int Joint, float AnimationTime,
+                                   KeyCursor &Cursor, Quaternion &Out) const {
+  const KeyRange &Range = m_Tracks[Joint].Rotations;
+
+  // we need at least two values to interpolate...
+  if (Range.Count == 1) {
+    Out = m_RotationKeys[Range.First];
+    return;
+  }
+
+  float Factor;
+  unsigned int Index = FindKey(m_RotationTimes, Range, AnimationTime,
+                               Cursor.Rotation, Factor);
+
+  // Interpolate between the two keyframes and normalise.
+  const Quaternion &Start = m_RotationKeys[Range.First + Index];
+  const Quaternion &End = m_RotationKeys[Range.First + Index + 1];
+  Quaternion::Interpolate(Out, Start, End, Factor);
+  Out.Normalize();
+}
+
+void AnimationClip::SampleTranslation(unsigned int Joint, float AnimationTime,
+                                      KeyCursor &Cursor, Vector3f &Out) const {
+  const KeyRange &Range = m_Tracks[Joint].Translations;
+
+  // we need at least two values to interpolate...
+  if (Range.Count == 1) {
+    Out = m_TranslationKeys[Range.First];
+    return;
+  }
+
+  float Factor;
+  unsigned int Index = FindKey(m_TranslationTimes, Range, AnimationTime,
+                               Cursor.Translation, Factor);
+
+  const Vector3f &Start = m_TranslationKeys[Range.First + Index];
+  const Vector3f &End = m_TranslationKeys[Range.First + Index + 1];
+  Out = Start + (End - Start) * Factor;
+}
+
+void AnimationClip::SampleKeys(unsigned int Joint, float AnimationTime,
+                               KeyCursor &Cursor, JointKeys &Out) const {
+  const JointTrack &Track = m_Tracks[Joint];
+
+  unsigned int Index = 0;
+  Out.RotationFactor = 0.0f;
+  if (Track.Rotations.Count > 1) {
+    Index = FindKey(m_RotationTimes, Track.Rotations, AnimationTime,
+                    Cursor.Rotation, Out.RotationFactor);
+  }
+  unsigned int Next = std::min(Index + 1, Track.Rotations.Count - 1);
+  Out.StartRotation = m_RotationKeys[Track.Rotations.First + Index];
+  Out.EndRotation = m_RotationKeys[Track.Rotations.First + Next];
+
+  Index = 0;
+  Out.TranslationFactor = 0.0f;
+  if (Track.Translations.Count > 1) {
+    Index = FindKey(m_TranslationTimes, Track.Translations, AnimationTime,
+                    Cursor.Translation, Out.TranslationFactor);
+  }
+  Next = std::min(Index + 1, Track.Translations.Count - 1);
+  Out.StartTranslation = m_TranslationKeys[Track.Translations.First + Index];
+  Out.EndTranslation = m_TranslationKeys[Track.Translations.First + Next];
+}
+
+void AnimationClip::GetKeyTimes(unsigned int Joint,
+                                std::vector<float> &Times) const {
+  const JointTrack &Track = m_Tracks[Joint];
+  Times.clear();
+
+  if (m_SampleInterval > 0.0f) {
+    for (unsigned int k = 0; k < Track.Rotations.Count; k++) {
+      Times.push_back(std::min(k * m_SampleInterval, m_Duration));
+    }
+    return;
+  }
+
+  // Rotation and translation keys don't have to be at the same times.
+  Times.insert(Times.end(), m_RotationTimes.begin() + Track.Rotations.First,
+               m_RotationTimes.begin() + Track.Rotations.First +
+                   Track.Rotations.Count);
+  Times.insert(Times.end(),
+               m_TranslationTimes.begin() + Track.Translations.First,
+               m_TranslationTimes.begin() + Track.Translations.First +
+                   Track.Translations.Count);
+  std::sort(Times.begin(), Times.end());
+  Times.erase(std::unique(Times.begin(), Times.end()), Times.end());
+}
+
+size_t AnimationClip::GetMemoryUsage() const {
+  return m_Tracks.size() * sizeof(JointTrack) +
+         m_RotationTimes.size() * sizeof(float) +
+         m_RotationKeys.size() * sizeof(Quaternion) +
+         m_TranslationTimes.size() * sizeof(float) +
+         m_TranslationKeys.size() * sizeof(Vector3f);
+}
@@ -0,0 +1,119 @@
+#ifndef ANIMATIONCLIP_H
+#define ANIMATIONCLIP_H
+
+#include "Math3D.h"
+#include <assimp/scene.h> // Output data structure
+#include <map>
+#include <string>
+#include <vector>
+
+// Rate used when the file doesn't give one, as Assimp's own viewer does.
+#define DEFAULT_TICKS_PER_SECOND 25.0f
+
+// Range of the keys of one joint inside the clip's key arrays.
+struct KeyRange {
+  unsigned int First; //!< Index of the first key of the joint.
+  unsigned int Count; //!< Number of keys, 0 if the joint is not animated.
+
+  KeyRange() : First(0), Count(0) {}
+};
+
+// The keys animating a single joint.
+struct JointTrack {
+  KeyRange Rotations;
+  KeyRange Translations;
+};
+
+// Last keys found in a joint track. Forward playback moves from a key to the
+// next one, so the search for the current key starts from here.
+struct KeyCursor {
+  unsigned int Rotation;
+  unsigned int Translation;
+
+  KeyCursor() : Rotation(0), Translation(0) {}
+};
+
+// The two keys around a given time for one joint, interpolated later (and
+// possibly for several joints at once) by the pose evaluator.
+struct JointKeys {
+  Quaternion StartRotation;
+  Quaternion EndRotation;
+  Vector3f StartTranslation;
+  Vector3f EndTranslation;
+  float RotationFactor;    //!< Position between the two rotation keys.
+  float TranslationFactor; //!< Position between the two translation keys.
+};
+
+// Runtime animation clip, extracted from an aiAnimation at load time so the
+// Assimp scene doesn't need to be kept around. Tracks are indexed by joint and
+// the keys of all the tracks are stored in a few contiguous arrays, times
+// apart from values: the key search only touches the times.
+class AnimationClip {
+public:
+  AnimationClip(); //!< Constructor
+
+  void Load(const aiAnimation *pAnimation,
+            const std::map<std::string, int> &JointMapping,
+            unsigned int NumJoints); //!< Copies the keys of the channels
+                                     //!< driving the given joints.
+
+  void Resample(float SamplesPerSecond); //!< Resamples the tracks on a
+                                         //!< uniform time grid.
+
+  void MakeAdditive(float ReferenceTime); //!< Turns every key into its
+                                          //!< difference to the pose at
+                                          //!< ReferenceTime (in ticks).
+
+  bool IsAnimated(unsigned int Joint) const {
+    return m_Tracks[Joint].Rotations.Count > 0;
+  }
+
+  void SampleRotation(unsigned int Joint, float AnimationTime,
+                      KeyCursor &Cursor,
+                      Quaternion &Out) const; //!< Interpolated joint rotation.
+
+  void SampleTranslation(
+      unsigned int Joint, float AnimationTime, KeyCursor &Cursor,
+      Vector3f &Out) const; //!< Interpolated joint translation.
+
+  void Sample(unsigned int Joint, float AnimationTime, KeyCursor &Cursor,
+              Quaternion &Rotation,
+              Vector3f &Translation) const { //!< Interpolated joint pose.
+    SampleRotation(Joint, AnimationTime, Cursor, Rotation);
+    SampleTranslation(Joint, AnimationTime, Cursor, Translation);
+  }
+
+  void SampleKeys(unsigned int Joint, float AnimationTime, KeyCursor &Cursor,
+                  JointKeys &Out) const; //!< Keys around the given time.
+
+  void GetKeyTimes(unsigned int Joint,
+                   std::vector<float> &Times) const; //!< Sorted times of
+                                                     //!< all the joint keys.
+
+  float GetDuration() const { return m_Duration; } //!< In ticks.
+  float GetTicksPerSecond() const { return m_TicksPerSecond; }
+  unsigned int GetNumJoints() const { return (unsigned int)m_Tracks.size(); }
+
+  size_t GetMemoryUsage() const; //!< Bytes used by tracks and keys.
+
+private:
+  unsigned int
+  FindKey(const std::vector<float> &Times, const KeyRange &Range,
+          float AnimationTime, unsigned int &Cursor,
+          float &Factor) const; //!< Finds the key just before the given time
+                                //!< and the interpolation factor.
+
+  float m_Duration;       //!< Duration in ticks.
+  float m_TicksPerSecond; //!< Ticks per second.
+  float m_SampleInterval; //!< Time between two keys in ticks if the tracks
+                          //!< are uniformly sampled, 0 otherwise.
+
+  std::vector<JointTrack> m_Tracks; //!< One track per joint.
+
+  std::vector<float> m_RotationTimes;      //!< Empty if uniformly sampled.
+  std::vector<Quaternion> m_RotationKeys;  //!< Rotation values.
+  std::vector<float> m_TranslationTimes;   //!< Empty if uniformly sampled.
+  std::vector<Vector3f> m_TranslationKeys; //!< Translation values.
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "AnimationCrowd.h"
+
+#include <chrono>
+#include <float.h>
+#include <string.h>
+
+// Instances evaluated by a single job: enough work to amortise taking the job
+// out of a queue, small enough to leave something to steal.
+#define INSTANCES_PER_JOB 4
+
+namespace {
+// Linear blend of two affine palettes, the last row is always 0 0 0 1.
+void LerpPalette(const Matrix4f *From, const Matrix4f *To, float Factor,
+                 unsigned int NumBones, Matrix4f *Out) {
+  for (unsigned int b = 0; b < NumBones; b++) {
+    for (unsigned int i = 0; i < 3; i++) {
+      for (unsigned int j = 0; j < 4; j++) {
+        Out[b].m[i][j] =
+            From[b].m[i][j] + (To[b].m[i][j] - From[b].m[i][j]) * Factor;
+      }
+    }
+  }
+}
+} // namespace
+
+AnimationCrowd::AnimationCrowd(const SkeletalModel *pModel, JobSystem *pJobs) {
+  m_pModel = pModel;
+  m_pJobs = pJobs;
+  m_NumBones = pModel->GetNumBones();
+  m_Time = 0.0f;
+  m_UpdateTime = 0.0f;
+  m_UseDualQuaternions = false;
+  m_UsePoseCache = false;
+
+  // No LOD until the settings are given: every instance at full rate.
+  m_LODSettings.ReducedDistance = FLT_MAX;
+  m_LODSettings.MinimalDistance = FLT_MAX;
+  m_LODSettings.ReducedRate = 15.0f;
+  for (unsigned int i = 0; i < ANIMATION_LOD_COUNT; i++) {
+    m_LODCounts[i] = 0;
+  }
+}
+
+unsigned int AnimationCrowd::AddInstance(float TimeOffset, float Speed) {
+  CrowdInstance Instance;
+  Instance.TimeOffset = TimeOffset;
+  Instance.Speed = Speed;
+  m_pModel->InitState(Instance.State);
+  Instance.Distance = 0.0f;
+  Instance.Visible = true;
+  Instance.LOD = ANIMATION_LOD_FULL;
+  Instance.CacheEntry = -1;
+  m_pModel->GetBindBounds(Instance.BoundsMin, Instance.BoundsMax);
+  Instance.Interpolating = false;
+  Instance.FromTime = 0.0f;
+  Instance.ToTime = 0.0f;
+  // Sized now, switching to a lower LOD later doesn't allocate.
+  Instance.FromPalette.resize(m_NumBones);
+  Instance.ToPalette.resize(m_NumBones);
+  m_Instances.push_back(Instance);
+
+  // Identity until the first update.
+  Matrix4f Identity;
+  Identity.InitIdentity();
+  m_Palettes.resize(m_Instances.size() * m_NumBones, Identity);
+
+  if (m_UseDualQuaternions) {
+    SetDualQuaternions(true);
+  }
+  if (m_UsePoseCache) {
+    EnablePoseCache(m_PoseCache.GetBucketSize());
+  }
+
+  return (unsigned int)m_Instances.size() - 1;
+}
+
+void AnimationCrowd::SetDualQuaternions(bool Enabled) {
+  m_UseDualQuaternions = Enabled;
+  if (!Enabled) {
+    m_DualQuaternions.clear();
+    return;
+  }
+
+  // Valid right away, Update keeps them in step with the matrices.
+  m_DualQuaternions.resize(m_Palettes.size());
+  if (!m_Palettes.empty()) {
+    SkeletalModel::ToDualQuaternions(&m_Palettes[0],
+                                     (unsigned int)m_Palettes.size(),
+                                     &m_DualQuaternions[0]);
+  }
+}
+
+void AnimationCrowd::EnablePoseCache(float BucketSize) {
+  // At worst every instance plays a different pose.
+  m_PoseCache.Init(m_pModel, BucketSize, (unsigned int)m_Instances.size());
+  m_UsePoseCache = true;
+}
+
+void AnimationCrowd::PlayClip(unsigned int Instance, unsigned int Clip,
+                              float FadeTime) {
+  CrowdInstance &i = m_Instances[Instance];
+  m_pModel->PlayClip(i.State, Clip, m_Time * i.Speed + i.TimeOffset,
+                     FadeTime);
+  // Evaluate again, the pose ahead doesn't have the new layer.
+  i.Interpolating = false;
+}
+
+void AnimationCrowd::AddLayer(unsigned int Instance, unsigned int Clip,
+                              float Weight) {
+  CrowdInstance &i = m_Instances[Instance];
+  m_pModel->AddLayer(i.State, Clip, m_Time * i.Speed + i.TimeOffset, Weight);
+  i.Interpolating = false;
+}
+
+void AnimationCrowd::SetInstanceView(unsigned int Instance, float Distance,
+                                     bool Visible) {
+  m_Instances[Instance].Distance = Distance;
+  m_Instances[Instance].Visible = Visible;
+}
+
+void AnimationCrowd::Update(float TimeInSeconds) {
+  if (m_NumBones == 0) {
+    return;
+  }
+
+  std::chrono::high_resolution_clock::time_point Start =
+      std::chrono::high_resolution_clock::now();
+  m_Time = TimeInSeconds;
+
+  // Pick the tiers first, the counts are kept for profiling.
+  for (unsigned int i = 0; i < ANIMATION_LOD_COUNT; i++) {
+    m_LODCounts[i] = 0;
+  }
+  for (unsigned int i = 0; i < m_Instances.size(); i++) {
+    CrowdInstance &Instance = m_Instances[i];
+    if (!Instance.Visible) {
+      Instance.LOD = ANIMATION_LOD_PAUSED;
+    } else if (Instance.Distance > m_LODSettings.MinimalDistance) {
+      Instance.LOD = ANIMATION_LOD_MINIMAL;
+    } else if (Instance.Distance > m_LODSettings.ReducedDistance) {
+      Instance.LOD = ANIMATION_LOD_REDUCED;
+    } else {
+      Instance.LOD = ANIMATION_LOD_FULL;
+    }
+    m_LODCounts[Instance.LOD]++;
+  }
+
+  // Look the full LOD poses up in the cache and evaluate the distinct ones,
+  // the instances then copy them. Only single clip poses are shared, the
+  // blends are evaluated by their instance.
+  if (m_UsePoseCache) {
+    m_PoseCache.BeginFrame();
+    for (unsigned int i = 0; i < m_Instances.size(); i++) {
+      CrowdInstance &Instance = m_Instances[i];
+      Instance.CacheEntry = -1;
+      const AnimationState &State = Instance.State;
+      if (Instance.LOD != ANIMATION_LOD_FULL || State.NumLayers > 1) {
+        continue;
+      }
+
+      float Time = TimeInSeconds * Instance.Speed + Instance.TimeOffset;
+      if (State.NumLayers == 0) {
+        Instance.CacheEntry = (int)m_PoseCache.Request(0, Time);
+      } else if (!State.Layers[0].Additive) {
+        const AnimationLayer &Layer = State.Layers[0];
+        Instance.CacheEntry =
+            (int)m_PoseCache.Request(Layer.Clip, Time - Layer.StartTime);
+      }
+    }
+    m_PoseCache.Evaluate(m_pJobs);
+  }
+
+  // Every instance only touches its own state and its own slice of the
+  // palette buffer, so the jobs don't need any synchronisation.
+  m_pJobs->ParallelFor(
+      (unsigned int)m_Instances.size(), INSTANCES_PER_JOB,
+      [this, TimeInSeconds](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++) {
+          UpdateInstance(i, TimeInSeconds);
+        }
+      });
+
+  m_UpdateTime = std::chrono::duration<float, std::milli>(
+                     std::chrono::high_resolution_clock::now() - Start)
+                     .count();
+}
+
+void AnimationCrowd::UpdateInstance(unsigned int Index, float TimeInSeconds) {
+  CrowdInstance &Instance = m_Instances[Index];
+  Matrix4f *Palette = &m_Palettes[Index * m_NumBones];
+  float Time = TimeInSeconds * Instance.Speed + Instance.TimeOffset;
+
+  switch (Instance.LOD) {
+  case ANIMATION_LOD_PAUSED:
+    // Keep the last palette, evaluate from scratch once visible again.
+    Instance.Interpolating = false;
+    return;
+
+  case ANIMATION_LOD_FULL:
+    if (m_UsePoseCache && Instance.CacheEntry >= 0) {
+      memcpy(Palette, m_PoseCache.GetPalette(Instance.CacheEntry),
+             m_NumBones * sizeof(Matrix4f));
+    } else {
+      m_pModel->EvaluatePalette(Time, Instance.State, Palette);
+    }
+    Instance.Interpolating = false;
+    break;
+
+  default: {
+    // Evaluate the pose one period ahead and blend towards it from the
+    // palette currently shown, no pop when the tier changes.
+    if (!Instance.Interpolating || Time >= Instance.ToTime ||
+        Time < Instance.FromTime) {
+      memcpy(&Instance.FromPalette[0], Palette, m_NumBones * sizeof(Matrix4f));
+      Instance.FromTime = Time;
+      Instance.ToTime = Time + Instance.Speed / m_LODSettings.ReducedRate;
+      m_pModel->EvaluatePalette(Instance.ToTime, Instance.State,
+                                &Instance.ToPalette[0],
+                                Instance.LOD == ANIMATION_LOD_MINIMAL);
+      Instance.Interpolating = true;
+    }
+
+    float Period = Instance.ToTime - Instance.FromTime;
+    float Factor = Period > 0.0f ? (Time - Instance.FromTime) / Period : 1.0f;
+    LerpPalette(&Instance.FromPalette[0], &Instance.ToPalette[0], Factor,
+                m_NumBones, Palette);
+    break;
+  }
+  }
+
+  if (m_UseDualQuaternions) {
+    SkeletalModel::ToDualQuaternions(Palette, m_NumBones,
+                                     &m_DualQuaternions[Index * m_NumBones]);
+  }
+  m_pModel->CalcBounds(Palette, Instance.BoundsMin, Instance.BoundsMax);
+}
@@ -0,0 +1,145 @@
+#ifndef ANIMATIONCROWD_H
+#define ANIMATIONCROWD_H
+
+#include "JobSystem.h"
+#include "Math3D.h"
+#include "PoseCache.h"
+#include "SkeletalModel.h"
+#include <vector>
+
+// Animation level of detail of an instance, picked on every Update from its
+// distance to the camera and its visibility.
+enum AnimationLOD {
+  ANIMATION_LOD_FULL,    //!< Every joint, every frame.
+  ANIMATION_LOD_REDUCED, //!< Every joint, at a lower rate.
+  ANIMATION_LOD_MINIMAL, //!< Minor joints skipped, at a lower rate.
+  ANIMATION_LOD_PAUSED,  //!< Not visible, the pose is frozen.
+  ANIMATION_LOD_COUNT
+};
+
+// Distances, in the units of SetInstanceView, at which the tiers start.
+struct AnimationLODSettings {
+  float ReducedDistance; //!< Beyond it the instances update at ReducedRate.
+  float MinimalDistance; //!< Beyond it the minor joints are skipped too.
+  float ReducedRate;     //!< Pose evaluations per second of the far tiers,
+                         //!< the frames in between are interpolated.
+};
+
+// A character of the crowd: its own playback of the shared animations.
+struct CrowdInstance {
+  float TimeOffset;     //!< Seconds added to the clock, desynchronises the
+                        //!< characters.
+  float Speed;          //!< Playback rate.
+  AnimationState State; //!< Key cursors and scratch buffers.
+
+  float Distance;   //!< From the camera, selects the LOD.
+  bool Visible;     //!< In the view frustum.
+  AnimationLOD LOD; //!< Tier of the last Update.
+  int CacheEntry;   //!< Shared pose of this frame, -1 if evaluated alone.
+  Vector3f BoundsMin, BoundsMax; //!< Model space box around the pose of the
+                                 //!< palette, for culling.
+
+  // Throttled update: the palette is interpolated from the pose shown when
+  // the last evaluation happened to the pose evaluated ahead at ToTime.
+  bool Interpolating;                //!< From and To are valid.
+  float FromTime, ToTime;            //!< Playback times of From and To.
+  std::vector<Matrix4f> FromPalette; //!< Shown at FromTime.
+  std::vector<Matrix4f> ToPalette;   //!< Evaluated at ToTime.
+};
+
+// Many characters playing the animation of one SkeletalModel. The poses are
+// evaluated in parallel on a JobSystem and written into a single contiguous
+// palette buffer, GetNumBones() matrices per instance, ready to be uploaded
+// in one go.
+class AnimationCrowd {
+public:
+  AnimationCrowd(const SkeletalModel *pModel,
+                 JobSystem *pJobs); //!< Constructor
+
+  unsigned int AddInstance(float TimeOffset,
+                           float Speed); //!< Returns the instance index.
+
+  void Update(float TimeInSeconds); //!< Evaluates the palettes of all the
+                                    //!< instances.
+  void SetTime(float TimeInSeconds) {
+    m_Time = TimeInSeconds;
+  } //!< Clock PlayClip and AddLayer start the clips from, when the palettes
+    //!< are evaluated elsewhere.
+
+  void PlayClip(unsigned int Instance, unsigned int Clip,
+                float FadeTime); //!< Cross-fades the instance to another
+                                 //!< clip of the library, from the time of
+                                 //!< the last Update.
+  void AddLayer(unsigned int Instance, unsigned int Clip,
+                float Weight); //!< Plays an additive clip on top.
+
+  void SetLODSettings(const AnimationLODSettings &Settings) {
+    m_LODSettings = Settings;
+  }
+  void SetInstanceView(unsigned int Instance, float Distance,
+                       bool Visible); //!< Where the instance is seen from,
+                                      //!< used by the next Update.
+
+  unsigned int GetLODCount(AnimationLOD LOD) const {
+    return m_LODCounts[LOD];
+  } //!< Instances in the tier at the last Update.
+
+  void EnablePoseCache(float BucketSize); //!< Shares the poses of the full
+                                          //!< LOD instances whose times fall
+                                          //!< in the same bucket.
+  void DisablePoseCache() { m_UsePoseCache = false; }
+  bool HasPoseCache() const { return m_UsePoseCache; }
+  const PoseCache &GetPoseCache() const { return m_PoseCache; }
+
+  unsigned int GetNumInstances() const {
+    return (unsigned int)m_Instances.size();
+  }
+  unsigned int GetNumBones() const { return m_NumBones; }
+
+  const CrowdInstance &GetInstance(unsigned int Instance) const {
+    return m_Instances[Instance];
+  }
+
+  const Matrix4f *GetPalette(unsigned int Instance) const {
+    return &m_Palettes[Instance * m_NumBones];
+  }
+  const std::vector<Matrix4f> &GetPalettes() const { return m_Palettes; }
+
+  void SetDualQuaternions(bool Enabled); //!< Also converts the palettes to
+                                         //!< dual quaternions on Update.
+  bool HasDualQuaternions() const { return m_UseDualQuaternions; }
+  const std::vector<DualQuaternion> &GetDualQuaternions() const {
+    return m_DualQuaternions;
+  }
+
+  float GetUpdateTime() const { return m_UpdateTime; } //!< Milliseconds
+                                                        //!< spent in the last
+                                                        //!< Update.
+
+private:
+  void UpdateInstance(unsigned int Index,
+                      float TimeInSeconds); //!< Evaluates or interpolates
+                                            //!< the palette of an instance.
+
+  const SkeletalModel *m_pModel; //!< Shared skeleton and animation.
+  JobSystem *m_pJobs;            //!< Threads evaluating the poses.
+  unsigned int m_NumBones;       //!< Palette size of an instance.
+
+  std::vector<CrowdInstance> m_Instances; //!< Per character playback.
+  std::vector<Matrix4f> m_Palettes;       //!< Palettes of all the instances.
+
+  bool m_UseDualQuaternions;                      //!< Fill m_DualQuaternions.
+  std::vector<DualQuaternion> m_DualQuaternions; //!< Same palettes, dual
+                                                  //!< quaternion form.
+
+  bool m_UsePoseCache;
+  PoseCache m_PoseCache; //!< Poses shared by the instances this frame.
+
+  AnimationLODSettings m_LODSettings;
+  unsigned int m_LODCounts[ANIMATION_LOD_COUNT];
+
+  float m_Time; //!< Clock of the last Update, the clips start from it.
+  float m_UpdateTime;
+};
+
+#endif
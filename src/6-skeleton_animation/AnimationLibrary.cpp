@@ -0,0 +1,121 @@
+#include "AnimationLibrary.h"
+
+#include <assimp/Importer.hpp> // C++ importer interface
+#include <math.h>
+#include <stdio.h>
+
+AnimationLibrary::AnimationLibrary() { m_NumJoints = 0; }
+
+bool AnimationLibrary::BindSkeleton(
+    const std::map<std::string, int> &JointMapping, unsigned int NumJoints) {
+  if (m_NumJoints == 0) {
+    m_JointMapping = JointMapping;
+    m_NumJoints = NumJoints;
+    return true;
+  }
+  return m_NumJoints == NumJoints && m_JointMapping == JointMapping;
+}
+
+unsigned int AnimationLibrary::AddAnimations(const aiScene *pScene) {
+  unsigned int NumAdded = 0;
+  for (unsigned int i = 0; i < pScene->mNumAnimations; i++) {
+    const aiAnimation *pAnimation = pScene->mAnimations[i];
+    std::string Name(pAnimation->mName.data);
+    if (FindClip(Name) >= 0) {
+      continue;
+    }
+
+    m_Clips.push_back(LibraryClip());
+    LibraryClip &Clip = m_Clips.back();
+    Clip.Name = Name;
+    Clip.Source.Load(pAnimation, m_JointMapping, m_NumJoints);
+    Clip.Additive = false;
+    NumAdded++;
+
+    printf("Animation %u: '%s', %.2f s\n", GetNumClips() - 1, Name.c_str(),
+           GetDuration(GetNumClips() - 1));
+  }
+  return NumAdded;
+}
+
+unsigned int AnimationLibrary::LoadAnimations(const std::string &Filename) {
+  // Only the animations are needed, the meshes are not processed.
+  Assimp::Importer Importer;
+  const aiScene *pScene = Importer.ReadFile(Filename.c_str(), 0);
+  if (!pScene) {
+    printf("Error parsing '%s': '%s'\n", Filename.c_str(),
+           Importer.GetErrorString());
+    return 0;
+  }
+  return AddAnimations(pScene);
+}
+
+void AnimationLibrary::MakeAdditive(unsigned int Clip, float ReferenceTime) {
+  LibraryClip &c = m_Clips[Clip];
+  if (c.Additive || !c.Compressed.IsEmpty()) {
+    return;
+  }
+  c.Source.MakeAdditive(ReferenceTime * c.Source.GetTicksPerSecond());
+  c.Additive = true;
+}
+
+void AnimationLibrary::Resample(float SamplesPerSecond) {
+  for (unsigned int i = 0; i < m_Clips.size(); i++) {
+    if (m_Clips[i].Compressed.IsEmpty()) {
+      m_Clips[i].Source.Resample(SamplesPerSecond);
+    }
+  }
+}
+
+int AnimationLibrary::FindClip(const std::string &Name) const {
+  for (unsigned int i = 0; i < m_Clips.size(); i++) {
+    if (m_Clips[i].Name == Name) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+void AnimationLibrary::SetCompressed(unsigned int Clip,
+                                     const CompressedClip &Compressed,
+                                     const CompressionStats &Stats) {
+  m_Clips[Clip].Compressed = Compressed;
+  m_Clips[Clip].Stats = Stats;
+  m_Clips[Clip].Source = AnimationClip();
+}
+
+float AnimationLibrary::GetDuration(unsigned int Clip) const {
+  const LibraryClip &c = m_Clips[Clip];
+  bool Compressed = !c.Compressed.IsEmpty();
+  float TicksPerSecond = Compressed ? c.Compressed.GetTicksPerSecond()
+                                    : c.Source.GetTicksPerSecond();
+  float Duration =
+      Compressed ? c.Compressed.GetDuration() : c.Source.GetDuration();
+
+  return TicksPerSecond > 0.0f ? Duration / TicksPerSecond : 0.0f;
+}
+
+float AnimationLibrary::GetAnimationTime(unsigned int Clip,
+                                         float TimeInSeconds) const {
+  const LibraryClip &c = m_Clips[Clip];
+  bool Compressed = !c.Compressed.IsEmpty();
+  float TicksPerSecond = Compressed ? c.Compressed.GetTicksPerSecond()
+                                    : c.Source.GetTicksPerSecond();
+  float Duration =
+      Compressed ? c.Compressed.GetDuration() : c.Source.GetDuration();
+  if (Duration <= 0.0f) {
+    return 0.0f;
+  }
+
+  float AnimationTime = fmodf(TimeInSeconds * TicksPerSecond, Duration);
+  return AnimationTime < 0.0f ? AnimationTime + Duration : AnimationTime;
+}
+
+size_t AnimationLibrary::GetMemoryUsage() const {
+  size_t Bytes = 0;
+  for (unsigned int i = 0; i < m_Clips.size(); i++) {
+    Bytes += m_Clips[i].Source.GetMemoryUsage() +
+             m_Clips[i].Compressed.GetMemoryUsage();
+  }
+  return Bytes;
+}
@@ -0,0 +1,102 @@
+#ifndef ANIMATIONLIBRARY_H
+#define ANIMATIONLIBRARY_H
+
+#include "AnimationClip.h"
+#include "CompressedClip.h"
+#include <assimp/scene.h> // Output data structure
+#include <map>
+#include <string>
+#include <vector>
+
+// What compressing a clip saved and cost, measured once when compressing.
+struct CompressionStats {
+  unsigned int SourceBytes;     //!< Memory of the source keys.
+  unsigned int CompressedBytes; //!< Memory of the compressed keys.
+  unsigned int NumKeys;         //!< Compressed keys of all the joints.
+  float MaxError;  //!< Largest joint position error, in model space.
+  float MeanError; //!< Mean joint position error, in model space.
+
+  CompressionStats()
+      : SourceBytes(0), CompressedBytes(0), NumKeys(0), MaxError(0.0f),
+        MeanError(0.0f) {}
+};
+
+// A clip of the library: the source keys until it is compressed, then the
+// compressed ones.
+struct LibraryClip {
+  std::string Name;          //!< aiAnimation name, unique in the library.
+  AnimationClip Source;      //!< Released once compressed.
+  CompressedClip Compressed; //!< Empty until compressed.
+  CompressionStats Stats;    //!< Zero until compressed.
+  bool Additive;             //!< Keys are differences to a reference pose.
+};
+
+// All the animations of a skeleton, loaded once and shared by every
+// SkeletalModel built on that skeleton. The tracks are indexed by joint, so
+// the models must flatten the same hierarchy: the first one to bind the
+// library sets the joint names, the others are checked against them.
+class AnimationLibrary {
+public:
+  AnimationLibrary(); //!< Constructor
+
+  bool BindSkeleton(const std::map<std::string, int> &JointMapping,
+                    unsigned int NumJoints); //!< False if the joints differ
+                                             //!< from the library ones.
+
+  unsigned int AddAnimations(const aiScene *pScene); //!< Adds the clips whose
+                                                     //!< name is new, returns
+                                                     //!< how many.
+
+  unsigned int LoadAnimations(
+      const std::string &Filename); //!< Adds the clips of another file with
+                                    //!< the same skeleton.
+
+  void MakeAdditive(unsigned int Clip,
+                    float ReferenceTime); //!< Turns a clip into differences
+                                          //!< to its pose at ReferenceTime,
+                                          //!< in seconds. Before compressing.
+
+  void Resample(float SamplesPerSecond); //!< Resamples the clips not
+                                         //!< compressed yet.
+
+  int FindClip(const std::string &Name) const; //!< -1 if not found.
+
+  unsigned int GetNumClips() const { return (unsigned int)m_Clips.size(); }
+  const LibraryClip &GetClip(unsigned int Clip) const { return m_Clips[Clip]; }
+  void SetCompressed(unsigned int Clip, const CompressedClip &Compressed,
+                     const CompressionStats &Stats); //!< Switches the clip to
+                                                     //!< compressed keys and
+                                                     //!< releases the source
+                                                     //!< ones.
+
+  float GetDuration(unsigned int Clip) const; //!< Seconds.
+  float GetAnimationTime(unsigned int Clip,
+                         float TimeInSeconds) const; //!< Ticks, wrapped
+                                                     //!< around the duration.
+
+  bool IsAnimated(unsigned int Clip, unsigned int Joint) const {
+    const LibraryClip &c = m_Clips[Clip];
+    return c.Compressed.IsEmpty() ? c.Source.IsAnimated(Joint)
+                                  : c.Compressed.IsAnimated(Joint);
+  }
+
+  void SampleKeys(unsigned int Clip, unsigned int Joint, float AnimationTime,
+                  KeyCursor &Cursor, JointKeys &Out) const {
+    const LibraryClip &c = m_Clips[Clip];
+    if (c.Compressed.IsEmpty()) {
+      c.Source.SampleKeys(Joint, AnimationTime, Cursor, Out);
+    } else {
+      c.Compressed.SampleKeys(Joint, AnimationTime, Cursor, Out);
+    }
+  } //!< Keys around the given time, in ticks.
+
+  size_t GetMemoryUsage() const; //!< Bytes used by all the clips.
+
+private:
+  std::map<std::string, int> m_JointMapping; //!< Joint names to indices.
+  unsigned int m_NumJoints;
+
+  std::vector<LibraryClip> m_Clips;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "AnimationScene.h"
 
+#include "learnopengl/gl_state.h"
+
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -12,50 +14,238 @@ using glm::vec3;
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform2.hpp>
 
+// Largest error the animation compression may introduce on a joint, in
+// radians and model units.
+#define ROTATION_TOLERANCE 0.001f
+#define TRANSLATION_TOLERANCE 0.01f
+
+// Number of characters playing the animation, placed on a grid.
+#define CROWD_SIZE 256
+#define CROWD_COLUMNS 16
+#define CROWD_SPACING 150.0f
+
+// Animation LOD of the crowd: distances from the camera in world units, and
+// pose evaluations per second of the far characters.
+#define LOD_REDUCED_DISTANCE 100.0f
+#define LOD_MINIMAL_DISTANCE 200.0f
+#define LOD_REDUCED_RATE 10.0f
+
+// Size of the pose cache time buckets, in seconds: the characters whose
+// animation times fall in the same bucket share the pose.
+#define POSE_CACHE_BUCKET_SIZE (1.0f / 30.0f)
+
+// Bone influences kept per vertex, and blended for the far characters.
+#define BONE_INFLUENCES 4
+#define LOW_DETAIL_BONE_INFLUENCES 2
+
+// Frames per second of the baked animation texture.
+#define BAKE_SAMPLES_PER_SECOND 30.0f
+
+// Poses per second sampled for the box around every pose of the clips.
+#define MOTION_BOUNDS_SAMPLES_PER_SECOND 30.0f
+
+// Seconds the crowd takes to cross-fade to another clip.
+#define CLIP_FADE_TIME 0.5f
+
+// Bindings of the baked animation.
+#define BAKED_TEXTURE_UNIT 0
+#define BAKED_INSTANCE_BINDING 4
+
+// Binding of the crowd indices of the characters drawn.
+#define VISIBLE_INSTANCE_BINDING 5
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 /////////////////////////////////////////////////////////////////////////////////////////////
-AnimationScene::AnimationScene() : m_animate(true) {}
+AnimationScene::AnimationScene()
+    : m_animate(true), m_AnimatedModel(NULL), m_clip(0), m_Jobs(NULL),
+      m_Crowd(NULL),
+      m_computeSkinning(false), m_dualQuaternions(false),
+      m_bakedAnimation(false), m_gpuAnimation(false), m_time(0.0f),
+      m_culling(true), m_numNear(0), m_visibleBuffer(0) {}
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Initialise the scene
 /////////////////////////////////////////////////////////////////////////////////////////////
 void AnimationScene::initScene(QuatCamera camera) {
   prog = new GLSLProgram();
+  skinnedProg = new GLSLProgram();
+  dualQuatProg = new GLSLProgram();
+  bakedProg = new GLSLProgram();
+  lowDetailProg = new GLSLProgram();
+  fragProg = new GLSLProgram();
 
   //|Compile and link the shader
   compileAndLinkShader();
 
-  prog->initialiseBoneUniforms();
-
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   // Set up the lighting
   setLightParams(camera);
 
   // Initialise skeletal model.
   m_AnimatedModel = new SkeletalModel(prog);
+  m_AnimatedModel->SetBoneInfluences(BONE_INFLUENCES);
 
-  // Load the model from the given path.
-  m_AnimatedModel->LoadMesh(PROJECT_DIR
-                            "/src/6-skeleton_animation/assets/Dying.fbx");
+  // Load the model from the given path, its animations go to the library
+  // any other model with the same skeleton can share.
+  m_AnimatedModel->LoadMesh(
+      PROJECT_DIR "/src/6-skeleton_animation/assets/Dying.fbx", &m_Library);
+
+  // Drop the keys interpolation reproduces and quantize the remaining ones.
+  m_AnimatedModel->CompressAnimation(ROTATION_TOLERANCE, TRANSLATION_TOLERANCE);
+
+  // Culls the characters whose pose is unknown: paused, or baked.
+  m_AnimatedModel->CalcMotionBounds(MOTION_BOUNDS_SAMPLES_PER_SECOND,
+                                    m_motionMin, m_motionMax);
+
+  // The crowd shares the skeleton and the animation, every character plays
+  // it at its own time and speed.
+  m_Jobs = new JobSystem();
+  m_Crowd = new AnimationCrowd(m_AnimatedModel, m_Jobs);
+  for (unsigned int i = 0; i < CROWD_SIZE; i++) {
+    float TimeOffset = i == 0 ? 0.0f : (float)rand() / RAND_MAX * 10.0f;
+    float Speed = i == 0 ? 1.0f : 0.8f + (float)rand() / RAND_MAX * 0.4f;
+    m_Crowd->AddInstance(TimeOffset, Speed);
+  }
+
+  // Every character draws the model's one copy of the mesh, with its slot
+  // of the visible list.
+  m_AnimatedModel->SetMaxInstances(m_Crowd->GetNumInstances());
+
+  AnimationLODSettings LOD;
+  LOD.ReducedDistance = LOD_REDUCED_DISTANCE;
+  LOD.MinimalDistance = LOD_MINIMAL_DISTANCE;
+  LOD.ReducedRate = LOD_REDUCED_RATE;
+  m_Crowd->SetLODSettings(LOD);
+
+  // Room for the palettes of the whole crowd, indexed by the position of the
+  // instance in the visible list and by bone.
+  m_Palettes.Init(0, m_Crowd->GetNumInstances() * m_Crowd->GetNumBones());
+
+  // The visible list, rewritten every frame.
+  m_visible.reserve(m_Crowd->GetNumInstances());
+  glGenBuffers(1, &m_visibleBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               m_Crowd->GetNumInstances() * sizeof(unsigned int), NULL,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  prog->setUniform("NumBones", (int)m_Crowd->GetNumBones());
+  prog->setUniform("CrowdColumns", CROWD_COLUMNS);
+  prog->setUniform("CrowdSpacing", CROWD_SPACING);
+  dualQuatProg->setUniform("NumBones", (int)m_Crowd->GetNumBones());
+  dualQuatProg->setUniform("CrowdColumns", CROWD_COLUMNS);
+  dualQuatProg->setUniform("CrowdSpacing", CROWD_SPACING);
+  lowDetailProg->setUniform("NumBones", (int)m_Crowd->GetNumBones());
+  lowDetailProg->setUniform("CrowdColumns", CROWD_COLUMNS);
+  lowDetailProg->setUniform("CrowdSpacing", CROWD_SPACING);
+
+  // Output buffer for the skinned vertices of the whole crowd.
+  m_Skinning.Init(m_AnimatedModel, m_Crowd->GetNumInstances());
+
+  // The compressed clips on the GPU, to evaluate the palettes there.
+  m_GpuAnimation.Init(m_AnimatedModel, m_Crowd->GetNumInstances());
+
+  // The same crowd playing the animation from a texture.
+  m_Baked.Bake(m_AnimatedModel, BAKE_SAMPLES_PER_SECOND, m_clip);
+  m_Baked.InitInstances(*m_Crowd);
+  bakedProg->setUniform("AnimationTexture", BAKED_TEXTURE_UNIT);
+  bakedProg->setUniform("NumFrames", (int)m_Baked.GetNumFrames());
+  bakedProg->setUniform("Duration", m_Baked.GetDuration());
+  bakedProg->setUniform("CrowdColumns", CROWD_COLUMNS);
+  bakedProg->setUniform("CrowdSpacing", CROWD_SPACING);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Update
 /////////////////////////////////////////////////////////////////////////////////////////////
 void AnimationScene::update(long long f_StartTime, float f_Interval) {
-  // Vector of bone transformation matrices.
-  std::vector<Matrix4f> Transforms;
+  // A frame is this update and the following render. Once every buffer has
+  // been sized by the first frames, neither allocates.
+  AllocationTracker::BeginFrame();
+  AllocationScope Scope("update");
+
+  m_time = f_Interval;
 
-  // Obtains newly transformed matrices from the bone hierarchy at the given
-  // time.
-  m_AnimatedModel->BoneTransform(f_Interval, Transforms);
+  // Characters drawn by the next render, seen by the last one.
+  updateVisible();
 
-  // Passes each new bone transformation into the shader.
-  for (unsigned int i = 0; i < Transforms.size(); i++) {
-    m_AnimatedModel->SetBoneTransform(i, Transforms[i]);
+  // The baked animation is evaluated by the vertex shader.
+  if (m_bakedAnimation) {
+    return;
   }
+
+  // Only the clips and the times of the visible characters are uploaded,
+  // the render evaluates their palettes.
+  if (m_gpuAnimation) {
+    m_Crowd->SetTime(f_Interval);
+    for (unsigned int i = 0; i < m_visible.size(); i++) {
+      const CrowdInstance &instance = m_Crowd->GetInstance(m_visible[i]);
+      m_GpuAnimation.SetInstance(i, instance.State,
+                                 f_Interval * instance.Speed +
+                                     instance.TimeOffset);
+    }
+    return;
+  }
+
+  // The compute skinning reads matrices.
+  bool DualQuaternions = m_dualQuaternions && !m_computeSkinning;
+  if (m_Crowd->HasDualQuaternions() != DualQuaternions) {
+    m_Crowd->SetDualQuaternions(DualQuaternions);
+  }
+
+  // Evaluates the bone transformation matrices of the whole crowd at the
+  // given time.
+  m_Crowd->Update(f_Interval);
+
+  // Uploads the palettes of the visible characters at once, packed in the
+  // order of the list: the culled ones cost no bandwidth.
+  if (m_visible.empty()) {
+    return;
+  }
+  unsigned int NumBones = m_Crowd->GetNumBones();
+  if (DualQuaternions) {
+    m_Palettes.Upload(&m_Crowd->GetDualQuaternions()[0], NumBones,
+                      &m_visible[0], (unsigned int)m_visible.size());
+  } else {
+    m_Palettes.Upload(&m_Crowd->GetPalettes()[0], NumBones, &m_visible[0],
+                      (unsigned int)m_visible.size());
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// List the characters to draw and upload the list
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::updateVisible() {
+  // The near characters first, the far ones blend fewer bones and are drawn
+  // by a second call.
+  m_visible.clear();
+  for (int far = 0; far < 2; far++) {
+    for (unsigned int i = 0; i < m_Crowd->GetNumInstances(); i++) {
+      const CrowdInstance &instance = m_Crowd->GetInstance(i);
+      if (instance.Visible &&
+          (instance.Distance > LOD_MINIMAL_DISTANCE) == (far != 0)) {
+        m_visible.push_back(i);
+      }
+    }
+    if (!far) {
+      m_numNear = (unsigned int)m_visible.size();
+    }
+  }
+
+  // Orphaned, the previous frame may still be reading it.
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               m_Crowd->GetNumInstances() * sizeof(unsigned int), NULL,
+               GL_STREAM_DRAW);
+  if (!m_visible.empty()) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    m_visible.size() * sizeof(unsigned int), &m_visible[0]);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCE_BINDING,
+                   m_visibleBuffer);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -64,14 +254,17 @@ void AnimationScene::update(long long f_StartTime, float f_Interval) {
 void AnimationScene::setLightParams(QuatCamera camera) {
   vec3 worldLight = vec3(10.0f, 10.0f, 10.0f);
 
-  prog->setUniform("lightIntensity", 0.5f, 0.5f, 0.5f);
-  prog->setUniform("lightPos", worldLight);
+  // Only the fragment program lights, for every vertex program.
+  fragProg->setUniform("lightIntensity", 0.5f, 0.5f, 0.5f);
+  fragProg->setUniform("lightPos", worldLight);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Render the scene
 /////////////////////////////////////////////////////////////////////////////////////////////
 void AnimationScene::render(QuatCamera camera) {
+  AllocationScope Scope("render");
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   // Model matrix
@@ -79,35 +272,215 @@ void AnimationScene::render(QuatCamera camera) {
   // model = glm::translate(glm::vec3(0.0, -20.0, 0.0));
   model = glm::scale(glm::vec3(0.2f));
 
-  setMatrices(camera);
+  // Used by the next update.
+  updateLOD(camera);
+
+  // Skin the crowd once, every pass below draws the skinned vertices. Only
+  // the characters of the visible list are skinned and drawn.
+  unsigned int NumVisible = (unsigned int)m_visible.size();
+  bool GpuPalettes = m_gpuAnimation && !m_bakedAnimation;
+  if (GpuPalettes) {
+    m_GpuAnimation.Dispatch(NumVisible);
+  }
+  bool ComputeSkinning = m_computeSkinning && !m_bakedAnimation;
+  if (ComputeSkinning) {
+    m_Skinning.Dispatch(CROWD_COLUMNS, CROWD_SPACING, NumVisible);
+  }
+  GLSLProgram *p = prog;
+  if (m_bakedAnimation) {
+    p = bakedProg;
+    p->setUniform("Time", m_time);
+    m_Baked.Bind(BAKED_TEXTURE_UNIT, BAKED_INSTANCE_BINDING);
+  } else if (ComputeSkinning) {
+    p = skinnedProg;
+  } else if (m_dualQuaternions && !GpuPalettes) {
+    p = dualQuatProg;
+  }
+
+  // The far characters of the matrix skinning blend fewer bones.
+  if (p == prog && LOW_DETAIL_BONE_INFLUENCES < BONE_INFLUENCES) {
+    drawCrowd(prog, camera, 0, m_numNear);
+    drawCrowd(lowDetailProg, camera, m_numNear, NumVisible - m_numNear);
+  } else {
+    drawCrowd(p, camera, 0, NumVisible);
+  }
+
+  // The palettes of this frame can be overwritten once these draws are done.
+  m_Palettes.Fence();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Draw count characters of the visible list from first on
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::drawCrowd(GLSLProgram *p, QuatCamera camera,
+                               unsigned int first, unsigned int count) {
+  if (count == 0) {
+    return;
+  }
+
+  setMatrices(p, camera);
 
   // Set the Teapot material properties in the shader and render
   // prog->setUniform("Ka", vec3(0.225f, 0.125f, 0.0f));
-  prog->setUniform("Ka", vec3(0.225f, 0.125f, 0.0f));
-  prog->setUniform("Kd", vec3(1.0f, 0.6f, 0.0f));
-  prog->setUniform("Ks", vec3(1.0f, 1.0f, 1.0f));
-  prog->setUniform("specularShininess", 32.0f);
+  fragProg->setUniform("Ka", vec3(0.225f, 0.125f, 0.0f));
+  fragProg->setUniform("Kd", vec3(1.0f, 0.6f, 0.0f));
+  fragProg->setUniform("Ks", vec3(1.0f, 1.0f, 1.0f));
+  fragProg->setUniform("specularShininess", 32.0f);
+
+  m_Pipelines.bind(p->getHandle(), fragProg->getHandle());
 
-  m_AnimatedModel->render();
+  if (p == skinnedProg) {
+    m_Skinning.render(count);
+  } else {
+    m_AnimatedModel->render(count, first);
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Send the MVP matrices to the GPU
 /////////////////////////////////////////////////////////////////////////////////////////////
-void AnimationScene::setMatrices(QuatCamera camera) {
+void AnimationScene::setMatrices(GLSLProgram *p, QuatCamera camera) {
   mat4 mv = camera.view() * model;
-  prog->setUniform("ModelViewMatrix", mv);
+  p->setUniform("ModelViewMatrix", mv);
 
-  prog->setUniform("MVP", camera.projection() * mv);
+  p->setUniform("MVP", camera.projection() * mv);
 
   // the correct matrix to transform the normal is the transpose of the inverse
   // of the M matrix
   mat3 normMat = glm::transpose(glm::inverse(mat3(model)));
 
-  prog->setUniform("M", model);
-  prog->setUniform("NormalMatrix", normMat);
-  prog->setUniform("V", camera.view());
-  prog->setUniform("P", camera.projection());
+  p->setUniform("M", model);
+  p->setUniform("NormalMatrix", normMat);
+  p->setUniform("V", camera.view());
+  p->setUniform("P", camera.projection());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Distance from the camera and visibility of every character of the crowd
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::updateLOD(QuatCamera camera) {
+  // Frustum planes in model space, from the rows of the MVP matrix.
+  mat4 mvp = camera.projection() * camera.view() * model;
+  glm::vec4 planes[6];
+  for (int i = 0; i < 3; i++) {
+    glm::vec4 row(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+    glm::vec4 w(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+    planes[i * 2] = w + row;
+    planes[i * 2 + 1] = w - row;
+  }
+  for (int i = 0; i < 6; i++) {
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+  }
+
+  for (unsigned int i = 0; i < m_Crowd->GetNumInstances(); i++) {
+    // Box around the last pose of the character. A paused character moves on
+    // once visible again and a baked or GPU evaluated one is never seen by
+    // the CPU, they get the box around every pose.
+    const CrowdInstance &instance = m_Crowd->GetInstance(i);
+    Vector3f boxMin = instance.BoundsMin, boxMax = instance.BoundsMax;
+    if (m_bakedAnimation || m_gpuAnimation ||
+        instance.LOD == ANIMATION_LOD_PAUSED) {
+      boxMin = m_motionMin;
+      boxMax = m_motionMax;
+    }
+
+    // Same placement as the shaders.
+    vec3 offset((float)((int)i % CROWD_COLUMNS - CROWD_COLUMNS / 2) *
+                    CROWD_SPACING,
+                0.0f, -(float)((int)i / CROWD_COLUMNS) * CROWD_SPACING);
+    vec3 lower = offset + vec3(boxMin.x, boxMin.y, boxMin.z);
+    vec3 upper = offset + vec3(boxMax.x, boxMax.y, boxMax.z);
+
+    // Outside if the corner furthest along the normal of a plane is behind
+    // it.
+    bool visible = true;
+    for (int j = 0; j < 6 && visible && m_culling; j++) {
+      vec3 corner(planes[j].x >= 0.0f ? upper.x : lower.x,
+                  planes[j].y >= 0.0f ? upper.y : lower.y,
+                  planes[j].z >= 0.0f ? upper.z : lower.z);
+      visible = glm::dot(vec3(planes[j]), corner) + planes[j].w >= 0.0f;
+    }
+
+    vec3 center = (lower + upper) * 0.5f;
+    vec3 worldCenter = vec3(model * glm::vec4(center, 1.0f));
+    m_Crowd->SetInstanceView(i, glm::length(worldCenter - camera.position()),
+                             visible);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Enable or disable the pose cache of the crowd
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::poseCache(bool value) {
+  if (value) {
+    m_Crowd->EnablePoseCache(POSE_CACHE_BUCKET_SIZE);
+  } else {
+    m_Crowd->DisablePoseCache();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Cross-fade the crowd to the next clip of the library
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::nextClip() {
+  if (m_Library.GetNumClips() < 2) {
+    return;
+  }
+
+  m_clip = (m_clip + 1) % m_Library.GetNumClips();
+  printf("Playing '%s'\n", m_Library.GetClip(m_clip).Name.c_str());
+  for (unsigned int i = 0; i < m_Crowd->GetNumInstances(); i++) {
+    m_Crowd->PlayClip(i, m_clip, CLIP_FADE_TIME);
+  }
+
+  // The baked crowd holds a single clip: it switches without a cross-fade.
+  m_Baked.Bake(m_AnimatedModel, BAKE_SAMPLES_PER_SECOND, m_clip);
+  bakedProg->setUniform("NumFrames", (int)m_Baked.GetNumFrames());
+  bakedProg->setUniform("Duration", m_Baked.GetDuration());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Print the crowd update cost, LOD tiers and allocations
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::printStats() {
+  if (m_gpuAnimation) {
+    printf("Palettes evaluated on the GPU, the crowd update is idle\n");
+  }
+  printf("Crowd update %.3f ms, LOD full %u, reduced %u, minimal %u, "
+         "paused %u\n",
+         m_Crowd->GetUpdateTime(), m_Crowd->GetLODCount(ANIMATION_LOD_FULL),
+         m_Crowd->GetLODCount(ANIMATION_LOD_REDUCED),
+         m_Crowd->GetLODCount(ANIMATION_LOD_MINIMAL),
+         m_Crowd->GetLODCount(ANIMATION_LOD_PAUSED));
+  printf("Drawn %u of %u characters, %u far ones blending %d bones, "
+         "culling %s\n",
+         (unsigned int)m_visible.size(), m_Crowd->GetNumInstances(),
+         (unsigned int)m_visible.size() - m_numNear,
+         LOW_DETAIL_BONE_INFLUENCES, m_culling ? "on" : "off");
+
+  if (m_Crowd->HasPoseCache()) {
+    const PoseCache &cache = m_Crowd->GetPoseCache();
+    printf("Pose cache: %u poses for %u requests, hit rate %.1f%% (frame), "
+           "%.1f%% (total)\n",
+           cache.GetNumEntries(), cache.GetFrameRequests(),
+           cache.GetFrameRequests() > 0
+               ? 100.0f * cache.GetFrameHits() / cache.GetFrameRequests()
+               : 0.0f,
+           100.0f * cache.GetHitRate());
+  }
+
+  const LibraryClip &clip = m_Library.GetClip(m_clip);
+  if (!clip.Compressed.IsEmpty()) {
+    const CompressionStats &stats = clip.Stats;
+    printf("Clip '%s' compressed: %u -> %u bytes (%.1f:1), %u keys, joint "
+           "position error max %f, mean %f\n",
+           clip.Name.c_str(), stats.SourceBytes, stats.CompressedBytes,
+           (float)stats.SourceBytes / stats.CompressedBytes, stats.NumKeys,
+           stats.MaxError, stats.MeanError);
+  }
+
+  // Of the last frame, the keys are handled between two frames.
+  AllocationTracker::PrintFrameReport();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -126,15 +499,46 @@ void AnimationScene::resize(QuatCamera camera, int w, int h) {
 void AnimationScene::compileAndLinkShader() {
 
   try {
-    prog->compileShader(PROJECT_DIR
-                        "/src/6-skeleton_animation/shaders/diffuse.vert");
-    prog->compileShader(PROJECT_DIR
-                        "/src/6-skeleton_animation/shaders/diffuse.frag");
-    prog->link();
-    prog->validate();
-    prog->use();
+    // The vertex shaders are specialized for the bone influences stored.
+    prog->addDefine("NUM_BONE_INFLUENCES", BONE_INFLUENCES);
+    dualQuatProg->addDefine("NUM_BONE_INFLUENCES", BONE_INFLUENCES);
+    bakedProg->addDefine("NUM_BONE_INFLUENCES", BONE_INFLUENCES);
+    lowDetailProg->addDefine("NUM_BONE_INFLUENCES", BONE_INFLUENCES);
+    lowDetailProg->addDefine("NUM_BLENDED_INFLUENCES",
+                             LOW_DETAIL_BONE_INFLUENCES);
+
+    // Each vertex variant is linked on its own, diffuse.frag only once.
+    compileVertexProgram(prog, PROJECT_DIR
+                         "/src/6-skeleton_animation/shaders/diffuse.vert");
+    compileVertexProgram(skinnedProg,
+                         PROJECT_DIR
+                         "/src/6-skeleton_animation/shaders/skinned.vert");
+    compileVertexProgram(dualQuatProg,
+                         PROJECT_DIR
+                         "/src/6-skeleton_animation/shaders/diffuse_dq.vert");
+    compileVertexProgram(bakedProg,
+                         PROJECT_DIR
+                         "/src/6-skeleton_animation/shaders/baked.vert");
+    compileVertexProgram(lowDetailProg,
+                         PROJECT_DIR
+                         "/src/6-skeleton_animation/shaders/diffuse.vert");
+
+    fragProg->setSeparable(true);
+    fragProg->compileShader(PROJECT_DIR
+                            "/src/6-skeleton_animation/shaders/diffuse.frag");
+    fragProg->link();
   } catch (GLSLProgramException &e) {
     cerr << e.what() << endl;
     exit(EXIT_FAILURE);
   }
-}
\ No newline at end of file
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Compile and link a vertex shader alone, to be paired with fragProg
+/////////////////////////////////////////////////////////////////////////////////////////////
+void AnimationScene::compileVertexProgram(GLSLProgram *p,
+                                          const char *fileName) {
+  p->setSeparable(true);
+  p->compileShader(fileName, GLSLShader::VERTEX);
+  p->link();
+}
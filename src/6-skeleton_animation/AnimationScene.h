@@ -10,15 +10,42 @@
 #include <assimp/postprocess.h> // Post processing fla
 #include <assimp/scene.h>       // Output data structure
 
+#include "AllocationTracker.h"
+#include "AnimationCrowd.h"
+#include "AnimationLibrary.h"
+#include "BakedAnimation.h"
+#include "GpuAnimation.h"
+#include "JobSystem.h"
+#include "PaletteBuffer.h"
 #include "QuatCamera.h"
 #include "SkeletalModel.h"
+#include "SkinningPass.h"
 #include "glslprogram.h"
+#include "learnopengl/program_pipeline.h"
 
 using glm::mat4;
 
 class AnimationScene {
 private:
-  GLSLProgram *prog; //!< Shader program
+  // The vertex shader variants and diffuse.frag are linked once each as
+  // separable programs, and paired by the pipeline cache.
+
+  GLSLProgram *prog; //!< Vertex program skinning with matrices
+
+  GLSLProgram *skinnedProg; //!< Vertex program drawing the compute skinned
+                            //!< vertices
+
+  GLSLProgram *dualQuatProg; //!< Vertex program skinning with dual
+                             //!< quaternions
+
+  GLSLProgram *bakedProg; //!< Vertex program playing the baked animation
+
+  GLSLProgram *lowDetailProg; //!< Vertex program blending fewer bones, for
+                              //!< the far characters
+
+  GLSLProgram *fragProg; //!< diffuse.frag, shared by every vertex program
+
+  ProgramPipelineCache m_Pipelines; //!< Vertex program and fragProg pairs
 
   int width, height;
 
@@ -28,10 +55,62 @@ private:
 
   SkeletalModel *m_AnimatedModel; //!< The skeletal model
 
-  void setMatrices(QuatCamera camera); // Set the camera matrices
+  AnimationLibrary m_Library; //!< Animations of the model's skeleton
+
+  unsigned int m_clip; //!< Clip the crowd is playing
+
+  JobSystem *m_Jobs; //!< Worker threads for the crowd update
+
+  AnimationCrowd *m_Crowd; //!< Characters sharing the skeletal model
+
+  PaletteBuffer m_Palettes; //!< Bone palettes of the crowd on the GPU
+
+  SkinningPass m_Skinning; //!< Compute skinning of the crowd
+
+  bool m_computeSkinning; //!< Skin in a compute pass instead of in the
+                          //!< vertex shader
+
+  bool m_dualQuaternions; //!< Skin the vertices with dual quaternions
+                          //!< instead of matrices
+
+  BakedAnimation m_Baked; //!< Animation sampled into a texture
+
+  bool m_bakedAnimation; //!< Play the baked animation, no CPU update
+
+  GpuAnimation m_GpuAnimation; //!< Palettes evaluated by a compute shader
+
+  bool m_gpuAnimation; //!< Evaluate the palettes on the GPU, no CPU update
+
+  float m_time; //!< Time of the last update, in seconds
+
+  bool m_culling; //!< Skip the characters outside the view frustum
+
+  std::vector<unsigned int> m_visible; //!< Crowd indices drawn this frame,
+                                       //!< in the order of the palettes
+
+  unsigned int m_numNear; //!< Characters at the start of m_visible drawn
+                          //!< with every bone influence
+
+  GLuint m_visibleBuffer; //!< m_visible for the shaders
+
+  Vector3f m_motionMin, m_motionMax; //!< Box around every pose of the clips
+
+  void setMatrices(GLSLProgram *p, QuatCamera camera); // Set the camera
+                                                        // matrices
 
   void compileAndLinkShader(); // Compile and link the shader
 
+  void compileVertexProgram(GLSLProgram *p,
+                            const char *fileName); // Compile and link a
+                                                   // separable vertex program
+
+  void updateLOD(QuatCamera camera); // Distance and visibility of the crowd
+
+  void updateVisible(); // List and upload the characters to draw
+
+  void drawCrowd(GLSLProgram *p, QuatCamera camera, unsigned int first,
+                 unsigned int count); // Draw a range of the visible list
+
 public:
   AnimationScene(); // Constructor
 
@@ -47,6 +126,31 @@ public:
 
   void animate(bool value) { m_animate = value; }
   bool animating() { return m_animate; }
+
+  void computeSkinning(bool value) { m_computeSkinning = value; }
+  bool computeSkinning() { return m_computeSkinning; }
+
+  void dualQuaternions(bool value) { m_dualQuaternions = value; }
+  bool dualQuaternions() { return m_dualQuaternions; }
+
+  void bakedAnimation(bool value) { m_bakedAnimation = value; }
+  bool bakedAnimation() { return m_bakedAnimation; }
+
+  void gpuAnimation(bool value) {
+    m_gpuAnimation = value && m_GpuAnimation.IsReady();
+  }
+  bool gpuAnimation() { return m_gpuAnimation; }
+
+  void culling(bool value) { m_culling = value; }
+  bool culling() { return m_culling; }
+
+  void poseCache(bool value); // Share the poses of the crowd
+  bool poseCache() { return m_Crowd->HasPoseCache(); }
+
+  void nextClip(); // Cross-fade the crowd to the next clip
+
+  void printStats(); // Print the crowd update cost, LOD tiers, compression
+                     // of the clip played and allocations
 };
 
 #endif
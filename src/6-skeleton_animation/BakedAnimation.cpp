@@ -0,0 +1,117 @@
+#include "BakedAnimation.h"
+
+#include "learnopengl/gl_state.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Texels per bone: the last row of a palette matrix is always 0 0 0 1.
+#define BAKED_ROWS_PER_BONE 3
+
+BakedAnimation::BakedAnimation() {
+  m_Clip = 0;
+  m_NumFrames = 0;
+  m_NumBones = 0;
+  m_Duration = 0.0f;
+  m_Texture = 0;
+  m_InstanceBuffer = 0;
+}
+
+BakedAnimation::~BakedAnimation() { Clear(); }
+
+void BakedAnimation::Clear() {
+  if (m_Texture != 0) {
+    glState().deleteTextures(1, &m_Texture);
+    m_Texture = 0;
+  }
+  if (m_InstanceBuffer != 0) {
+    glDeleteBuffers(1, &m_InstanceBuffer);
+    m_InstanceBuffer = 0;
+  }
+}
+
+void BakedAnimation::Bake(const SkeletalModel *pModel, float SamplesPerSecond,
+                          unsigned int Clip) {
+  if (m_Texture != 0) {
+    glState().deleteTextures(1, &m_Texture);
+    m_Texture = 0;
+  }
+
+  m_Clip = Clip;
+  m_NumBones = pModel->GetNumBones();
+  m_Duration = pModel->GetDuration(Clip);
+  if (m_NumBones == 0 || m_Duration <= 0.0f) {
+    m_NumFrames = 0;
+    return;
+  }
+
+  // Evenly spaced frames over the loop, the shader wraps from the last one
+  // back to the first.
+  m_NumFrames = (unsigned int)ceilf(m_Duration * SamplesPerSecond);
+  if (m_NumFrames == 0) {
+    m_NumFrames = 1;
+  }
+
+  // Played alone from the start: without a fade the clip replaces the first
+  // one at once.
+  AnimationState State;
+  pModel->InitState(State);
+  if (Clip != 0) {
+    pModel->PlayClip(State, Clip, 0.0f);
+  }
+  std::vector<Matrix4f> Palette(m_NumBones);
+
+  unsigned int Width = m_NumBones * BAKED_ROWS_PER_BONE;
+  std::vector<float> Texels((size_t)m_NumFrames * Width * 4);
+  for (unsigned int Frame = 0; Frame < m_NumFrames; Frame++) {
+    float Time = m_Duration * Frame / m_NumFrames;
+    pModel->EvaluatePalette(Time, State, &Palette[0]);
+
+    float *pRow = &Texels[(size_t)Frame * Width * 4];
+    for (unsigned int Bone = 0; Bone < m_NumBones; Bone++) {
+      memcpy(pRow + Bone * BAKED_ROWS_PER_BONE * 4, Palette[Bone].m,
+             BAKED_ROWS_PER_BONE * 4 * sizeof(float));
+    }
+  }
+
+  glGenTextures(1, &m_Texture);
+  glState().bindTexture(GL_TEXTURE_2D, m_Texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, Width, m_NumFrames, 0, GL_RGBA,
+               GL_FLOAT, &Texels[0]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glState().bindTexture(GL_TEXTURE_2D, 0);
+
+  printf("Baked animation: %u frames x %u bones, %u bytes\n", m_NumFrames,
+         m_NumBones, GetMemoryUsage());
+}
+
+void BakedAnimation::InitInstances(const AnimationCrowd &Crowd) {
+  std::vector<float> Playback(Crowd.GetNumInstances() * 2);
+  for (unsigned int i = 0; i < Crowd.GetNumInstances(); i++) {
+    Playback[i * 2] = Crowd.GetInstance(i).TimeOffset;
+    Playback[i * 2 + 1] = Crowd.GetInstance(i).Speed;
+  }
+
+  if (m_InstanceBuffer == 0) {
+    glGenBuffers(1, &m_InstanceBuffer);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_InstanceBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, Playback.size() * sizeof(float),
+               Playback.empty() ? NULL : &Playback[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void BakedAnimation::Bind(GLuint TextureUnit, GLuint InstanceBinding) const {
+  glState().activeTexture(TextureUnit);
+  glState().bindTexture(GL_TEXTURE_2D, m_Texture);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, InstanceBinding,
+                   m_InstanceBuffer);
+}
+
+unsigned int BakedAnimation::GetMemoryUsage() const {
+  return m_NumFrames * m_NumBones * BAKED_ROWS_PER_BONE * 4 * sizeof(float);
+}
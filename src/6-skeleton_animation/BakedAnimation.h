@@ -0,0 +1,48 @@
+#ifndef BAKEDANIMATION_H
+#define BAKEDANIMATION_H
+
+#include "AnimationCrowd.h"
+#include "SkeletalModel.h"
+#include <glad/glad.h>
+
+// A clip of a SkeletalModel sampled once, at a fixed rate, into a
+// float texture: one row per frame, three texels per bone holding the first
+// three rows of its palette matrix. The vertex shader (shaders/baked.vert)
+// fetches and interpolates the two frames around the time of each instance,
+// so the characters cost nothing on the CPU once the animation is baked.
+class BakedAnimation {
+public:
+  BakedAnimation();  //!< Constructor
+  ~BakedAnimation(); //!< Destructor
+
+  void Bake(const SkeletalModel *pModel, float SamplesPerSecond,
+            unsigned int Clip = 0); //!< Samples the whole clip and creates
+                                    //!< the texture, replacing the clip
+                                    //!< baked before.
+
+  void InitInstances(const AnimationCrowd &Crowd); //!< Time offset and speed
+                                                   //!< of every instance.
+
+  void Bind(GLuint TextureUnit,
+            GLuint InstanceBinding) const; //!< Binds the texture and the
+                                           //!< instance buffer.
+
+  unsigned int GetClip() const { return m_Clip; }
+  unsigned int GetNumFrames() const { return m_NumFrames; }
+  unsigned int GetNumBones() const { return m_NumBones; }
+  float GetDuration() const { return m_Duration; } //!< Seconds.
+  unsigned int GetMemoryUsage() const;             //!< Bytes of the texture.
+
+private:
+  void Clear(); //!< Deletes the texture and the buffer.
+
+  unsigned int m_Clip;      //!< Index in the AnimationLibrary.
+  unsigned int m_NumFrames; //!< Texture height.
+  unsigned int m_NumBones;  //!< Texture width / 3.
+  float m_Duration;         //!< Length of the loop, in seconds.
+
+  GLuint m_Texture;        //!< GL_RGBA32F frames x (bones x 3).
+  GLuint m_InstanceBuffer; //!< Time offset and speed per instance.
+};
+
+#endif
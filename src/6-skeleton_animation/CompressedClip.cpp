@@ -0,0 +1,291 @@
+#include "CompressedClip.h"
+
+#include <algorithm>
+
+namespace {
+// The three smallest components of a unit quaternion lie in
+// [-1/sqrt(2), 1/sqrt(2)].
+const float SmallestThreeRange = 0.70710678f;
+
+// Angle between two rotations, in radians. Computed from the chord between
+// the quaternions rather than from acos of their dot product, which has no
+// precision left for small angles.
+float RotationError(const Quaternion &a, const Quaternion &b) {
+  float Sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f ? -1.0f
+                                                                    : 1.0f;
+  float dx = a.x - Sign * b.x, dy = a.y - Sign * b.y;
+  float dz = a.z - Sign * b.z, dw = a.w - Sign * b.w;
+  float Chord = sqrtf(dx * dx + dy * dy + dz * dz + dw * dw);
+  return 4.0f * asinf(std::min(Chord * 0.5f, 1.0f));
+}
+
+float Distance(const Vector3f &a, const Vector3f &b) {
+  Vector3f d = a - b;
+  return sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+}
+
+uint16_t Quantize(float Value, float Min, float Extent, float Steps) {
+  if (Extent <= 0.0f) {
+    return 0;
+  }
+  float Unit = std::min(std::max((Value - Min) / Extent, 0.0f), 1.0f);
+  return (uint16_t)(Unit * Steps + 0.5f);
+}
+
+// Samples of a joint track at the original key times.
+struct TrackSamples {
+  std::vector<float> Times;
+  std::vector<Quaternion> Rotations;
+  std::vector<Vector3f> Translations;
+};
+
+// Whether interpolating the samples First and Last reproduces all the samples
+// in between within the tolerances.
+bool IsReproduced(const TrackSamples &Samples, unsigned int First,
+                  unsigned int Last, float RotationTolerance,
+                  float TranslationTolerance) {
+  float Start = Samples.Times[First];
+  float Length = Samples.Times[Last] - Start;
+
+  for (unsigned int k = First + 1; k < Last; k++) {
+    float Factor = (Samples.Times[k] - Start) / Length;
+
+    Quaternion Rotation;
+    Quaternion::Interpolate(Rotation, Samples.Rotations[First],
+                            Samples.Rotations[Last], Factor);
+    Rotation.Normalize();
+    if (RotationError(Rotation, Samples.Rotations[k]) > RotationTolerance) {
+      return false;
+    }
+
+    Vector3f Translation =
+        Samples.Translations[First] +
+        (Samples.Translations[Last] - Samples.Translations[First]) * Factor;
+    if (Distance(Translation, Samples.Translations[k]) >
+        TranslationTolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Greedy key reduction: each kept key is followed by the farthest key whose
+// interpolation still reproduces the removed ones.
+void ReduceKeys(const TrackSamples &Samples, float RotationTolerance,
+                float TranslationTolerance, std::vector<unsigned int> &Kept) {
+  unsigned int NumSamples = (unsigned int)Samples.Times.size();
+  Kept.clear();
+  Kept.push_back(0);
+
+  // A constant track only needs one key.
+  bool Constant = true;
+  for (unsigned int k = 1; k < NumSamples && Constant; k++) {
+    Constant = RotationError(Samples.Rotations[0], Samples.Rotations[k]) <=
+                   RotationTolerance &&
+               Distance(Samples.Translations[0], Samples.Translations[k]) <=
+                   TranslationTolerance;
+  }
+  if (Constant) {
+    return;
+  }
+
+  unsigned int First = 0;
+  for (unsigned int Last = 2; Last < NumSamples; Last++) {
+    if (!IsReproduced(Samples, First, Last, RotationTolerance,
+                      TranslationTolerance)) {
+      First = Last - 1;
+      Kept.push_back(First);
+    }
+  }
+  Kept.push_back(NumSamples - 1);
+}
+} // namespace
+
+CompressedClip::CompressedClip() {
+  m_Duration = 0.0f;
+  m_TicksPerSecond = 0.0f;
+}
+
+void CompressedClip::Compress(const AnimationClip &Source,
+                              float RotationTolerance,
+                              float TranslationTolerance) {
+  m_Duration = Source.GetDuration();
+  m_TicksPerSecond = Source.GetTicksPerSecond();
+
+  m_Tracks.assign(Source.GetNumJoints(), CompressedTrack());
+  m_Keys.clear();
+
+  TrackSamples Samples;
+  std::vector<unsigned int> Kept;
+
+  for (unsigned int i = 0; i < m_Tracks.size(); i++) {
+    if (!Source.IsAnimated(i)) {
+      continue;
+    }
+
+    // Evaluate the source at every one of its key times, so rotation and
+    // translation end up sharing the same keys.
+    Source.GetKeyTimes(i, Samples.Times);
+    unsigned int NumSamples = (unsigned int)Samples.Times.size();
+    Samples.Rotations.resize(NumSamples);
+    Samples.Translations.resize(NumSamples);
+
+    KeyCursor Cursor;
+    for (unsigned int k = 0; k < NumSamples; k++) {
+      Source.Sample(i, Samples.Times[k], Cursor, Samples.Rotations[k],
+                    Samples.Translations[k]);
+    }
+
+    ReduceKeys(Samples, RotationTolerance, TranslationTolerance, Kept);
+
+    // Translation range of the kept keys.
+    CompressedTrack &Track = m_Tracks[i];
+    Vector3f Max = Samples.Translations[Kept[0]];
+    Track.Min = Max;
+    for (unsigned int k = 1; k < Kept.size(); k++) {
+      const Vector3f &t = Samples.Translations[Kept[k]];
+      Track.Min = Vector3f(std::min(Track.Min.x, t.x),
+                           std::min(Track.Min.y, t.y),
+                           std::min(Track.Min.z, t.z));
+      Max = Vector3f(std::max(Max.x, t.x), std::max(Max.y, t.y),
+                     std::max(Max.z, t.z));
+    }
+    Track.Extent = Max - Track.Min;
+
+    Track.Keys.First = (unsigned int)m_Keys.size();
+    Track.Keys.Count = (unsigned int)Kept.size();
+    for (unsigned int k = 0; k < Kept.size(); k++) {
+      const Vector3f &t = Samples.Translations[Kept[k]];
+
+      PackedKey Key;
+      Key.Time = Samples.Times[Kept[k]];
+      PackRotation(Samples.Rotations[Kept[k]], Key.Rotation);
+      Key.Translation[0] = Quantize(t.x, Track.Min.x, Track.Extent.x, 65535.0f);
+      Key.Translation[1] = Quantize(t.y, Track.Min.y, Track.Extent.y, 65535.0f);
+      Key.Translation[2] = Quantize(t.z, Track.Min.z, Track.Extent.z, 65535.0f);
+      m_Keys.push_back(Key);
+    }
+  }
+}
+
+void CompressedClip::PackRotation(const Quaternion &Rotation,
+                                  uint16_t Out[3]) {
+  float c[4] = {Rotation.x, Rotation.y, Rotation.z, Rotation.w};
+
+  // The largest component is dropped and rebuilt from the unit length, q and
+  // -q are the same rotation so it is made positive.
+  unsigned int Largest = 0;
+  for (unsigned int i = 1; i < 4; i++) {
+    if (fabsf(c[i]) > fabsf(c[Largest])) {
+      Largest = i;
+    }
+  }
+  float Sign = c[Largest] < 0.0f ? -1.0f : 1.0f;
+
+  // 15 bits per component, the index of the dropped one goes in the top bits
+  // of the first two.
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    if (i == Largest) {
+      continue;
+    }
+    Out[j] = Quantize(c[i] * Sign, -SmallestThreeRange,
+                      2.0f * SmallestThreeRange, 32767.0f);
+    j++;
+  }
+  Out[0] |= (uint16_t)((Largest & 1) << 15);
+  Out[1] |= (uint16_t)((Largest >> 1) << 15);
+}
+
+void CompressedClip::UnpackRotation(const uint16_t In[3], Quaternion &Out) {
+  unsigned int Largest = (In[0] >> 15) | ((In[1] >> 15) << 1);
+
+  float c[4];
+  float SquaredSum = 0.0f;
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    if (i == Largest) {
+      continue;
+    }
+    c[i] = (In[j] & 0x7FFF) * (2.0f * SmallestThreeRange / 32767.0f) -
+           SmallestThreeRange;
+    SquaredSum += c[i] * c[i];
+    j++;
+  }
+  c[Largest] = sqrtf(std::max(1.0f - SquaredSum, 0.0f));
+
+  Out = Quaternion(c[0], c[1], c[2], c[3]);
+}
+
+void CompressedClip::Unpack(const CompressedTrack &Track, const PackedKey &Key,
+                            Quaternion &Rotation, Vector3f &Translation) const {
+  UnpackRotation(Key.Rotation, Rotation);
+  Translation = Vector3f(
+      Track.Min.x + Track.Extent.x * (Key.Translation[0] / 65535.0f),
+      Track.Min.y + Track.Extent.y * (Key.Translation[1] / 65535.0f),
+      Track.Min.z + Track.Extent.z * (Key.Translation[2] / 65535.0f));
+}
+
+void CompressedClip::SampleKeys(unsigned int Joint, float AnimationTime,
+                                KeyCursor &Cursor, JointKeys &Out) const {
+  const CompressedTrack &Track = m_Tracks[Joint];
+  const PackedKey *Keys = &m_Keys[Track.Keys.First];
+  unsigned int NumKeys = Track.Keys.Count;
+
+  if (NumKeys == 1) {
+    Unpack(Track, Keys[0], Out.StartRotation, Out.StartTranslation);
+    Out.EndRotation = Out.StartRotation;
+    Out.EndTranslation = Out.StartTranslation;
+    Out.RotationFactor = 0.0f;
+    Out.TranslationFactor = 0.0f;
+    return;
+  }
+
+  // Same search as AnimationClip: try the cursor interval and the next one,
+  // then fall back to a binary search.
+  unsigned int i = Cursor.Rotation;
+  bool Found = false;
+  if (i + 1 < NumKeys && (i == 0 || Keys[i].Time <= AnimationTime)) {
+    if (AnimationTime < Keys[i + 1].Time) {
+      Found = true;
+    } else if (i + 2 < NumKeys && AnimationTime < Keys[i + 2].Time) {
+      i++;
+      Found = true;
+    }
+  }
+  if (!Found) {
+    const PackedKey *Next =
+        std::upper_bound(Keys + 1, Keys + NumKeys - 1, AnimationTime,
+                         [](float t, const PackedKey &Key) {
+                           return t < Key.Time;
+                         });
+    i = (unsigned int)(Next - Keys) - 1;
+  }
+  Cursor.Rotation = i;
+
+  // Rotation and translation share the keys.
+  Out.RotationFactor =
+      (AnimationTime - Keys[i].Time) / (Keys[i + 1].Time - Keys[i].Time);
+  Out.TranslationFactor = Out.RotationFactor;
+  Unpack(Track, Keys[i], Out.StartRotation, Out.StartTranslation);
+  Unpack(Track, Keys[i + 1], Out.EndRotation, Out.EndTranslation);
+}
+
+void CompressedClip::Sample(unsigned int Joint, float AnimationTime,
+                            KeyCursor &Cursor, Quaternion &Rotation,
+                            Vector3f &Translation) const {
+  JointKeys Keys;
+  SampleKeys(Joint, AnimationTime, Cursor, Keys);
+
+  Quaternion::Interpolate(Rotation, Keys.StartRotation, Keys.EndRotation,
+                          Keys.RotationFactor);
+  Rotation.Normalize();
+  Translation =
+      Keys.StartTranslation +
+      (Keys.EndTranslation - Keys.StartTranslation) * Keys.TranslationFactor;
+}
+
+size_t CompressedClip::GetMemoryUsage() const {
+  return m_Tracks.size() * sizeof(CompressedTrack) +
+         m_Keys.size() * sizeof(PackedKey);
+}
@@ -0,0 +1,75 @@
+#ifndef COMPRESSEDCLIP_H
+#define COMPRESSEDCLIP_H
+
+#include "AnimationClip.h"
+#include "Math3D.h"
+#include <stdint.h>
+#include <vector>
+
+// A key of a compressed track: rotation and translation of the joint at the
+// same time, packed together so sampling reads one 16 byte record per key.
+struct PackedKey {
+  float Time;              //!< Time in ticks.
+  uint16_t Rotation[3];    //!< Smallest three quaternion components.
+  uint16_t Translation[3]; //!< Translation quantized in the track range.
+};
+
+// The keys animating a single joint and the range of its translations.
+struct CompressedTrack {
+  KeyRange Keys;   //!< Keys in the packed key array.
+  Vector3f Min;    //!< Smallest translation of the track.
+  Vector3f Extent; //!< Size of the translation range.
+
+  CompressedTrack() : Min(0.0f, 0.0f, 0.0f), Extent(0.0f, 0.0f, 0.0f) {}
+};
+
+// Lossy compressed copy of an AnimationClip. Keys that interpolating their
+// neighbours reproduces within a tolerance are removed, rotations are stored
+// as the three smallest components on 15 bits each (48 bits per key) and
+// translations on 16 bits per component, relative to the range of the track.
+class CompressedClip {
+public:
+  CompressedClip(); //!< Constructor
+
+  void Compress(const AnimationClip &Source, float RotationTolerance,
+                float TranslationTolerance); //!< Tolerances are the maximum
+                                             //!< rotation angle (radians) and
+                                             //!< translation distance.
+
+  bool IsEmpty() const { return m_Tracks.empty(); }
+
+  bool IsAnimated(unsigned int Joint) const {
+    return m_Tracks[Joint].Keys.Count > 0;
+  }
+
+  void Sample(unsigned int Joint, float AnimationTime, KeyCursor &Cursor,
+              Quaternion &Rotation,
+              Vector3f &Translation) const; //!< Interpolated joint pose.
+
+  void SampleKeys(unsigned int Joint, float AnimationTime, KeyCursor &Cursor,
+                  JointKeys &Out) const; //!< Keys around the given time.
+
+  float GetDuration() const { return m_Duration; } //!< In ticks.
+  float GetTicksPerSecond() const { return m_TicksPerSecond; }
+  unsigned int GetNumJoints() const { return (unsigned int)m_Tracks.size(); }
+  unsigned int GetNumKeys() const { return (unsigned int)m_Keys.size(); }
+  const std::vector<CompressedTrack> &GetTracks() const { return m_Tracks; }
+  const std::vector<PackedKey> &GetKeys() const { return m_Keys; }
+
+  size_t GetMemoryUsage() const; //!< Bytes used by tracks and keys.
+
+  static void PackRotation(const Quaternion &Rotation, uint16_t Out[3]);
+  static void UnpackRotation(const uint16_t In[3], Quaternion &Out);
+
+private:
+  void Unpack(const CompressedTrack &Track, const PackedKey &Key,
+              Quaternion &Rotation, Vector3f &Translation) const;
+
+  float m_Duration;       //!< Duration in ticks.
+  float m_TicksPerSecond; //!< Ticks per second.
+
+  std::vector<CompressedTrack> m_Tracks; //!< One track per joint.
+  std::vector<PackedKey> m_Keys;         //!< Keys of all the tracks.
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "CpuSkinning.h"
+
+#include <math.h>
+
+// Vertices per JobSystem chunk.
+#define VERTICES_PER_JOB 2048
+
+CpuSkinning::CpuSkinning() {
+  m_NumVertices = 0;
+  m_NumBones = 0;
+  m_NumInfluences = 0;
+}
+
+void CpuSkinning::Init(const SkeletalModel *pModel) {
+  const std::vector<VertexStruct> &Vertices = pModel->GetVertices();
+  const std::vector<VertexBoneData> &Bones = pModel->GetVertexBones();
+  const BoneInfluenceFormat &Format = pModel->GetBoneInfluenceFormat();
+
+  m_NumVertices = (unsigned int)Vertices.size();
+  m_NumBones = pModel->GetNumBones();
+  m_NumInfluences = Format.NumInfluences;
+  m_Streams.assign((size_t)NumStreams * m_NumVertices, 0.0f);
+  m_BoneIDs.assign((size_t)m_NumInfluences * m_NumVertices, 0);
+  m_Columns.assign((size_t)m_NumBones * 16, 0.0f);
+
+  // The weights go through the packing of the bone buffer, rounded the same.
+  std::vector<unsigned char> Packed(Format.GetStride());
+  const unsigned char *pWeights = &Packed[Format.GetIDsSize()];
+  float One = Format.WideWeights ? 65535.0f : 255.0f;
+  for (unsigned int v = 0; v < m_NumVertices; v++) {
+    const VertexStruct &Vertex = Vertices[v];
+    GetStream(PositionX)[v] = Vertex.position.x;
+    GetStream(PositionY)[v] = Vertex.position.y;
+    GetStream(PositionZ)[v] = Vertex.position.z;
+    GetStream(NormalX)[v] = Vertex.normal.x;
+    GetStream(NormalY)[v] = Vertex.normal.y;
+    GetStream(NormalZ)[v] = Vertex.normal.z;
+
+    Format.Pack(Bones[v], &Packed[0]);
+    for (unsigned int i = 0; i < m_NumInfluences; i++) {
+      float Weight = Format.WideWeights
+                         ? ((const unsigned short *)pWeights)[i] / One
+                         : pWeights[i] / One;
+      GetStream(Weights + i)[v] = Weight;
+      m_BoneIDs[(size_t)i * m_NumVertices + v] = (uint16_t)Bones[v].IDs[i];
+    }
+  }
+}
+
+void CpuSkinning::Skin(const Matrix4f *Palette, JobSystem *pJobs) {
+  if (m_NumVertices == 0) {
+    return;
+  }
+
+  // Column major, so a vertex is transformed by scaling the columns by its
+  // coordinates: no horizontal adds.
+  for (unsigned int b = 0; b < m_NumBones; b++) {
+    float *pColumns = &m_Columns[b * 16];
+    for (unsigned int c = 0; c < 4; c++) {
+      for (unsigned int r = 0; r < 4; r++) {
+        pColumns[c * 4 + r] = Palette[b].m[r][c];
+      }
+    }
+  }
+
+  // Every vertex only writes its own outputs.
+  if (pJobs) {
+    pJobs->ParallelFor(m_NumVertices, VERTICES_PER_JOB,
+                       [this](unsigned int Begin, unsigned int End) {
+                         SkinRange(Begin, End);
+                       });
+  } else {
+    SkinRange(0, m_NumVertices);
+  }
+}
+
+void CpuSkinning::SkinRange(unsigned int Begin, unsigned int End) {
+  const float *pColumns = &m_Columns[0];
+  const float *pIn[6];
+  float *pOut[6];
+  for (unsigned int s = 0; s < 6; s++) {
+    pIn[s] = GetStream(PositionX + s);
+    pOut[s] = GetStream(OutPositionX + s);
+  }
+
+  for (unsigned int v = Begin; v < End; v++) {
+    float x = pIn[0][v], y = pIn[1][v], z = pIn[2][v];
+    float nx = pIn[3][v], ny = pIn[4][v], nz = pIn[5][v];
+    float Position[4], Normal[4];
+
+#if defined(MATH3D_SIMD_AVX)
+    // Columns 0 and 1 in one register, 2 and 3 in the other.
+    __m256 Blend01 = _mm256_setzero_ps();
+    __m256 Blend23 = _mm256_setzero_ps();
+    for (unsigned int i = 0; i < m_NumInfluences; i++) {
+      size_t Stream = (size_t)i * m_NumVertices + v;
+      __m256 Weight = _mm256_set1_ps(GetStream(Weights + i)[v]);
+      const float *pBone = pColumns + m_BoneIDs[Stream] * 16;
+      Blend01 = _mm256_add_ps(Blend01,
+                              _mm256_mul_ps(Weight, _mm256_loadu_ps(pBone)));
+      Blend23 = _mm256_add_ps(
+          Blend23, _mm256_mul_ps(Weight, _mm256_loadu_ps(pBone + 8)));
+    }
+
+    __m256 p = _mm256_add_ps(
+        _mm256_mul_ps(Blend01, _mm256_setr_ps(x, x, x, x, y, y, y, y)),
+        _mm256_mul_ps(Blend23,
+                      _mm256_setr_ps(z, z, z, z, 1.0f, 1.0f, 1.0f, 1.0f)));
+    __m256 n = _mm256_add_ps(
+        _mm256_mul_ps(Blend01, _mm256_setr_ps(nx, nx, nx, nx, ny, ny, ny, ny)),
+        _mm256_mul_ps(Blend23, _mm256_setr_ps(nz, nz, nz, nz, 0.0f, 0.0f,
+                                              0.0f, 0.0f)));
+    _mm_storeu_ps(Position, _mm_add_ps(_mm256_castps256_ps128(p),
+                                       _mm256_extractf128_ps(p, 1)));
+    _mm_storeu_ps(Normal, _mm_add_ps(_mm256_castps256_ps128(n),
+                                     _mm256_extractf128_ps(n, 1)));
+#elif defined(MATH3D_SIMD_SSE)
+    __m128 Blend[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(),
+                       _mm_setzero_ps()};
+    for (unsigned int i = 0; i < m_NumInfluences; i++) {
+      size_t Stream = (size_t)i * m_NumVertices + v;
+      __m128 Weight = _mm_set1_ps(GetStream(Weights + i)[v]);
+      const float *pBone = pColumns + m_BoneIDs[Stream] * 16;
+      for (unsigned int c = 0; c < 4; c++) {
+        Blend[c] = _mm_add_ps(Blend[c],
+                              _mm_mul_ps(Weight, _mm_loadu_ps(pBone + c * 4)));
+      }
+    }
+
+    __m128 p = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(Blend[0], _mm_set1_ps(x)),
+                   _mm_mul_ps(Blend[1], _mm_set1_ps(y))),
+        _mm_add_ps(_mm_mul_ps(Blend[2], _mm_set1_ps(z)), Blend[3]));
+    __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Blend[0], _mm_set1_ps(nx)),
+                                     _mm_mul_ps(Blend[1], _mm_set1_ps(ny))),
+                          _mm_mul_ps(Blend[2], _mm_set1_ps(nz)));
+    _mm_storeu_ps(Position, p);
+    _mm_storeu_ps(Normal, n);
+#else
+    float Blend[16] = {0.0f};
+    for (unsigned int i = 0; i < m_NumInfluences; i++) {
+      size_t Stream = (size_t)i * m_NumVertices + v;
+      float Weight = GetStream(Weights + i)[v];
+      const float *pBone = pColumns + m_BoneIDs[Stream] * 16;
+      for (unsigned int j = 0; j < 16; j++) {
+        Blend[j] += Weight * pBone[j];
+      }
+    }
+
+    for (unsigned int r = 0; r < 4; r++) {
+      Position[r] =
+          Blend[r] * x + Blend[4 + r] * y + Blend[8 + r] * z + Blend[12 + r];
+      Normal[r] = Blend[r] * nx + Blend[4 + r] * ny + Blend[8 + r] * nz;
+    }
+#endif
+
+    pOut[0][v] = Position[0];
+    pOut[1][v] = Position[1];
+    pOut[2][v] = Position[2];
+
+    float Length = sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] +
+                         Normal[2] * Normal[2]);
+    float Scale = Length > 0.0f ? 1.0f / Length : 0.0f;
+    pOut[3][v] = Normal[0] * Scale;
+    pOut[4][v] = Normal[1] * Scale;
+    pOut[5][v] = Normal[2] * Scale;
+  }
+}
+
+Vector3f CpuSkinning::GetPosition(unsigned int Vertex) const {
+  return Vector3f(GetStream(OutPositionX)[Vertex],
+                  GetStream(OutPositionY)[Vertex],
+                  GetStream(OutPositionZ)[Vertex]);
+}
+
+Vector3f CpuSkinning::GetNormal(unsigned int Vertex) const {
+  return Vector3f(GetStream(OutNormalX)[Vertex], GetStream(OutNormalY)[Vertex],
+                  GetStream(OutNormalZ)[Vertex]);
+}
@@ -0,0 +1,86 @@
+#ifndef CPUSKINNING_H
+#define CPUSKINNING_H
+
+#include "JobSystem.h"
+#include "Math3D.h"
+#include "SkeletalModel.h"
+#include <stdint.h>
+#include <vector>
+
+// Skins the vertices of a SkeletalModel on the CPU, the same way as
+// shaders/diffuse.vert and skinning.cs, for ray picking, collision proxies
+// and checking the output of the shaders. The weights are quantized as in the
+// bone buffer, so the result matches the GPU's.
+//
+// The vertices are stored structure-of-arrays, one stream per component and
+// per influence. Every vertex blends its weighted bone matrices with SIMD
+// multiply-adds, a whole matrix in two AVX registers (four with SSE), and
+// the vertex ranges are split over a JobSystem.
+class CpuSkinning {
+public:
+  CpuSkinning(); //!< Constructor
+
+  void Init(const SkeletalModel *pModel); //!< Copies the vertices kept by
+                                          //!< the model into the streams,
+                                          //!< see SetKeepVertices.
+
+  void Skin(const Matrix4f *Palette,
+            JobSystem *pJobs = NULL); //!< Skins every vertex with the
+                                      //!< GetNumBones() matrices of the
+                                      //!< palette, on the JobSystem if any.
+
+  unsigned int GetNumVertices() const { return m_NumVertices; }
+
+  const float *GetPositions(unsigned int Axis) const {
+    return GetStream(OutPositionX + Axis);
+  } //!< Skinned model space positions along an axis, 0 to 2.
+  const float *GetNormals(unsigned int Axis) const {
+    return GetStream(OutNormalX + Axis);
+  } //!< Skinned model space normals, normalized.
+
+  Vector3f GetPosition(unsigned int Vertex) const;
+  Vector3f GetNormal(unsigned int Vertex) const;
+
+private:
+  // One float stream per input and output component.
+  enum Stream {
+    PositionX,
+    PositionY,
+    PositionZ,
+    NormalX,
+    NormalY,
+    NormalZ,
+    OutPositionX,
+    OutPositionY,
+    OutPositionZ,
+    OutNormalX,
+    OutNormalY,
+    OutNormalZ,
+    Weights, //!< First of the NumInfluences weight streams.
+    NumStreams = Weights + MAX_BONE_INFLUENCES
+  };
+
+  float *GetStream(unsigned int s) {
+    return m_Streams.data() + s * m_NumVertices;
+  }
+  const float *GetStream(unsigned int s) const {
+    return m_Streams.data() + s * m_NumVertices;
+  }
+
+  void SkinRange(unsigned int Begin,
+                 unsigned int End); //!< Skins the vertices [Begin, End) with
+                                    //!< m_Columns.
+
+  unsigned int m_NumVertices;
+  unsigned int m_NumBones;
+  unsigned int m_NumInfluences; //!< Per vertex, as in the bone buffer.
+
+  std::vector<float> m_Streams; //!< NumStreams streams of m_NumVertices.
+  std::vector<uint16_t>
+      m_BoneIDs; //!< NumInfluences streams of m_NumVertices bone indices.
+
+  std::vector<float> m_Columns; //!< The palette of the last Skin, 16 floats
+                                //!< per bone: its four columns.
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "GpuAnimation.h"
+
+#include "AnimationLibrary.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+// A joint as read by animation.cs, the transformations as their first three
+// rows.
+struct GpuJoint {
+  float Local[3][4];
+  float Offset[3][4]; //!< Identity if no vertex uses the joint.
+  float BindRotation[4];
+  float BindTranslation[4];
+  GLint Index;  //!< In the tracks of a clip.
+  GLint Parent; //!< In the sorted joints, -1 for the roots.
+  GLint Bone;   //!< -1 if no vertex uses the joint.
+  GLint Padding;
+};
+
+static_assert(sizeof(PackedKey) == 16, "animation.cs reads 16 byte keys");
+static_assert(sizeof(CompressedTrack) == 32,
+              "animation.cs reads 32 byte tracks");
+
+namespace {
+void CopyRows(const Matrix4f &m, float Rows[3][4]) {
+  memcpy(Rows, m.m, 3 * 4 * sizeof(float));
+}
+
+GLuint CreateBuffer(const void *pData, GLsizeiptr Size, GLenum Usage) {
+  GLuint Buffer;
+  glGenBuffers(1, &Buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, Buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, Size, pData, Usage);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return Buffer;
+}
+} // namespace
+
+GpuAnimation::GpuAnimation() {
+  m_pModel = NULL;
+  m_MaxInstances = 0;
+  m_SkeletonBuffer = 0;
+  m_TrackBuffer = 0;
+  m_KeyBuffer = 0;
+  m_InstanceBuffer = 0;
+  m_PaletteBuffer = 0;
+}
+
+GpuAnimation::~GpuAnimation() { Clear(); }
+
+void GpuAnimation::Clear() {
+  GLuint *Buffers[] = {&m_SkeletonBuffer, &m_TrackBuffer, &m_KeyBuffer,
+                       &m_InstanceBuffer, &m_PaletteBuffer};
+  for (unsigned int i = 0; i < sizeof(Buffers) / sizeof(Buffers[0]); i++) {
+    if (*Buffers[i] != 0) {
+      glDeleteBuffers(1, Buffers[i]);
+      *Buffers[i] = 0;
+    }
+  }
+}
+
+bool GpuAnimation::Init(const SkeletalModel *pModel,
+                        unsigned int MaxInstances) {
+  Clear();
+
+  m_pModel = pModel;
+  m_MaxInstances = MaxInstances;
+
+  const AnimationLibrary *pLibrary = pModel->GetAnimationLibrary();
+  const std::vector<Joint> &Joints = pModel->GetJoints();
+  unsigned int NumJoints = (unsigned int)Joints.size();
+  if (!pLibrary || pLibrary->GetNumClips() == 0 || NumJoints == 0) {
+    return false;
+  }
+  for (unsigned int c = 0; c < pLibrary->GetNumClips(); c++) {
+    if (pLibrary->GetClip(c).Compressed.IsEmpty()) {
+      printf("GPU animation: clip %u is not compressed\n", c);
+      return false;
+    }
+  }
+  if (NumJoints > GPU_ANIMATION_MAX_JOINTS) {
+    printf("GPU animation: %u joints, at most %d\n", NumJoints,
+           GPU_ANIMATION_MAX_JOINTS);
+    return false;
+  }
+
+  // Depth of every joint: the parents come first, so it's already known.
+  std::vector<unsigned int> Levels(NumJoints);
+  unsigned int NumLevels = 0;
+  for (unsigned int i = 0; i < NumJoints; i++) {
+    Levels[i] = Joints[i].Parent < 0 ? 0 : Levels[Joints[i].Parent] + 1;
+    NumLevels = std::max(NumLevels, Levels[i] + 1);
+  }
+  if (NumLevels > GPU_ANIMATION_MAX_LEVELS) {
+    printf("GPU animation: %u levels, at most %d\n", NumLevels,
+           GPU_ANIMATION_MAX_LEVELS);
+    return false;
+  }
+
+  // Sort the joints by level, keeping their order within a level, so the
+  // shader walks the hierarchy one level at a time.
+  std::vector<GLint> LevelStart(NumLevels + 1, 0);
+  for (unsigned int i = 0; i < NumJoints; i++) {
+    LevelStart[Levels[i] + 1]++;
+  }
+  for (unsigned int l = 0; l < NumLevels; l++) {
+    LevelStart[l + 1] += LevelStart[l];
+  }
+  std::vector<GLint> Sorted(NumJoints);
+  std::vector<GLint> Next(LevelStart.begin(), LevelStart.end() - 1);
+  for (unsigned int i = 0; i < NumJoints; i++) {
+    Sorted[i] = Next[Levels[i]]++;
+  }
+
+  std::vector<GpuJoint> GpuJoints(NumJoints);
+  Matrix4f Identity;
+  Identity.InitIdentity();
+  for (unsigned int i = 0; i < NumJoints; i++) {
+    const Joint &j = Joints[i];
+    GpuJoint &Out = GpuJoints[Sorted[i]];
+    CopyRows(j.LocalTransform, Out.Local);
+    CopyRows(j.Bone >= 0 ? pModel->GetBoneOffset(j.Bone) : Identity,
+             Out.Offset);
+    const Quaternion &r = j.BindKeys.StartRotation;
+    const Vector3f &t = j.BindKeys.StartTranslation;
+    float Rotation[4] = {r.x, r.y, r.z, r.w};
+    float Translation[4] = {t.x, t.y, t.z, 0.0f};
+    memcpy(Out.BindRotation, Rotation, sizeof(Rotation));
+    memcpy(Out.BindTranslation, Translation, sizeof(Translation));
+    Out.Index = (GLint)i;
+    Out.Parent = j.Parent < 0 ? -1 : Sorted[j.Parent];
+    Out.Bone = j.Bone;
+    Out.Padding = 0;
+  }
+
+  // The tracks and the keys of all the clips one after the other, the key
+  // ranges made relative to the whole key array.
+  std::vector<CompressedTrack> Tracks;
+  std::vector<PackedKey> Keys;
+  for (unsigned int c = 0; c < pLibrary->GetNumClips(); c++) {
+    const CompressedClip &Clip = pLibrary->GetClip(c).Compressed;
+    unsigned int FirstKey = (unsigned int)Keys.size();
+    for (unsigned int i = 0; i < NumJoints; i++) {
+      CompressedTrack Track;
+      if (i < Clip.GetNumJoints()) {
+        Track = Clip.GetTracks()[i];
+        Track.Keys.First += FirstKey;
+      }
+      Tracks.push_back(Track);
+    }
+    Keys.insert(Keys.end(), Clip.GetKeys().begin(), Clip.GetKeys().end());
+  }
+  if (Keys.empty()) {
+    // No empty buffer can be bound, no track points at this key.
+    Keys.resize(1);
+    memset(&Keys[0], 0, sizeof(PackedKey));
+  }
+
+  // The global inverse first, then the joints.
+  float GlobalInverse[3][4];
+  CopyRows(pModel->GetGlobalInverseTransform(), GlobalInverse);
+  GLsizeiptr JointsSize = (GLsizeiptr)(NumJoints * sizeof(GpuJoint));
+  m_SkeletonBuffer = CreateBuffer(NULL, sizeof(GlobalInverse) + JointsSize,
+                                  GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SkeletonBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GlobalInverse),
+                  GlobalInverse);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GlobalInverse), JointsSize,
+                  &GpuJoints[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  m_TrackBuffer =
+      CreateBuffer(&Tracks[0], (GLsizeiptr)(Tracks.size() * sizeof(Tracks[0])),
+                   GL_STATIC_DRAW);
+  m_KeyBuffer = CreateBuffer(
+      &Keys[0], (GLsizeiptr)(Keys.size() * sizeof(Keys[0])), GL_STATIC_DRAW);
+  m_InstanceBuffer = CreateBuffer(
+      NULL, (GLsizeiptr)(MaxInstances * sizeof(GpuAnimationInstance)),
+      GL_STREAM_DRAW);
+  m_PaletteBuffer = CreateBuffer(
+      NULL,
+      (GLsizeiptr)MaxInstances * pModel->GetNumBones() * sizeof(Matrix4f),
+      GL_DYNAMIC_COPY);
+
+  m_Instances.resize(MaxInstances);
+
+  if (!m_Program.isLinked()) {
+    m_Program.addDefine("MAX_JOINTS", GPU_ANIMATION_MAX_JOINTS);
+    m_Program.addDefine("MAX_LEVELS", GPU_ANIMATION_MAX_LEVELS);
+    try {
+      m_Program.compileShader(PROJECT_DIR
+                              "/src/6-skeleton_animation/shaders/animation.cs");
+      m_Program.link();
+    } catch (GLSLProgramException &e) {
+      std::cerr << e.what() << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  m_Program.use();
+  m_Program.setUniform("NumJoints", (int)NumJoints);
+  m_Program.setUniform("NumBones", (int)pModel->GetNumBones());
+  m_Program.setUniform("NumLevels", (int)NumLevels);
+  m_Program.setUniform("LevelStart", &LevelStart[0],
+                       (GLsizei)LevelStart.size());
+
+  printf("GPU animation: %u joints on %u levels, %u keys (%u bytes)\n",
+         NumJoints, NumLevels, (unsigned int)Keys.size(),
+         (unsigned int)(Keys.size() * sizeof(PackedKey) +
+                        Tracks.size() * sizeof(CompressedTrack) +
+                        NumJoints * sizeof(GpuJoint)));
+  return true;
+}
+
+void GpuAnimation::SetInstance(unsigned int Slot, const AnimationState &State,
+                               float TimeInSeconds) {
+  const AnimationLibrary *pLibrary = m_pModel->GetAnimationLibrary();
+
+  // The top two regular layers, without layers the first clip.
+  const AnimationLayer *pTop = NULL, *pBelow = NULL;
+  for (unsigned int l = State.NumLayers; l-- > 0;) {
+    if (State.Layers[l].Additive) {
+      continue;
+    }
+    if (!pTop) {
+      pTop = &State.Layers[l];
+    } else {
+      pBelow = &State.Layers[l];
+      break;
+    }
+  }
+
+  GpuAnimationInstance &Instance = m_Instances[Slot];
+  const AnimationLayer *pLayers[2] = {pBelow, pTop};
+  for (unsigned int i = 0; i < 2; i++) {
+    unsigned int Clip = pLayers[i] ? pLayers[i]->Clip : 0;
+    float StartTime = pLayers[i] ? pLayers[i]->StartTime : 0.0f;
+    Instance.Clips[i] = Clip;
+    Instance.Times[i] =
+        pLibrary->GetAnimationTime(Clip, TimeInSeconds - StartTime);
+  }
+  Instance.Blend = pBelow ? pTop->GetWeight(TimeInSeconds) : 1.0f;
+}
+
+void GpuAnimation::Dispatch(unsigned int NumInstances) {
+  if (NumInstances == 0 || !IsReady()) {
+    return;
+  }
+
+  // Orphaned, the previous frame's dispatch may still read it.
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_InstanceBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               (GLsizeiptr)(m_MaxInstances * sizeof(GpuAnimationInstance)),
+               NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                  (GLsizeiptr)(NumInstances * sizeof(GpuAnimationInstance)),
+                  &m_Instances[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  m_Program.use();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_PaletteBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_SkeletonBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_TrackBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_KeyBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_InstanceBuffer);
+
+  glDispatchCompute(NumInstances, 1, 1);
+
+  // The palettes are read as storage buffers by the skinning, compute or
+  // vertex shader, which stays bound at binding 0.
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
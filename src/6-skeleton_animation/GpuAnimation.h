@@ -0,0 +1,67 @@
+#ifndef GPUANIMATION_H
+#define GPUANIMATION_H
+
+#include "SkeletalModel.h"
+#include "glslprogram.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Largest skeleton the compute shader evaluates: its joints are kept in
+// shared memory, and its depth in a uniform array.
+#define GPU_ANIMATION_MAX_JOINTS 256
+#define GPU_ANIMATION_MAX_LEVELS 64
+
+// Clips played by an instance, as read by shaders/animation.cs: a
+// cross-fade from the first clip to the second one.
+struct GpuAnimationInstance {
+  GLuint Clips[2]; //!< Indices in the AnimationLibrary.
+  float Times[2];  //!< Ticks, wrapped around the duration of the clip.
+  float Blend;     //!< Weight of the second clip, 1 plays it alone.
+};
+
+// Evaluates the palettes of the crowd on the GPU with a compute shader. The
+// compressed tracks of every clip and the skeleton, sorted by depth, are
+// uploaded once; every frame only the clips and the times of the visible
+// instances are, and the shader writes their palettes straight into the
+// buffer the skinning reads. The top two regular layers of an instance are
+// blended, additive layers are ignored.
+class GpuAnimation {
+public:
+  GpuAnimation();  //!< Constructor
+  ~GpuAnimation(); //!< Destructor
+
+  bool Init(const SkeletalModel *pModel,
+            unsigned int MaxInstances); //!< Uploads the skeleton and the
+                                        //!< clips, false if they aren't all
+                                        //!< compressed or the skeleton is
+                                        //!< too large.
+
+  bool IsReady() const { return m_PaletteBuffer != 0; }
+
+  void SetInstance(unsigned int Slot, const AnimationState &State,
+                   float TimeInSeconds); //!< Clips of the instance drawn in
+                                         //!< the slot, at its playback time.
+
+  void Dispatch(unsigned int NumInstances); //!< Uploads the first
+                                            //!< NumInstances slots, evaluates
+                                            //!< their palettes and binds them
+                                            //!< at binding 0.
+
+private:
+  void Clear(); //!< Deletes the buffers.
+
+  const SkeletalModel *m_pModel;
+  unsigned int m_MaxInstances;
+
+  GLSLProgram m_Program; //!< animation.cs
+
+  GLuint m_SkeletonBuffer; //!< Global inverse, then the sorted joints.
+  GLuint m_TrackBuffer;    //!< GetNumJoints() tracks per clip.
+  GLuint m_KeyBuffer;      //!< Packed keys of all the clips.
+  GLuint m_InstanceBuffer; //!< GpuAnimationInstance per slot.
+  GLuint m_PaletteBuffer;  //!< GetNumBones() matrices per slot.
+
+  std::vector<GpuAnimationInstance> m_Instances; //!< Staged for Dispatch.
+};
+
+#endif
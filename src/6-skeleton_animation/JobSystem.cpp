@@ -0,0 +1,144 @@
+#include "JobSystem.h"
+
+#include "AllocationTracker.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int NumThreads) {
+  m_Generation = 0;
+  m_Quit = false;
+  m_Function = NULL;
+  m_Scope = NULL;
+  m_Pending = 0;
+
+  if (NumThreads == 0) {
+    NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  for (unsigned int i = 0; i < NumThreads; i++) {
+    m_Queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+  }
+
+  // The calling thread works too, so one thread less is started.
+  for (unsigned int i = 1; i < NumThreads; i++) {
+    m_Threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    m_Quit = true;
+  }
+  m_WakeUp.notify_all();
+
+  for (unsigned int i = 0; i < m_Threads.size(); i++) {
+    m_Threads[i].join();
+  }
+}
+
+void JobSystem::ParallelFor(unsigned int Count, unsigned int Grain,
+                            const RangeFunction &Function) {
+  if (Count == 0) {
+    return;
+  }
+  Grain = std::max(Grain, 1u);
+  if (m_Threads.empty() || Count <= Grain) {
+    Function(0, Count);
+    return;
+  }
+
+  // The function is published before the jobs: a worker reads it after
+  // taking a job out of a queue, under the same queue lock.
+  unsigned int NumJobs = (Count + Grain - 1) / Grain;
+  {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    m_Function = &Function;
+    m_Scope = AllocationScope::GetCurrent();
+    m_Pending = NumJobs;
+  }
+
+  // Deal the chunks round robin, neighbouring chunks end up in different
+  // queues and each thread starts from its own share.
+  for (unsigned int i = 0; i < NumJobs; i++) {
+    Job job;
+    job.Begin = i * Grain;
+    job.End = std::min(job.Begin + Grain, Count);
+
+    JobQueue &Queue = *m_Queues[i % m_Queues.size()];
+    std::lock_guard<std::mutex> Lock(Queue.Mutex);
+    Queue.Jobs.push_back(job);
+  }
+
+  {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    m_Generation++;
+  }
+  m_WakeUp.notify_all();
+
+  RunJobs(0);
+
+  std::unique_lock<std::mutex> Lock(m_Mutex);
+  m_Done.wait(Lock, [this] { return m_Pending == 0; });
+}
+
+bool JobSystem::PopJob(unsigned int Queue, Job &Out) {
+  // Newest job of the own queue...
+  {
+    JobQueue &Own = *m_Queues[Queue];
+    std::lock_guard<std::mutex> Lock(Own.Mutex);
+    if (!Own.Empty()) {
+      Out = Own.Jobs.back();
+      Own.Jobs.pop_back();
+      Recycle(Own);
+      return true;
+    }
+  }
+
+  // ...or the oldest one of another thread.
+  for (unsigned int i = 1; i < m_Queues.size(); i++) {
+    JobQueue &Victim = *m_Queues[(Queue + i) % m_Queues.size()];
+    std::lock_guard<std::mutex> Lock(Victim.Mutex);
+    if (!Victim.Empty()) {
+      Out = Victim.Jobs[Victim.Head++];
+      Recycle(Victim);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::Recycle(JobQueue &Queue) {
+  if (Queue.Empty()) {
+    Queue.Jobs.clear();
+    Queue.Head = 0;
+  }
+}
+
+void JobSystem::RunJobs(unsigned int Queue) {
+  Job job;
+  while (PopJob(Queue, job)) {
+    // The allocations of the job count for the code that queued it.
+    AllocationScope Scope(m_Scope);
+    (*m_Function)(job.Begin, job.End);
+
+    if (--m_Pending == 0) {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_Done.notify_all();
+    }
+  }
+}
+
+void JobSystem::WorkerLoop(unsigned int Queue) {
+  unsigned int Generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> Lock(m_Mutex);
+      m_WakeUp.wait(Lock, [&] { return m_Quit || m_Generation != Generation; });
+      if (m_Quit) {
+        return;
+      }
+      Generation = m_Generation;
+    }
+    RunJobs(Queue);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running the chunks of parallel loops. Every
+// thread (the caller of ParallelFor included) owns a queue of chunks and, when
+// it runs out, steals from the queues of the others, so an uneven split or a
+// thread descheduled by the OS still keeps all the cores busy.
+class JobSystem {
+public:
+  typedef std::function<void(unsigned int Begin, unsigned int End)>
+      RangeFunction;
+
+  explicit JobSystem(unsigned int NumThreads = 0); //!< 0 uses one thread per
+                                                   //!< hardware thread.
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  void ParallelFor(unsigned int Count, unsigned int Grain,
+                   const RangeFunction &Function); //!< Calls Function on
+                                                   //!< chunks of at most
+                                                   //!< Grain items covering
+                                                   //!< [0, Count), returns
+                                                   //!< when all are done.
+
+  unsigned int GetNumThreads() const { return (unsigned int)m_Queues.size(); }
+
+private:
+  struct Job {
+    unsigned int Begin;
+    unsigned int End;
+  };
+
+  // The jobs still queued are [Head, Jobs.size()). The vector is cleared,
+  // not freed, once empty, so queuing stops allocating after the first loops.
+  struct JobQueue {
+    std::mutex Mutex;
+    std::vector<Job> Jobs;
+    size_t Head;
+
+    JobQueue() : Head(0) {}
+    bool Empty() const { return Head == Jobs.size(); }
+  };
+
+  bool PopJob(unsigned int Queue, Job &Out); //!< Own queue first, then steal.
+  void RunJobs(unsigned int Queue); //!< Runs jobs until all queues are empty.
+  static void Recycle(JobQueue &Queue); //!< Rewinds an empty queue.
+  void WorkerLoop(unsigned int Queue);
+
+  std::vector<std::thread> m_Threads;
+  std::vector<std::unique_ptr<JobQueue>> m_Queues; //!< 0 is the caller's.
+
+  std::mutex m_Mutex;
+  std::condition_variable m_WakeUp; //!< A new loop has been queued.
+  std::condition_variable m_Done;   //!< The last job of a loop has finished.
+  unsigned int m_Generation;        //!< Incremented for every loop.
+  bool m_Quit;
+
+  const RangeFunction *m_Function;     //!< Body of the current loop.
+  const char *m_Scope;                 //!< AllocationScope of the caller.
+  std::atomic<unsigned int> m_Pending; //!< Jobs of the current loop not done.
+};
+
+#endif
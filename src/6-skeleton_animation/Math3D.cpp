@@ -135,6 +135,35 @@ void Matrix4f::InitRotateTransform(float RotateX, float RotateY,
   *this = rz * ry * rx;
 }
 
+void Matrix4f::InitRotateTransform(const Quaternion &quat) {
+  const float yy2 = 2.0f * quat.y * quat.y;
+  const float xy2 = 2.0f * quat.x * quat.y;
+  const float xz2 = 2.0f * quat.x * quat.z;
+  const float yz2 = 2.0f * quat.y * quat.z;
+  const float zz2 = 2.0f * quat.z * quat.z;
+  const float wz2 = 2.0f * quat.w * quat.z;
+  const float wy2 = 2.0f * quat.w * quat.y;
+  const float wx2 = 2.0f * quat.w * quat.x;
+  const float xx2 = 2.0f * quat.x * quat.x;
+
+  m[0][0] = 1.0f - yy2 - zz2;
+  m[0][1] = xy2 - wz2;
+  m[0][2] = xz2 + wy2;
+  m[0][3] = 0.0f;
+  m[1][0] = xy2 + wz2;
+  m[1][1] = 1.0f - xx2 - zz2;
+  m[1][2] = yz2 - wx2;
+  m[1][3] = 0.0f;
+  m[2][0] = xz2 - wy2;
+  m[2][1] = yz2 + wx2;
+  m[2][2] = 1.0f - xx2 - yy2;
+  m[2][3] = 0.0f;
+  m[3][0] = 0.0f;
+  m[3][1] = 0.0f;
+  m[3][2] = 0.0f;
+  m[3][3] = 1.0f;
+}
+
 void Matrix4f::InitTranslationTransform(float x, float y, float z) {
   m[0][0] = 1.0f;
   m[0][1] = 0.0f;
@@ -294,6 +323,147 @@ Matrix4f &Matrix4f::Inverse() {
   return *this;
 }
 
+namespace {
+#ifdef MATH3D_SIMD
+inline __m128 Cross(__m128 a, __m128 b) {
+  __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+  __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+  return _mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx));
+}
+#endif
+} // namespace
+
+Matrix4f &Matrix4f::InverseAffine() {
+  // The columns of the 3x3 inverse are the cross products of the rows over
+  // the determinant, the translation is moved back by the inverse.
+#ifdef MATH3D_SIMD
+  __m128 Mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+  __m128 r0 = _mm_and_ps(_mm_loadu_ps(m[0]), Mask);
+  __m128 r1 = _mm_and_ps(_mm_loadu_ps(m[1]), Mask);
+  __m128 r2 = _mm_and_ps(_mm_loadu_ps(m[2]), Mask);
+
+  __m128 c0 = Cross(r1, r2);
+  __m128 c1 = Cross(r2, r0);
+  __m128 c2 = Cross(r0, r1);
+
+  float d[4];
+  _mm_storeu_ps(d, _mm_mul_ps(r0, c0));
+  float det = d[0] + d[1] + d[2];
+  if (det == 0.0f) {
+    assert(0);
+    return *this;
+  }
+
+  __m128 c3 = _mm_mul_ps(c0, _mm_set1_ps(m[0][3]));
+  c3 = _mm_add_ps(c3, _mm_mul_ps(c1, _mm_set1_ps(m[1][3])));
+  c3 = _mm_add_ps(c3, _mm_mul_ps(c2, _mm_set1_ps(m[2][3])));
+  c3 = _mm_sub_ps(_mm_setzero_ps(), c3);
+
+  // The columns become rows, the translation their last element.
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  __m128 InvDet = _mm_set1_ps(1.0f / det);
+  _mm_storeu_ps(m[0], _mm_mul_ps(c0, InvDet));
+  _mm_storeu_ps(m[1], _mm_mul_ps(c1, InvDet));
+  _mm_storeu_ps(m[2], _mm_mul_ps(c2, InvDet));
+#else
+  Vector3f r0(m[0][0], m[0][1], m[0][2]);
+  Vector3f r1(m[1][0], m[1][1], m[1][2]);
+  Vector3f r2(m[2][0], m[2][1], m[2][2]);
+  Vector3f c0 = r1.Cross(r2), c1 = r2.Cross(r0), c2 = r0.Cross(r1);
+
+  float det = r0.x * c0.x + r0.y * c0.y + r0.z * c0.z;
+  if (det == 0.0f) {
+    assert(0);
+    return *this;
+  }
+
+  float invdet = 1.0f / det;
+  Vector3f t(m[0][3], m[1][3], m[2][3]);
+  m[0][0] = c0.x * invdet;
+  m[0][1] = c1.x * invdet;
+  m[0][2] = c2.x * invdet;
+  m[1][0] = c0.y * invdet;
+  m[1][1] = c1.y * invdet;
+  m[1][2] = c2.y * invdet;
+  m[2][0] = c0.z * invdet;
+  m[2][1] = c1.z * invdet;
+  m[2][2] = c2.z * invdet;
+  for (unsigned int i = 0; i < 3; i++) {
+    m[i][3] = -(m[i][0] * t.x + m[i][1] * t.y + m[i][2] * t.z);
+  }
+#endif
+  m[3][0] = 0.0f;
+  m[3][1] = 0.0f;
+  m[3][2] = 0.0f;
+  m[3][3] = 1.0f;
+
+  return *this;
+}
+
+void Matrix4f::MultiplyAffine(const Matrix4f &Left, const Matrix4f &Right,
+                              Matrix4f &Out) {
+#ifdef MATH3D_SIMD
+  // Each row of the result is a combination of the rows of Right, whose last
+  // row only adds the translation.
+  __m128 r0 = _mm_loadu_ps(Right.m[0]);
+  __m128 r1 = _mm_loadu_ps(Right.m[1]);
+  __m128 r2 = _mm_loadu_ps(Right.m[2]);
+  __m128 r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+  for (unsigned int i = 0; i < 3; i++) {
+    __m128 Row = _mm_mul_ps(_mm_set1_ps(Left.m[i][0]), r0);
+    Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(Left.m[i][1]), r1));
+    Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(Left.m[i][2]), r2));
+    Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(Left.m[i][3]), r3));
+    _mm_storeu_ps(Out.m[i], Row);
+  }
+#else
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int j = 0; j < 3; j++) {
+      Out.m[i][j] = Left.m[i][0] * Right.m[0][j] +
+                    Left.m[i][1] * Right.m[1][j] +
+                    Left.m[i][2] * Right.m[2][j];
+    }
+    Out.m[i][3] = Left.m[i][0] * Right.m[0][3] + Left.m[i][1] * Right.m[1][3] +
+                  Left.m[i][2] * Right.m[2][3] + Left.m[i][3];
+  }
+#endif
+  Out.m[3][0] = 0.0f;
+  Out.m[3][1] = 0.0f;
+  Out.m[3][2] = 0.0f;
+  Out.m[3][3] = 1.0f;
+}
+
+void Matrix4f::TransformPoints(const Vector3f *In, unsigned int NumPoints,
+                               Vector3f *Out) const {
+#ifdef MATH3D_SIMD
+  // The columns, once, then every point is three multiply-adds.
+  __m128 c0 = _mm_loadu_ps(m[0]);
+  __m128 c1 = _mm_loadu_ps(m[1]);
+  __m128 c2 = _mm_loadu_ps(m[2]);
+  __m128 c3 = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+  for (unsigned int i = 0; i < NumPoints; i++) {
+    __m128 p = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(In[i].x)));
+    p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(In[i].y)));
+    p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(In[i].z)));
+
+    float r[4];
+    _mm_storeu_ps(r, p);
+    Out[i] = Vector3f(r[0], r[1], r[2]);
+  }
+#else
+  for (unsigned int i = 0; i < NumPoints; i++) {
+    Vector3f p = In[i];
+    Out[i] = Vector3f(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                      m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                      m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+  }
+#endif
+}
+
 Quaternion::Quaternion(float _x, float _y, float _z, float _w) {
   x = _x;
   y = _y;
@@ -315,6 +485,94 @@ Quaternion Quaternion::Conjugate() {
   return ret;
 }
 
+void Quaternion::Interpolate(Quaternion &Out, const Quaternion &Start,
+                             const Quaternion &End, float Factor) {
+  // calc cosine theta
+  float cosom =
+      Start.x * End.x + Start.y * End.y + Start.z * End.z + Start.w * End.w;
+
+  // adjust signs (if necessary)
+  Quaternion end = End;
+  if (cosom < 0.0f) {
+    cosom = -cosom;
+    end.x = -end.x;
+    end.y = -end.y;
+    end.z = -end.z;
+    end.w = -end.w;
+  }
+
+  // Calculate coefficients
+  float sclp, sclq;
+  if ((1.0f - cosom) > 0.0001f) {
+    // Standard case (slerp)
+    float omega = acosf(cosom);
+    float sinom = sinf(omega);
+    sclp = sinf((1.0f - Factor) * omega) / sinom;
+    sclq = sinf(Factor * omega) / sinom;
+  } else {
+    // Very close, do linear interpolation (because it's faster)
+    sclp = 1.0f - Factor;
+    sclq = Factor;
+  }
+
+  Out.x = sclp * Start.x + sclq * end.x;
+  Out.y = sclp * Start.y + sclq * end.y;
+  Out.z = sclp * Start.z + sclq * end.z;
+  Out.w = sclp * Start.w + sclq * end.w;
+}
+
+void DualQuaternion::InitFromTransform(const Matrix4f &Transform) {
+  // Normalize the columns to take the scale out of the rotation.
+  float r[3][3];
+  for (unsigned int j = 0; j < 3; j++) {
+    float Length = sqrtf(Transform.m[0][j] * Transform.m[0][j] +
+                         Transform.m[1][j] * Transform.m[1][j] +
+                         Transform.m[2][j] * Transform.m[2][j]);
+    float Scale = Length > 0.0f ? 1.0f / Length : 0.0f;
+    for (unsigned int i = 0; i < 3; i++) {
+      r[i][j] = Transform.m[i][j] * Scale;
+    }
+  }
+
+  // Rotation matrix to quaternion, from the largest of w, x, y and z to keep
+  // the square root away from zero.
+  float Trace = r[0][0] + r[1][1] + r[2][2];
+  if (Trace > 0.0f) {
+    float s = sqrtf(Trace + 1.0f) * 2.0f;
+    Real.w = 0.25f * s;
+    Real.x = (r[2][1] - r[1][2]) / s;
+    Real.y = (r[0][2] - r[2][0]) / s;
+    Real.z = (r[1][0] - r[0][1]) / s;
+  } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+    float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+    Real.w = (r[2][1] - r[1][2]) / s;
+    Real.x = 0.25f * s;
+    Real.y = (r[0][1] + r[1][0]) / s;
+    Real.z = (r[0][2] + r[2][0]) / s;
+  } else if (r[1][1] > r[2][2]) {
+    float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+    Real.w = (r[0][2] - r[2][0]) / s;
+    Real.x = (r[0][1] + r[1][0]) / s;
+    Real.y = 0.25f * s;
+    Real.z = (r[1][2] + r[2][1]) / s;
+  } else {
+    float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+    Real.w = (r[1][0] - r[0][1]) / s;
+    Real.x = (r[0][2] + r[2][0]) / s;
+    Real.y = (r[1][2] + r[2][1]) / s;
+    Real.z = 0.25f * s;
+  }
+  Real.Normalize();
+
+  Quaternion Translation(Transform.m[0][3], Transform.m[1][3],
+                         Transform.m[2][3], 0.0f);
+  Dual = Translation * Real;
+  Dual.x *= 0.5f;
+  Dual.y *= 0.5f;
+  Dual.z *= 0.5f;
+  Dual.w *= 0.5f;
+}
+
 Quaternion operator*(const Quaternion &l, const Quaternion &r) {
   const float w = (l.w * r.w) - (l.x * r.x) - (l.y * r.y) - (l.z * r.z);
   const float x = (l.x * r.w) + (l.w * r.x) + (l.y * r.z) - (l.z * r.y);
@@ -11,6 +11,18 @@
 #endif
 #define _USE_MATH_DEFINES
 
+// Matrix4f products four floats at a time with SSE, eight with AVX.
+#if defined(__AVX__)
+#define MATH3D_SIMD
+#define MATH3D_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH3D_SIMD
+#define MATH3D_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
 #include <assimp/matrix3x3.h>
 #include <assimp/matrix4x4.h>
 #include <assimp/vector3.h>
@@ -127,6 +139,11 @@ struct PersProjInfo {
   float zFar;
 };
 
+struct Quaternion;
+
+// Row-major, m[row][column], transforming column vectors: the layout of
+// aiMatrix4x4, copied as is. The bone palettes are read by the shaders as
+// row_major std430 arrays, so they are uploaded without any transpose.
 class Matrix4f {
 public:
   float m[4][4];
@@ -232,16 +249,70 @@ public:
   inline Matrix4f operator*(const Matrix4f &Right) const {
     Matrix4f Ret;
 
+    // Each row of the product is a combination of the rows of Right, with
+    // the weights in the same row of this matrix.
+#if defined(MATH3D_SIMD_AVX)
+    // Two rows at a time: both halves of a register hold the same row of
+    // Right, the shuffles splat a weight within each half.
+    __m128 r0 = _mm_loadu_ps(Right.m[0]);
+    __m128 r1 = _mm_loadu_ps(Right.m[1]);
+    __m128 r2 = _mm_loadu_ps(Right.m[2]);
+    __m128 r3 = _mm_loadu_ps(Right.m[3]);
+    __m256 rr0 = _mm256_insertf128_ps(_mm256_castps128_ps256(r0), r0, 1);
+    __m256 rr1 = _mm256_insertf128_ps(_mm256_castps128_ps256(r1), r1, 1);
+    __m256 rr2 = _mm256_insertf128_ps(_mm256_castps128_ps256(r2), r2, 1);
+    __m256 rr3 = _mm256_insertf128_ps(_mm256_castps128_ps256(r3), r3, 1);
+    for (unsigned int i = 0; i < 4; i += 2) {
+      __m256 l = _mm256_loadu_ps(m[i]);
+      __m256 Rows = _mm256_mul_ps(_mm256_shuffle_ps(l, l, 0x00), rr0);
+      Rows = _mm256_add_ps(
+          Rows, _mm256_mul_ps(_mm256_shuffle_ps(l, l, 0x55), rr1));
+      Rows = _mm256_add_ps(
+          Rows, _mm256_mul_ps(_mm256_shuffle_ps(l, l, 0xAA), rr2));
+      Rows = _mm256_add_ps(
+          Rows, _mm256_mul_ps(_mm256_shuffle_ps(l, l, 0xFF), rr3));
+      _mm256_storeu_ps(Ret.m[i], Rows);
+    }
+#elif defined(MATH3D_SIMD_SSE)
+    __m128 r0 = _mm_loadu_ps(Right.m[0]);
+    __m128 r1 = _mm_loadu_ps(Right.m[1]);
+    __m128 r2 = _mm_loadu_ps(Right.m[2]);
+    __m128 r3 = _mm_loadu_ps(Right.m[3]);
+    for (unsigned int i = 0; i < 4; i++) {
+      __m128 Row = _mm_mul_ps(_mm_set1_ps(m[i][0]), r0);
+      Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][1]), r1));
+      Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][2]), r2));
+      Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][3]), r3));
+      _mm_storeu_ps(Ret.m[i], Row);
+    }
+#else
     for (unsigned int i = 0; i < 4; i++) {
       for (unsigned int j = 0; j < 4; j++) {
         Ret.m[i][j] = m[i][0] * Right.m[0][j] + m[i][1] * Right.m[1][j] +
                       m[i][2] * Right.m[2][j] + m[i][3] * Right.m[3][j];
       }
     }
+#endif
 
     return Ret;
   }
 
+  static void MultiplyAffine(
+      const Matrix4f &Left, const Matrix4f &Right,
+      Matrix4f &Out); //!< Left * Right for matrices whose last row is
+                      //!< (0, 0, 0, 1), such as all the joint matrices. Out
+                      //!< can't be Right.
+
+  Vector3f TransformPoint(const Vector3f &p) const {
+    Vector3f r;
+    TransformPoints(&p, 1, &r);
+    return r;
+  } //!< Affine transformation of a point, the last row is ignored.
+
+  void TransformPoints(const Vector3f *In, unsigned int NumPoints,
+                       Vector3f *Out) const; //!< Same as above for many
+                                             //!< points, In can be Out.
+
   Vector4f operator*(const Vector4f &v) const {
     Vector4f r;
 
@@ -262,9 +333,13 @@ public:
   float Determinant() const;
 
   Matrix4f &Inverse();
+  Matrix4f &InverseAffine(); //!< Inverse of a matrix whose last row is
+                             //!< (0, 0, 0, 1), a 3x3 inverse and a
+                             //!< translation.
 
   void InitScaleTransform(float ScaleX, float ScaleY, float ScaleZ);
   void InitRotateTransform(float RotateX, float RotateY, float RotateZ);
+  void InitRotateTransform(const Quaternion &quat);
   void InitTranslationTransform(float x, float y, float z);
   void InitCameraTransform(const Vector3f &Target, const Vector3f &Up);
   void InitPersProjTransform(const PersProjInfo &p);
@@ -273,11 +348,30 @@ public:
 struct Quaternion {
   float x, y, z, w;
 
+  Quaternion() {}
+
   Quaternion(float _x, float _y, float _z, float _w);
 
   void Normalize();
 
   Quaternion Conjugate();
+
+  // Spherical interpolation along the shortest arc, same as
+  // aiQuaternion::Interpolate.
+  static void Interpolate(Quaternion &Out, const Quaternion &Start,
+                          const Quaternion &End, float Factor);
+};
+
+// Rigid transformation as a unit dual quaternion: 8 floats, half a matrix.
+struct DualQuaternion {
+  Quaternion Real; //!< Rotation.
+  Quaternion Dual; //!< Translation, 0.5 * t * Real.
+
+  DualQuaternion() {}
+
+  // Rotation and translation of an affine transformation, the scale of the
+  // 3x3 block is dropped.
+  void InitFromTransform(const Matrix4f &Transform);
 };
 
 Quaternion operator*(const Quaternion &l, const Quaternion &r);
@@ -0,0 +1,168 @@
+#include "PaletteBuffer.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace {
+void CopyBlocks(unsigned char *pDst, const void *pData, GLsizeiptr BlockSize,
+                const unsigned int *pBlocks, unsigned int NumBlocks) {
+  const unsigned char *pSrc = (const unsigned char *)pData;
+  if (!pBlocks) {
+    memcpy(pDst, pSrc, BlockSize);
+    return;
+  }
+  for (unsigned int i = 0; i < NumBlocks; i++) {
+    memcpy(pDst + i * BlockSize, pSrc + pBlocks[i] * BlockSize, BlockSize);
+  }
+}
+} // namespace
+
+PaletteBuffer::PaletteBuffer() {
+  m_Buffer = 0;
+  m_Binding = 0;
+  m_RegionSize = 0;
+  m_Region = 0;
+  m_pMapped = NULL;
+  m_Written = false;
+
+  for (unsigned int i = 0; i < PALETTE_BUFFER_REGIONS; i++) {
+    m_Fences[i] = 0;
+  }
+}
+
+PaletteBuffer::~PaletteBuffer() { Clear(); }
+
+void PaletteBuffer::Clear() {
+  for (unsigned int i = 0; i < PALETTE_BUFFER_REGIONS; i++) {
+    if (m_Fences[i]) {
+      glDeleteSync(m_Fences[i]);
+      m_Fences[i] = 0;
+    }
+  }
+
+  if (m_Buffer != 0) {
+    if (m_pMapped) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+      glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+      m_pMapped = NULL;
+    }
+    glDeleteBuffers(1, &m_Buffer);
+    m_Buffer = 0;
+  }
+}
+
+void PaletteBuffer::Init(GLuint Binding, unsigned int MaxMatrices) {
+  Clear();
+
+  m_Binding = Binding;
+  m_Region = 0;
+  m_Written = false;
+
+  // Every region starts at an offset glBindBufferRange accepts.
+  GLint Alignment = 1;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+  m_RegionSize = MaxMatrices * sizeof(Matrix4f);
+  m_RegionSize = (m_RegionSize + Alignment - 1) / Alignment * Alignment;
+
+  glGenBuffers(1, &m_Buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+
+  if (GLAD_GL_VERSION_4_4) {
+    GLbitfield Flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+                    m_RegionSize * PALETTE_BUFFER_REGIONS, NULL, Flags);
+    m_pMapped = (unsigned char *)glMapBufferRange(
+        GL_SHADER_STORAGE_BUFFER, 0, m_RegionSize * PALETTE_BUFFER_REGIONS,
+        Flags);
+  } else {
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_RegionSize, NULL,
+                 GL_STREAM_DRAW);
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void PaletteBuffer::Upload(const Matrix4f *pMatrices,
+                           unsigned int NumMatrices) {
+  UploadData(pMatrices, NumMatrices * sizeof(Matrix4f), NULL, 1);
+}
+
+void PaletteBuffer::Upload(const DualQuaternion *pDualQuaternions,
+                           unsigned int NumDualQuaternions) {
+  UploadData(pDualQuaternions, NumDualQuaternions * sizeof(DualQuaternion),
+             NULL, 1);
+}
+
+void PaletteBuffer::Upload(const Matrix4f *pPalettes, unsigned int PaletteSize,
+                           const unsigned int *pInstances,
+                           unsigned int NumInstances) {
+  UploadData(pPalettes, PaletteSize * sizeof(Matrix4f), pInstances,
+             NumInstances);
+}
+
+void PaletteBuffer::Upload(const DualQuaternion *pPalettes,
+                           unsigned int PaletteSize,
+                           const unsigned int *pInstances,
+                           unsigned int NumInstances) {
+  UploadData(pPalettes, PaletteSize * sizeof(DualQuaternion), pInstances,
+             NumInstances);
+}
+
+void PaletteBuffer::UploadData(const void *pData, GLsizeiptr BlockSize,
+                               const unsigned int *pBlocks,
+                               unsigned int NumBlocks) {
+  GLsizeiptr Size = BlockSize * NumBlocks;
+  assert(Size <= m_RegionSize);
+  if (Size == 0) {
+    return;
+  }
+
+  if (m_pMapped) {
+    // Wait for the GPU to be done with the frame that last used the region,
+    // it is normally long finished.
+    GLsync &RegionFence = m_Fences[m_Region];
+    if (RegionFence) {
+      while (glClientWaitSync(RegionFence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              1000000) == GL_TIMEOUT_EXPIRED) {
+      }
+      glDeleteSync(RegionFence);
+      RegionFence = 0;
+    }
+
+    // Coherent mapping: no flush or unmap needed.
+    CopyBlocks(m_pMapped + m_Region * m_RegionSize, pData, BlockSize,
+               pBlocks, NumBlocks);
+    m_Written = true;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, m_Binding, m_Buffer,
+                      m_Region * m_RegionSize, m_RegionSize);
+  } else {
+    // Orphan the storage the GPU may still be reading.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_RegionSize, NULL,
+                 GL_STREAM_DRAW);
+    unsigned char *pDst = (unsigned char *)glMapBufferRange(
+        GL_SHADER_STORAGE_BUFFER, 0, Size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (pDst) {
+      CopyBlocks(pDst, pData, BlockSize, pBlocks, NumBlocks);
+      glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, m_Binding, m_Buffer, 0,
+                      m_RegionSize);
+  }
+}
+
+void PaletteBuffer::Fence() {
+  // A frame without an Upload (baked or GPU evaluated palettes, nothing
+  // visible) keeps the region: its fence, if any, is still pending and owned
+  // by the next Upload.
+  if (!m_pMapped || !m_Written) {
+    return;
+  }
+
+  m_Written = false;
+  m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_Region = (m_Region + 1) % PALETTE_BUFFER_REGIONS;
+}
@@ -0,0 +1,71 @@
+#ifndef PALETTEBUFFER_H
+#define PALETTEBUFFER_H
+
+#include "Math3D.h"
+#include <glad/glad.h>
+
+// Number of frames the CPU can be ahead of the GPU.
+#define PALETTE_BUFFER_REGIONS 3
+
+// Shader storage buffer streaming the bone palettes of all the characters to
+// the GPU, one upload per frame. The buffer is mapped once, persistently, and
+// split in three regions: while the GPU may still read the two previous frames
+// the CPU writes the third one, a fence per region tells when it can be
+// written again. Without GL 4.4 the buffer is orphaned and rewritten instead.
+class PaletteBuffer {
+public:
+  PaletteBuffer();  //!< Constructor
+  ~PaletteBuffer(); //!< Destructor
+
+  void Init(GLuint Binding,
+            unsigned int MaxMatrices); //!< Creates the buffer for up to
+                                       //!< MaxMatrices matrices per frame.
+
+  void Upload(const Matrix4f *pMatrices,
+              unsigned int NumMatrices); //!< Copies the matrices of this
+                                         //!< frame and binds them.
+
+  void Upload(const DualQuaternion *pDualQuaternions,
+              unsigned int NumDualQuaternions); //!< Same for dual quaternion
+                                                //!< palettes, half the size.
+
+  void Upload(const Matrix4f *pPalettes, unsigned int PaletteSize,
+              const unsigned int *pInstances,
+              unsigned int NumInstances); //!< Copies the palettes of the
+                                          //!< listed instances only, packed
+                                          //!< in the order of the list, and
+                                          //!< binds them.
+
+  void Upload(const DualQuaternion *pPalettes, unsigned int PaletteSize,
+              const unsigned int *pInstances,
+              unsigned int NumInstances); //!< Same for dual quaternion
+                                          //!< palettes.
+
+  void Fence(); //!< To be called after the draws reading the palettes, the
+                //!< next Upload goes to the next region. Does nothing if
+                //!< there was no Upload since the last Fence.
+
+  bool IsPersistent() const { return m_pMapped != NULL; }
+
+private:
+  void Clear(); //!< Deletes the buffer and the fences.
+
+  void UploadData(const void *pData, GLsizeiptr BlockSize,
+                  const unsigned int *pBlocks,
+                  unsigned int NumBlocks); //!< Copies the listed blocks of
+                                           //!< BlockSize bytes one after the
+                                           //!< other and binds them, pData
+                                           //!< as a single block if pBlocks
+                                           //!< is NULL.
+
+  GLuint m_Buffer;          //!< Shader storage buffer object.
+  GLuint m_Binding;         //!< Shader storage binding point.
+  GLsizeiptr m_RegionSize;  //!< Bytes per region, aligned for binding.
+  unsigned int m_Region;    //!< Region written by the next Upload.
+  unsigned char *m_pMapped; //!< Persistent mapping, NULL if not available.
+  bool m_Written;           //!< m_Region was uploaded to since last Fence.
+
+  GLsync m_Fences[PALETTE_BUFFER_REGIONS]; //!< Last frame reading a region.
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// Marks a free slot of the lookup table, no real key has it.
+#define POSE_CACHE_EMPTY_KEY 0xFFFFFFFFFFFFFFFFull
+
+// Entries evaluated by a single job.
+#define POSE_CACHE_ENTRIES_PER_JOB 2
+
+PoseCache::PoseCache() {
+  m_pModel = NULL;
+  m_NumBones = 0;
+  m_BucketSize = 0.0f;
+  m_MaxEntries = 0;
+  m_NumEntries = 0;
+  ResetStats();
+}
+
+void PoseCache::Init(const SkeletalModel *pModel, float BucketSize,
+                     unsigned int MaxEntries) {
+  m_pModel = pModel;
+  m_NumBones = pModel->GetNumBones();
+  m_BucketSize = BucketSize;
+  m_MaxEntries = MaxEntries;
+
+  // Power of two, so the hash is masked instead of divided.
+  unsigned int TableSize = 1;
+  while (TableSize < MaxEntries * 2) {
+    TableSize *= 2;
+  }
+  m_Keys.assign(TableSize, POSE_CACHE_EMPTY_KEY);
+  m_Slots.assign(TableSize, 0);
+
+  m_EntryClips.resize(MaxEntries);
+  m_EntryTimes.resize(MaxEntries);
+  m_States.resize(MaxEntries);
+  for (unsigned int i = 0; i < MaxEntries; i++) {
+    pModel->InitState(m_States[i]);
+  }
+  m_Palettes.resize(MaxEntries * m_NumBones);
+
+  m_NumEntries = 0;
+  ResetStats();
+}
+
+void PoseCache::BeginFrame() {
+  if (m_NumEntries > 0) {
+    std::fill(m_Keys.begin(), m_Keys.end(), POSE_CACHE_EMPTY_KEY);
+  }
+  m_NumEntries = 0;
+  m_FrameRequests = 0;
+  m_FrameHits = 0;
+}
+
+unsigned int PoseCache::Request(unsigned int Clip, float TimeInSeconds) {
+  // Same wrap around as the animation playback.
+  float Duration = m_pModel->GetDuration(Clip);
+  float Time = Duration > 0.0f ? fmodf(TimeInSeconds, Duration) : 0.0f;
+  if (Time < 0.0f) {
+    Time += Duration;
+  }
+
+  // The key is the bucket, or the time itself when not quantizing.
+  uint32_t Bucket;
+  if (m_BucketSize > 0.0f) {
+    Bucket = (uint32_t)floorf(Time / m_BucketSize);
+    Time = Bucket * m_BucketSize;
+  } else {
+    memcpy(&Bucket, &Time, sizeof(Bucket));
+  }
+  uint64_t Key = ((uint64_t)Clip << 32) | Bucket;
+
+  m_FrameRequests++;
+  m_TotalRequests++;
+
+  // Linear probing from a multiplicative hash of the key.
+  uint64_t Mask = m_Keys.size() - 1;
+  uint64_t Slot = ((Key * 0x9E3779B97F4A7C15ull) >> 32) & Mask;
+  while (m_Keys[Slot] != POSE_CACHE_EMPTY_KEY) {
+    if (m_Keys[Slot] == Key) {
+      m_FrameHits++;
+      m_TotalHits++;
+      return m_Slots[Slot];
+    }
+    Slot = (Slot + 1) & Mask;
+  }
+
+  assert(m_NumEntries < m_MaxEntries);
+  unsigned int Entry = m_NumEntries++;
+  m_Keys[Slot] = Key;
+  m_Slots[Slot] = Entry;
+  m_EntryClips[Entry] = Clip;
+  m_EntryTimes[Entry] = Time;
+  return Entry;
+}
+
+void PoseCache::Evaluate(JobSystem *pJobs) {
+  // Every entry has its own state and palette.
+  pJobs->ParallelFor(m_NumEntries, POSE_CACHE_ENTRIES_PER_JOB,
+                     [this](unsigned int Begin, unsigned int End) {
+                       for (unsigned int i = Begin; i < End; i++) {
+                         // The entries keep their clip from frame to frame
+                         // most of the time, and with it the key cursors.
+                         AnimationState &State = m_States[i];
+                         unsigned int Clip = m_EntryClips[i];
+                         if (State.NumLayers != 1 ||
+                             State.Layers[0].Clip != Clip) {
+                           m_pModel->PlayClip(State, Clip, 0.0f);
+                         }
+                         m_pModel->EvaluatePalette(
+                             m_EntryTimes[i], m_States[i],
+                             &m_Palettes[i * m_NumBones]);
+                       }
+                     });
+}
+
+float PoseCache::GetHitRate() const {
+  return m_TotalRequests > 0 ? (float)m_TotalHits / m_TotalRequests : 0.0f;
+}
+
+void PoseCache::ResetStats() {
+  m_FrameRequests = 0;
+  m_FrameHits = 0;
+  m_TotalRequests = 0;
+  m_TotalHits = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef POSECACHE_H
+#define POSECACHE_H
+
+#include "JobSystem.h"
+#include "Math3D.h"
+#include "SkeletalModel.h"
+#include <stdint.h>
+#include <vector>
+
+// Palettes shared, for one frame, by the instances playing the same clip at
+// the same time. The time is quantized to buckets of a given size: the
+// instances falling in the same bucket reuse the pose evaluated at the start
+// of the bucket. With a bucket size of zero only identical times are shared.
+//
+// Requests are made from one thread, then Evaluate computes every distinct
+// pose once, in parallel.
+class PoseCache {
+public:
+  PoseCache(); //!< Constructor
+
+  void Init(const SkeletalModel *pModel, float BucketSize,
+            unsigned int MaxEntries); //!< Sizes the cache for up to
+                                      //!< MaxEntries distinct poses a frame.
+
+  void SetBucketSize(float BucketSize) { m_BucketSize = BucketSize; }
+  float GetBucketSize() const { return m_BucketSize; } //!< Seconds.
+
+  void BeginFrame(); //!< Forgets the poses of the previous frame.
+
+  unsigned int Request(unsigned int Clip,
+                       float TimeInSeconds); //!< Returns the entry holding
+                                             //!< the pose, available after
+                                             //!< Evaluate.
+
+  void Evaluate(JobSystem *pJobs); //!< Evaluates the requested poses.
+
+  const Matrix4f *GetPalette(unsigned int Entry) const {
+    return &m_Palettes[Entry * m_NumBones];
+  }
+
+  unsigned int GetNumEntries() const { return m_NumEntries; }
+
+  // Hit rate statistics, of the last frame and since the last reset.
+  unsigned int GetFrameRequests() const { return m_FrameRequests; }
+  unsigned int GetFrameHits() const { return m_FrameHits; }
+  float GetHitRate() const; //!< Since the last ResetStats, 0 to 1.
+  void ResetStats();
+
+private:
+  const SkeletalModel *m_pModel;
+  unsigned int m_NumBones;
+  float m_BucketSize; //!< Seconds, 0 for exact times.
+
+  unsigned int m_MaxEntries;
+  unsigned int m_NumEntries; //!< Distinct poses this frame.
+
+  // Open addressing table from the key to the entry, twice the maximum
+  // number of entries so the probes stay short.
+  std::vector<uint64_t> m_Keys;
+  std::vector<unsigned int> m_Slots;
+
+  std::vector<unsigned int> m_EntryClips; //!< Clip of each entry.
+  std::vector<float> m_EntryTimes;      //!< Time each entry is evaluated at.
+  std::vector<AnimationState> m_States; //!< One per entry, no sharing
+                                        //!< between the jobs.
+  std::vector<Matrix4f> m_Palettes;     //!< m_NumBones per entry.
+
+  unsigned int m_FrameRequests, m_FrameHits;
+  unsigned long long m_TotalRequests, m_TotalHits;
+};
+
+#endif
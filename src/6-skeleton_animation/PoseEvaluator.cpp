@@ -0,0 +1,317 @@
+#include "PoseEvaluator.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if POSE_SIMD_WIDTH == 8
+#include <immintrin.h>
+#elif POSE_SIMD_WIDTH == 4
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Thin wrappers over the SIMD register of the selected width, so the pose
+// evaluation below is written once.
+#if POSE_SIMD_WIDTH == 8
+typedef __m256 Lanes;
+inline Lanes Load(const float *p) { return _mm256_loadu_ps(p); }
+inline void Store(float *p, Lanes a) { _mm256_storeu_ps(p, a); }
+inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+// -0.0f in the lanes where a is negative, 0.0f elsewhere.
+inline Lanes SignBit(Lanes a) {
+  return _mm256_and_ps(a, _mm256_set1_ps(-0.0f));
+}
+inline Lanes Xor(Lanes a, Lanes b) { return _mm256_xor_ps(a, b); }
+#elif POSE_SIMD_WIDTH == 4
+typedef __m128 Lanes;
+inline Lanes Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Store(float *p, Lanes a) { _mm_storeu_ps(p, a); }
+inline Lanes Splat(float f) { return _mm_set1_ps(f); }
+inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+inline Lanes SignBit(Lanes a) { return _mm_and_ps(a, _mm_set1_ps(-0.0f)); }
+inline Lanes Xor(Lanes a, Lanes b) { return _mm_xor_ps(a, b); }
+#else
+typedef float Lanes;
+inline Lanes Load(const float *p) { return *p; }
+inline void Store(float *p, Lanes a) { *p = a; }
+inline Lanes Splat(float f) { return f; }
+inline Lanes Add(Lanes a, Lanes b) { return a + b; }
+inline Lanes Sub(Lanes a, Lanes b) { return a - b; }
+inline Lanes Mul(Lanes a, Lanes b) { return a * b; }
+inline Lanes Div(Lanes a, Lanes b) { return a / b; }
+inline Lanes Sqrt(Lanes a) { return sqrtf(a); }
+inline Lanes SignBit(Lanes a) { return a < 0.0f ? -0.0f : 0.0f; }
+inline Lanes Xor(Lanes a, Lanes b) {
+  unsigned int ia, ib;
+  memcpy(&ia, &a, sizeof(ia));
+  memcpy(&ib, &b, sizeof(ib));
+  ia ^= ib;
+  memcpy(&a, &ia, sizeof(a));
+  return a;
+}
+#endif
+
+// Slerp weights from "A Fast and Accurate Algorithm for Computing SLERP"
+// (D. Eberly): sin(t * angle) / sin(angle) as a polynomial in cos(angle),
+// accurate to float precision and without any trigonometric function, so it
+// vectorises like a lerp.
+const unsigned int SlerpTerms = 8;
+const float SlerpMu = 1.90110745351730037f;
+const float SlerpU[SlerpTerms] = {
+    1.0f / (1 * 3), 1.0f / (2 * 5),  1.0f / (3 * 7),  1.0f / (4 * 9),
+    1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), SlerpMu / (8 * 17)};
+const float SlerpV[SlerpTerms] = {
+    1.0f / 3, 2.0f / 5,  3.0f / 7,  4.0f / 9,
+    5.0f / 11, 6.0f / 13, 7.0f / 15, SlerpMu * 8 / 17};
+
+// Weight of a quaternion at the parameter t, CosMinusOne being the cosine of
+// the angle between the two quaternions minus one.
+inline Lanes SlerpWeight(Lanes t, Lanes CosMinusOne) {
+  Lanes One = Splat(1.0f);
+  Lanes SquaredT = Mul(t, t);
+  Lanes Weight = One;
+  for (int i = SlerpTerms - 1; i >= 0; i--) {
+    Lanes b = Mul(Sub(Mul(Splat(SlerpU[i]), SquaredT), Splat(SlerpV[i])),
+                  CosMinusOne);
+    Weight = Add(One, Mul(b, Weight));
+  }
+  return Mul(t, Weight);
+}
+} // namespace
+
+PoseEvaluator::PoseEvaluator() {
+  m_NumJoints = 0;
+  m_Stride = 0;
+}
+
+void PoseEvaluator::Init(unsigned int NumJoints) {
+  m_NumJoints = NumJoints;
+  m_Stride = (NumJoints + POSE_SIMD_WIDTH - 1) / POSE_SIMD_WIDTH *
+             POSE_SIMD_WIDTH;
+  m_Streams.assign(NumStreams * m_Stride, 0.0f);
+
+  // Identity keys, the padding lanes are evaluated too.
+  for (unsigned int i = 0; i < m_Stride; i++) {
+    GetStream(StartW)[i] = 1.0f;
+    GetStream(EndW)[i] = 1.0f;
+  }
+}
+
+void PoseEvaluator::SetKeys(unsigned int Joint, const JointKeys &Keys) {
+  assert(Joint < m_NumJoints);
+
+  GetStream(StartX)[Joint] = Keys.StartRotation.x;
+  GetStream(StartY)[Joint] = Keys.StartRotation.y;
+  GetStream(StartZ)[Joint] = Keys.StartRotation.z;
+  GetStream(StartW)[Joint] = Keys.StartRotation.w;
+  GetStream(EndX)[Joint] = Keys.EndRotation.x;
+  GetStream(EndY)[Joint] = Keys.EndRotation.y;
+  GetStream(EndZ)[Joint] = Keys.EndRotation.z;
+  GetStream(EndW)[Joint] = Keys.EndRotation.w;
+  GetStream(StartTx)[Joint] = Keys.StartTranslation.x;
+  GetStream(StartTy)[Joint] = Keys.StartTranslation.y;
+  GetStream(StartTz)[Joint] = Keys.StartTranslation.z;
+  GetStream(EndTx)[Joint] = Keys.EndTranslation.x;
+  GetStream(EndTy)[Joint] = Keys.EndTranslation.y;
+  GetStream(EndTz)[Joint] = Keys.EndTranslation.z;
+  GetStream(RotationFactor)[Joint] = Keys.RotationFactor;
+  GetStream(TranslationFactor)[Joint] = Keys.TranslationFactor;
+}
+
+void PoseEvaluator::Evaluate() {
+  Interpolate();
+  BuildLocalTransforms();
+}
+
+void PoseEvaluator::Interpolate() {
+  const Lanes One = Splat(1.0f);
+
+  for (unsigned int i = 0; i < m_Stride; i += POSE_SIMD_WIDTH) {
+    Lanes x0 = Load(GetStream(StartX) + i);
+    Lanes y0 = Load(GetStream(StartY) + i);
+    Lanes z0 = Load(GetStream(StartZ) + i);
+    Lanes w0 = Load(GetStream(StartW) + i);
+    Lanes x1 = Load(GetStream(EndX) + i);
+    Lanes y1 = Load(GetStream(EndY) + i);
+    Lanes z1 = Load(GetStream(EndZ) + i);
+    Lanes w1 = Load(GetStream(EndW) + i);
+    Lanes t = Load(GetStream(RotationFactor) + i);
+
+    // Shortest arc: the end weight takes the sign of the cosine, which is
+    // then made positive.
+    Lanes Cos =
+        Add(Add(Mul(x0, x1), Mul(y0, y1)), Add(Mul(z0, z1), Mul(w0, w1)));
+    Lanes Sign = SignBit(Cos);
+    Lanes CosMinusOne = Sub(Xor(Cos, Sign), One);
+
+    Lanes StartWeight = SlerpWeight(Sub(One, t), CosMinusOne);
+    Lanes EndWeight = Xor(SlerpWeight(t, CosMinusOne), Sign);
+
+    Lanes x = Add(Mul(x0, StartWeight), Mul(x1, EndWeight));
+    Lanes y = Add(Mul(y0, StartWeight), Mul(y1, EndWeight));
+    Lanes z = Add(Mul(z0, StartWeight), Mul(z1, EndWeight));
+    Lanes w = Add(Mul(w0, StartWeight), Mul(w1, EndWeight));
+
+    // Normalise, as the scalar path does after interpolating.
+    Lanes InvLength = Div(
+        One, Sqrt(Add(Add(Mul(x, x), Mul(y, y)), Add(Mul(z, z), Mul(w, w)))));
+    Store(GetStream(PoseX) + i, Mul(x, InvLength));
+    Store(GetStream(PoseY) + i, Mul(y, InvLength));
+    Store(GetStream(PoseZ) + i, Mul(z, InvLength));
+    Store(GetStream(PoseW) + i, Mul(w, InvLength));
+
+    Lanes s = Load(GetStream(TranslationFactor) + i);
+    Lanes tx0 = Load(GetStream(StartTx) + i);
+    Lanes ty0 = Load(GetStream(StartTy) + i);
+    Lanes tz0 = Load(GetStream(StartTz) + i);
+    Store(GetStream(PoseTx) + i,
+          Add(tx0, Mul(Sub(Load(GetStream(EndTx) + i), tx0), s)));
+    Store(GetStream(PoseTy) + i,
+          Add(ty0, Mul(Sub(Load(GetStream(EndTy) + i), ty0), s)));
+    Store(GetStream(PoseTz) + i,
+          Add(tz0, Mul(Sub(Load(GetStream(EndTz) + i), tz0), s)));
+  }
+}
+
+void PoseEvaluator::BlendPose(const PoseEvaluator &Other, float Weight) {
+  assert(Other.m_Stride == m_Stride);
+
+  const Lanes One = Splat(1.0f);
+  const Lanes t = Splat(Weight);
+  const Lanes s = Splat(1.0f - Weight);
+
+  for (unsigned int i = 0; i < m_Stride; i += POSE_SIMD_WIDTH) {
+    Lanes x0 = Load(GetStream(PoseX) + i);
+    Lanes y0 = Load(GetStream(PoseY) + i);
+    Lanes z0 = Load(GetStream(PoseZ) + i);
+    Lanes w0 = Load(GetStream(PoseW) + i);
+    Lanes x1 = Load(Other.GetStream(PoseX) + i);
+    Lanes y1 = Load(Other.GetStream(PoseY) + i);
+    Lanes z1 = Load(Other.GetStream(PoseZ) + i);
+    Lanes w1 = Load(Other.GetStream(PoseW) + i);
+
+    // Normalised lerp along the shortest arc: for a cross-fade the two poses
+    // are close enough that it is indistinguishable from a slerp.
+    Lanes Cos =
+        Add(Add(Mul(x0, x1), Mul(y0, y1)), Add(Mul(z0, z1), Mul(w0, w1)));
+    Lanes EndWeight = Xor(t, SignBit(Cos));
+    Lanes x = Add(Mul(x0, s), Mul(x1, EndWeight));
+    Lanes y = Add(Mul(y0, s), Mul(y1, EndWeight));
+    Lanes z = Add(Mul(z0, s), Mul(z1, EndWeight));
+    Lanes w = Add(Mul(w0, s), Mul(w1, EndWeight));
+    Lanes InvLength = Div(
+        One, Sqrt(Add(Add(Mul(x, x), Mul(y, y)), Add(Mul(z, z), Mul(w, w)))));
+    Store(GetStream(PoseX) + i, Mul(x, InvLength));
+    Store(GetStream(PoseY) + i, Mul(y, InvLength));
+    Store(GetStream(PoseZ) + i, Mul(z, InvLength));
+    Store(GetStream(PoseW) + i, Mul(w, InvLength));
+
+    for (unsigned int c = PoseTx; c <= PoseTz; c++) {
+      Lanes a = Load(GetStream(c) + i);
+      Lanes b = Load(Other.GetStream(c) + i);
+      Store(GetStream(c) + i, Add(a, Mul(Sub(b, a), t)));
+    }
+  }
+}
+
+void PoseEvaluator::AddPose(const PoseEvaluator &Additive, float Weight) {
+  assert(Additive.m_Stride == m_Stride);
+
+  const Lanes One = Splat(1.0f);
+  const Lanes t = Splat(Weight);
+  const Lanes s = Splat(1.0f - Weight);
+
+  for (unsigned int i = 0; i < m_Stride; i += POSE_SIMD_WIDTH) {
+    // Delta scaled by the weight: normalised lerp from the identity, along
+    // the shortest arc.
+    Lanes dw = Load(Additive.GetStream(PoseW) + i);
+    Lanes EndWeight = Xor(t, SignBit(dw));
+    Lanes dx = Mul(Load(Additive.GetStream(PoseX) + i), EndWeight);
+    Lanes dy = Mul(Load(Additive.GetStream(PoseY) + i), EndWeight);
+    Lanes dz = Mul(Load(Additive.GetStream(PoseZ) + i), EndWeight);
+    dw = Add(s, Mul(dw, EndWeight));
+    Lanes InvLength = Div(One, Sqrt(Add(Add(Mul(dx, dx), Mul(dy, dy)),
+                                        Add(Mul(dz, dz), Mul(dw, dw)))));
+    dx = Mul(dx, InvLength);
+    dy = Mul(dy, InvLength);
+    dz = Mul(dz, InvLength);
+    dw = Mul(dw, InvLength);
+
+    // Pose * Delta, the product of unit quaternions stays unit.
+    Lanes x = Load(GetStream(PoseX) + i);
+    Lanes y = Load(GetStream(PoseY) + i);
+    Lanes z = Load(GetStream(PoseZ) + i);
+    Lanes w = Load(GetStream(PoseW) + i);
+    Store(GetStream(PoseX) + i,
+          Add(Add(Mul(w, dx), Mul(x, dw)), Sub(Mul(y, dz), Mul(z, dy))));
+    Store(GetStream(PoseY) + i,
+          Add(Add(Mul(w, dy), Mul(y, dw)), Sub(Mul(z, dx), Mul(x, dz))));
+    Store(GetStream(PoseZ) + i,
+          Add(Add(Mul(w, dz), Mul(z, dw)), Sub(Mul(x, dy), Mul(y, dx))));
+    Store(GetStream(PoseW) + i,
+          Sub(Sub(Mul(w, dw), Mul(x, dx)), Add(Mul(y, dy), Mul(z, dz))));
+
+    for (unsigned int c = PoseTx; c <= PoseTz; c++) {
+      Lanes a = Load(GetStream(c) + i);
+      Lanes b = Load(Additive.GetStream(c) + i);
+      Store(GetStream(c) + i, Add(a, Mul(b, t)));
+    }
+  }
+}
+
+void PoseEvaluator::BuildLocalTransforms() {
+  const Lanes One = Splat(1.0f);
+  const Lanes Two = Splat(2.0f);
+
+  for (unsigned int i = 0; i < m_Stride; i += POSE_SIMD_WIDTH) {
+    Lanes x = Load(GetStream(PoseX) + i);
+    Lanes y = Load(GetStream(PoseY) + i);
+    Lanes z = Load(GetStream(PoseZ) + i);
+    Lanes w = Load(GetStream(PoseW) + i);
+
+    // Rotation matrix, same layout as Matrix4f::InitRotateTransform.
+    Lanes x2 = Mul(Two, x), y2 = Mul(Two, y), z2 = Mul(Two, z);
+    Lanes xx2 = Mul(x, x2), yy2 = Mul(y, y2), zz2 = Mul(z, z2);
+    Lanes xy2 = Mul(x, y2), xz2 = Mul(x, z2), yz2 = Mul(y, z2);
+    Lanes wx2 = Mul(w, x2), wy2 = Mul(w, y2), wz2 = Mul(w, z2);
+
+    Store(GetStream(LocalRows + 0) + i, Sub(Sub(One, yy2), zz2));
+    Store(GetStream(LocalRows + 1) + i, Sub(xy2, wz2));
+    Store(GetStream(LocalRows + 2) + i, Add(xz2, wy2));
+    Store(GetStream(LocalRows + 4) + i, Add(xy2, wz2));
+    Store(GetStream(LocalRows + 5) + i, Sub(Sub(One, xx2), zz2));
+    Store(GetStream(LocalRows + 6) + i, Sub(yz2, wx2));
+    Store(GetStream(LocalRows + 8) + i, Sub(xz2, wy2));
+    Store(GetStream(LocalRows + 9) + i, Add(yz2, wx2));
+    Store(GetStream(LocalRows + 10) + i, Sub(Sub(One, xx2), yy2));
+
+    // The translation goes straight into the last column.
+    Store(GetStream(LocalRows + 3) + i, Load(GetStream(PoseTx) + i));
+    Store(GetStream(LocalRows + 7) + i, Load(GetStream(PoseTy) + i));
+    Store(GetStream(LocalRows + 11) + i, Load(GetStream(PoseTz) + i));
+  }
+}
+
+void PoseEvaluator::GetLocalTransform(unsigned int Joint,
+                                      Matrix4f &Out) const {
+  assert(Joint < m_NumJoints);
+
+  for (unsigned int r = 0; r < 3; r++) {
+    for (unsigned int c = 0; c < 4; c++) {
+      Out.m[r][c] = GetStream(LocalRows + r * 4 + c)[Joint];
+    }
+  }
+  Out.m[3][0] = 0.0f;
+  Out.m[3][1] = 0.0f;
+  Out.m[3][2] = 0.0f;
+  Out.m[3][3] = 1.0f;
+}
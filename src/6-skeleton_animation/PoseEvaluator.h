@@ -0,0 +1,93 @@
+#ifndef POSEEVALUATOR_H
+#define POSEEVALUATOR_H
+
+#include "AnimationClip.h"
+#include "Math3D.h"
+#include <vector>
+
+// Number of joints interpolated at once: 8 with AVX, 4 with SSE, 1 otherwise.
+#if defined(__AVX__)
+#define POSE_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSE_SIMD_WIDTH 4
+#else
+#define POSE_SIMD_WIDTH 1
+#endif
+
+// Interpolates the local transformations of a skeleton several joints at a
+// time. The keys of every joint are stored structure-of-arrays (one stream per
+// component), so a SIMD register holds the same component of consecutive
+// joints: slerp, normalisation and the quaternion to matrix conversion run
+// without any shuffle, and the joint matrix is built straight from rotation
+// and translation instead of multiplying two 4x4 matrices.
+class PoseEvaluator {
+public:
+  PoseEvaluator(); //!< Constructor
+
+  void Init(unsigned int NumJoints); //!< Allocates the streams, every joint
+                                     //!< starts at the identity.
+
+  void SetKeys(unsigned int Joint,
+               const JointKeys &Keys); //!< Keys to interpolate for the joint.
+
+  void Evaluate(); //!< Interpolates all the joints and builds their local
+                   //!< transformations.
+
+  // Layered evaluation: interpolate every layer, blend them into the first
+  // one, then build the local transformations once.
+  void Interpolate(); //!< Interpolates the keys into the pose.
+  void BlendPose(const PoseEvaluator &Other,
+                 float Weight); //!< Cross-fades the pose towards Other's.
+  void AddPose(const PoseEvaluator &Additive,
+               float Weight); //!< Applies Additive's pose, made of
+                              //!< differences to a reference pose, on top
+                              //!< of this one.
+  void BuildLocalTransforms(); //!< Local transformations from the pose.
+
+  void GetLocalTransform(unsigned int Joint, Matrix4f &Out) const;
+
+  unsigned int GetNumJoints() const { return m_NumJoints; }
+
+private:
+  // One stream per input and output component.
+  enum Stream {
+    StartX,
+    StartY,
+    StartZ,
+    StartW,
+    EndX,
+    EndY,
+    EndZ,
+    EndW,
+    StartTx,
+    StartTy,
+    StartTz,
+    EndTx,
+    EndTy,
+    EndTz,
+    RotationFactor,
+    TranslationFactor,
+    PoseX, //!< Interpolated rotation and translation, Interpolate only.
+    PoseY,
+    PoseZ,
+    PoseW,
+    PoseTx,
+    PoseTy,
+    PoseTz,
+    LocalRows, //!< First of the 12 streams of the 3x4 local matrix.
+    NumStreams = LocalRows + 12
+  };
+
+  float *GetStream(unsigned int s) { return &m_Streams[s * m_Stride]; }
+  const float *GetStream(unsigned int s) const {
+    return &m_Streams[s * m_Stride];
+  }
+
+  unsigned int m_NumJoints; //!< Number of joints.
+  unsigned int m_Stride;    //!< Joints rounded up to the SIMD width.
+
+  std::vector<float> m_Streams; //!< NumStreams streams of m_Stride floats.
+};
+
+#endif
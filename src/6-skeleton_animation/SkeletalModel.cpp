@@ -1,54 +1,280 @@
 #include "SkeletalModel.h"
 
+#include "learnopengl/gl_state.h"
+
+#include <algorithm>
+#include <assimp/config.h>
+#include <ctype.h>
+#include <math.h>
+
+namespace {
+// Names of the finger and face joints, the first ones the animation LOD
+// drops. A joint name is cut into segments at separators, digits and case
+// changes ("mixamorig:LeftHandIndex1" is mixamorig, left, hand, index), and
+// matches when one of them is a token below or its plural: "Spring1" or
+// "Clip_Root" are kept, "L_Lip_Upper" and "RightEye" are dropped.
+const char *MinorJointNames[] = {"thumb",   "index",   "middle",  "ring",
+                                 "pinky",   "finger",  "eye",     "eyelid",
+                                 "eyebrow", "brow",    "jaw",     "tongue",
+                                 "lip",     "cheek"};
+
+bool IsMinorJointSegment(const std::string &Segment) {
+  for (unsigned int i = 0;
+       i < sizeof(MinorJointNames) / sizeof(MinorJointNames[0]); i++) {
+    std::string Token(MinorJointNames[i]);
+    if (Segment == Token || Segment == Token + "s") {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsMinorJointName(const std::string &Name) {
+  std::string Segment;
+  for (size_t i = 0; i <= Name.size(); i++) {
+    int c = i < Name.size() ? (unsigned char)Name[i] : 0;
+    bool Split = !isalpha(c);
+    if (!Split && !Segment.empty()) {
+      // "HandIndex" and "JAWBone" both split before the last capital.
+      int Prev = (unsigned char)Name[i - 1];
+      int Next = i + 1 < Name.size() ? (unsigned char)Name[i + 1] : 0;
+      Split = isupper(c) && (islower(Prev) || (isupper(Prev) && islower(Next)));
+    }
+    if (Split && !Segment.empty()) {
+      if (IsMinorJointSegment(Segment)) {
+        return true;
+      }
+      Segment.clear();
+    }
+    if (isalpha(c)) {
+      Segment += (char)tolower(c);
+    }
+  }
+  return false;
+}
+
+// Transformation of an animated joint relative to its parent.
+template <typename ClipType>
+Matrix4f SampleJointTransform(const ClipType &Clip, unsigned int Joint,
+                              float AnimationTime, KeyCursor &Cursor) {
+  // Interpolate rotation and translation between the keyframes
+  Quaternion RotationQ;
+  Vector3f Translation;
+  Clip.Sample(Joint, AnimationTime, Cursor, RotationQ, Translation);
+
+  // Generate rotation and translation transformation matrices
+  Matrix4f RotationM;
+  RotationM.InitRotateTransform(RotationQ);
+  Matrix4f TranslationM;
+  TranslationM.InitTranslationTransform(Translation.x, Translation.y,
+                                        Translation.z);
+
+  // Combine the above transformations
+  return TranslationM * RotationM;
+}
+
+// Global transformations of all the joints, parents come first.
+template <typename ClipType>
+void SampleGlobalTransforms(const ClipType &Clip,
+                            const std::vector<Joint> &Joints,
+                            float AnimationTime,
+                            std::vector<KeyCursor> &Cursors,
+                            std::vector<Matrix4f> &Globals) {
+  Globals.resize(Joints.size());
+  for (unsigned int i = 0; i < Joints.size(); i++) {
+    Matrix4f Local = Joints[i].LocalTransform;
+    if (Clip.IsAnimated(i)) {
+      Local = SampleJointTransform(Clip, i, AnimationTime, Cursors[i]);
+    }
+
+    int Parent = Joints[i].Parent;
+    Globals[i] = Parent < 0 ? Local : Globals[Parent] * Local;
+  }
+}
+
+// Keys of a joint that an additive layer doesn't animate: no change.
+JointKeys MakeIdentityKeys() {
+  JointKeys Keys;
+  Keys.StartRotation = Keys.EndRotation = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+  Keys.StartTranslation = Keys.EndTranslation = Vector3f(0.0f, 0.0f, 0.0f);
+  Keys.RotationFactor = Keys.TranslationFactor = 0.0f;
+  return Keys;
+}
+
+const JointKeys IdentityKeys = MakeIdentityKeys();
+
+// Starts a layer pose at the bind pose, or at no change for an additive one.
+// The joints the far LODs skip keep these keys instead of the identity, which
+// would collapse them onto their parent.
+void SeedPose(PoseEvaluator &Pose, const std::vector<Joint> &Joints,
+              bool Additive) {
+  if (Pose.GetNumJoints() != Joints.size()) {
+    Pose.Init((unsigned int)Joints.size());
+  }
+  for (unsigned int i = 0; i < Joints.size(); i++) {
+    Pose.SetKeys(i, Additive ? IdentityKeys : Joints[i].BindKeys);
+  }
+}
+
+// Makes room for a layer at Index. The per layer buffers are swapped rather
+// than copied, so a state stops allocating once all its layers were used.
+// The first clip, played until now without layers, keeps its pose.
+void InsertLayer(AnimationState &State, unsigned int Index,
+                 const AnimationLayer &Layer,
+                 const std::vector<Joint> &Joints) {
+  bool Unlayered = State.NumLayers == 0;
+  for (unsigned int i = State.NumLayers; i > Index; i--) {
+    State.Layers[i] = State.Layers[i - 1];
+    std::swap(State.Cursors[i], State.Cursors[i - 1]);
+    std::swap(State.Poses[i], State.Poses[i - 1]);
+  }
+  State.NumLayers++;
+
+  State.Layers[Index] = Layer;
+  State.Cursors[Index].assign(Joints.size(), KeyCursor());
+  if (!Unlayered || State.Poses[Index].GetNumJoints() != Joints.size()) {
+    SeedPose(State.Poses[Index], Joints, Layer.Additive);
+  }
+}
+
+void RemoveLayers(AnimationState &State, unsigned int Index,
+                  unsigned int Count) {
+  for (unsigned int i = Index; i + Count < State.NumLayers; i++) {
+    State.Layers[i] = State.Layers[i + Count];
+    std::swap(State.Cursors[i], State.Cursors[i + Count]);
+    std::swap(State.Poses[i], State.Poses[i + Count]);
+  }
+  State.NumLayers -= Count;
+}
+
+// Grows the box Min, Max to enclose the box BoxMin, BoxMax.
+void GrowBounds(Vector3f &Min, Vector3f &Max, const Vector3f &BoxMin,
+                const Vector3f &BoxMax) {
+  Min = Vector3f(std::min(Min.x, BoxMin.x), std::min(Min.y, BoxMin.y),
+                 std::min(Min.z, BoxMin.z));
+  Max = Vector3f(std::max(Max.x, BoxMax.x), std::max(Max.y, BoxMax.y),
+                 std::max(Max.z, BoxMax.z));
+}
+} // namespace
+
+void BoneInfluenceFormat::Pack(const VertexBoneData &Bones,
+                               unsigned char *pOut) const {
+  memset(pOut, 0, GetStride());
+
+  // Round every weight, the rounding error goes to the strongest one: the
+  // weights of a vertex keep summing to 1 and the mesh doesn't shrink.
+  unsigned int One = WideWeights ? 0xFFFF : 0xFF;
+  unsigned int Weights[MAX_BONE_INFLUENCES];
+  unsigned int Sum = 0;
+  for (unsigned int i = 0; i < NumInfluences; i++) {
+    Weights[i] = (unsigned int)(Bones.Weights[i] * One + 0.5f);
+    Sum += Weights[i];
+  }
+  if (Sum > 0) {
+    // The others can't add up to more than One, Weights[0] is the largest.
+    Weights[0] = One - (Sum - Weights[0]);
+  }
+
+  unsigned char *pWeights = pOut + GetIDsSize();
+  for (unsigned int i = 0; i < NumInfluences; i++) {
+    if (WideIDs) {
+      ((unsigned short *)pOut)[i] = (unsigned short)Bones.IDs[i];
+    } else {
+      pOut[i] = (unsigned char)Bones.IDs[i];
+    }
+    if (WideWeights) {
+      ((unsigned short *)pWeights)[i] = (unsigned short)Weights[i];
+    } else {
+      pWeights[i] = (unsigned char)Weights[i];
+    }
+  }
+}
+
 SkeletalModel::SkeletalModel(GLSLProgram *shaderProgIn) {
   m_VAO = 0;
-
-  pScene = NULL;
+  m_SlotBuffer = 0;
+  m_MaxInstances = 0;
+  m_IndirectBuffer = 0;
+  m_pLibrary = NULL;
+  m_OwnsLibrary = false;
 
   // Initialise the total number of bones to 0.
   m_NumBones = 0;
+  m_NumVertices = 0;
+  m_BindMin = Vector3f(0.0f, 0.0f, 0.0f);
+  m_BindMax = Vector3f(0.0f, 0.0f, 0.0f);
+  m_KeepVertices = false;
 
   // Obtain pointer to shader program to use for rendering.
   m_pShaderProg = shaderProgIn;
 }
 
-SkeletalModel::~SkeletalModel() { Clear(); }
+SkeletalModel::~SkeletalModel() {
+  Clear();
+  if (m_OwnsLibrary) {
+    delete m_pLibrary;
+  }
+}
 
 void SkeletalModel::Clear() {
   if (m_VAO != 0) {
-    glDeleteVertexArrays(1, &m_VAO);
+    glState().deleteVertexArrays(1, &m_VAO);
     m_VAO = 0;
   }
+  if (m_SlotBuffer != 0) {
+    glDeleteBuffers(1, &m_SlotBuffer);
+    m_SlotBuffer = 0;
+  }
+  if (m_IndirectBuffer != 0) {
+    glDeleteBuffers(1, &m_IndirectBuffer);
+    m_IndirectBuffer = 0;
+  }
+  m_MaxInstances = 0;
+}
+
+void SkeletalModel::LoadMesh(const std::string &Filename,
+                             AnimationLibrary *pLibrary) {
+  Load(Filename, pLibrary, true);
 }
 
-void SkeletalModel::LoadMesh(const std::string &Filename) {
+void SkeletalModel::LoadSkeleton(const std::string &Filename,
+                                 AnimationLibrary *pLibrary) {
+  Load(Filename, pLibrary, false);
+}
+
+void SkeletalModel::Load(const std::string &Filename,
+                         AnimationLibrary *pLibrary, bool CreateBuffers) {
   // Release the previously loaded mesh (if it exists)
   Clear();
-  // Create the VAO
-  glGenVertexArrays(1, &m_VAO);
-  glBindVertexArray(m_VAO);
-  // Generate the buffers for the vertices atttributes
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &ebo);
-  glGenBuffers(1, &boneBo);
-  pScene = Importer.ReadFile(
+  if (m_OwnsLibrary) {
+    delete m_pLibrary;
+  }
+  m_pLibrary = pLibrary;
+  m_OwnsLibrary = false;
+  // The importer owns the scene: everything needed at runtime is copied out
+  // of it, so both are released when this function returns.
+  Assimp::Importer Importer;
+  // Keep every influence we may store, the weakest are dropped later.
+  Importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS,
+                              MAX_BONE_INFLUENCES);
+  const aiScene *pScene = Importer.ReadFile(
       Filename.c_str(), aiProcess_JoinIdenticalVertices |
                             aiProcess_SortByPType | aiProcess_Triangulate |
                             aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
                             aiProcess_LimitBoneWeights);
   if (pScene) {
     m_GlobalInverseTransform = pScene->mRootNode->mTransformation;
-    m_GlobalInverseTransform.Inverse();
-    InitFromScene(pScene, Filename);
+    m_GlobalInverseTransform.InverseAffine();
+    InitFromScene(pScene, Filename, CreateBuffers);
   } else {
     printf("Error parsing '%s': '%s'\n", Filename.c_str(),
            Importer.GetErrorString());
   }
-  glBindVertexArray(0);
 }
 
 void SkeletalModel::InitFromScene(const aiScene *pScene,
-                                  const std::string &Filename) {
+                                  const std::string &Filename,
+                                  bool CreateBuffers) {
   m_Entries.resize(pScene->mNumMeshes);
   // m_Textures.resize(pScene->mNumMaterials);
 
@@ -79,6 +305,8 @@ void SkeletalModel::InitFromScene(const aiScene *pScene,
     NumIndices += m_Entries[i].NumIndices;
   }
 
+  m_NumVertices = NumVertices;
+
   // Reserve space in the vectors for the vertex attributes and indices
   vertices.reserve(NumVertices);
   bones.resize(NumVertices);
@@ -90,6 +318,64 @@ void SkeletalModel::InitFromScene(const aiScene *pScene,
     InitMesh(i, paiMesh, vertices, Indices, bones);
   }
 
+  // The strongest influences only, the bone boxes don't grow for the ones
+  // dropped.
+  for (unsigned int i = 0; i < bones.size(); i++) {
+    bones[i].Limit(m_BoneFormat.NumInfluences);
+  }
+  m_BoneFormat.WideIDs = m_NumBones > 256;
+  InitBounds(vertices, bones);
+
+  if (CreateBuffers) {
+    InitBuffers(vertices, Indices, bones);
+  }
+
+  // The copy of a previous load is released either way.
+  if (m_KeepVertices) {
+    m_Vertices.swap(vertices);
+    m_VertexBones.swap(bones);
+  } else {
+    std::vector<VertexStruct>().swap(m_Vertices);
+    std::vector<VertexBoneData>().swap(m_VertexBones);
+  }
+  vertices.clear();
+  Indices.clear();
+  bones.clear();
+
+  // Flatten the node hierarchy now that all the bones are known, resolving
+  // node and bone names to joint indices once instead of every frame.
+  std::map<std::string, int> JointMapping;
+  m_Joints.clear();
+  BuildSkeleton(pScene->mRootNode, -1, JointMapping);
+  // Copy the keys of the animations into the library, a library shared with
+  // a different skeleton can't be used.
+  unsigned int NumJoints = (unsigned int)m_Joints.size();
+  if (m_pLibrary && !m_pLibrary->BindSkeleton(JointMapping, NumJoints)) {
+    printf("'%s' doesn't match the skeleton of the animation library\n",
+           Filename.c_str());
+    m_pLibrary = NULL;
+  }
+  if (!m_pLibrary) {
+    m_pLibrary = new AnimationLibrary();
+    m_OwnsLibrary = true;
+    m_pLibrary->BindSkeleton(JointMapping, NumJoints);
+  }
+  m_pLibrary->AddAnimations(pScene);
+  InitState(m_State);
+  m_Palette.resize(m_NumBones);
+}
+
+void SkeletalModel::InitBuffers(const std::vector<VertexStruct> &vertices,
+                                const std::vector<GLuint> &Indices,
+                                const std::vector<VertexBoneData> &bones) {
+  // Create the VAO
+  glGenVertexArrays(1, &m_VAO);
+  glState().bindVertexArray(m_VAO);
+  // Generate the buffers for the vertices atttributes
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &ebo);
+  glGenBuffers(1, &boneBo);
+
   // Generate and populate the buffers with vertex attributes and the indices
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
   glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexStruct),
@@ -110,26 +396,127 @@ void SkeletalModel::InitFromScene(const aiScene *pScene,
   // glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexStruct),
   // (GLvoid*)offsetof(VertexStruct, uvs));
 
+  // Pack the bone data, a quarter of the unpacked size with 4 influences
+  unsigned int Stride = m_BoneFormat.GetStride();
+  std::vector<unsigned char> Packed(Stride * bones.size());
+  for (unsigned int i = 0; i < bones.size(); i++) {
+    m_BoneFormat.Pack(bones[i], &Packed[Stride * i]);
+  }
+
   // Bind the bone data buffer object
   glBindBuffer(GL_ARRAY_BUFFER, boneBo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(bones[0]) * bones.size(), &bones[0],
-               GL_STATIC_DRAW);
-
-  glEnableVertexAttribArray(2);
-  glVertexAttribIPointer(2, 4, GL_INT, sizeof(VertexBoneData),
-                         (const GLvoid *)0);
-
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(VertexBoneData),
-                        (const GLvoid *)16);
+  glBufferData(GL_ARRAY_BUFFER, Packed.size(), &Packed[0], GL_STATIC_DRAW);
+
+  // Up to 4 indices at location 2 and 4 weights at location 3, the next 4
+  // of each at locations 4 and 5.
+  GLenum IDsType =
+      m_BoneFormat.WideIDs ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+  GLenum WeightsType =
+      m_BoneFormat.WideWeights ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+  unsigned int IDSize = m_BoneFormat.WideIDs ? 2 : 1;
+  unsigned int WeightSize = m_BoneFormat.WideWeights ? 2 : 1;
+  for (unsigned int i = 0; i < m_BoneFormat.NumInfluences; i += 4) {
+    GLint Size = (GLint)std::min(m_BoneFormat.NumInfluences - i, 4u);
+    GLuint Location = 2 + i / 2;
+
+    glEnableVertexAttribArray(Location);
+    glVertexAttribIPointer(Location, Size, IDsType, Stride,
+                           (const GLvoid *)(size_t)(i * IDSize));
+
+    glEnableVertexAttribArray(Location + 1);
+    glVertexAttribPointer(
+        Location + 1, Size, WeightsType, GL_TRUE, Stride,
+        (const GLvoid *)(size_t)(m_BoneFormat.GetIDsSize() + i * WeightSize));
+  }
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(),
                &Indices[0], GL_STATIC_DRAW);
 
-  vertices.clear();
-  Indices.clear();
-  bones.clear();
+  glState().bindVertexArray(0);
+
+  // The draw commands only change their instances, one per mesh entry.
+  m_DrawCommands.resize(m_Entries.size());
+  for (unsigned int i = 0; i < m_Entries.size(); i++) {
+    DrawElementsIndirectCommand &Command = m_DrawCommands[i];
+    Command.Count = m_Entries[i].NumIndices;
+    Command.InstanceCount = 1;
+    Command.FirstIndex = m_Entries[i].BaseIndex;
+    Command.BaseVertex = (GLint)m_Entries[i].BaseVertex;
+    Command.BaseInstance = 0;
+  }
+  glGenBuffers(1, &m_IndirectBuffer);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,
+               m_DrawCommands.size() * sizeof(DrawElementsIndirectCommand),
+               NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  SetMaxInstances(1);
+}
+
+void SkeletalModel::SetMaxInstances(unsigned int MaxInstances) {
+  if (MaxInstances <= m_MaxInstances || m_VAO == 0) {
+    return;
+  }
+
+  // Every instance reads its own slot, the draws pick the range through
+  // their base instance.
+  std::vector<GLuint> Slots(MaxInstances);
+  for (unsigned int i = 0; i < MaxInstances; i++) {
+    Slots[i] = i;
+  }
+  if (m_SlotBuffer == 0) {
+    glGenBuffers(1, &m_SlotBuffer);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, m_SlotBuffer);
+  glBufferData(GL_ARRAY_BUFFER, Slots.size() * sizeof(GLuint), &Slots[0],
+               GL_STATIC_DRAW);
+
+  glState().bindVertexArray(m_VAO);
+  glEnableVertexAttribArray(INSTANCE_SLOT_LOCATION);
+  glVertexAttribIPointer(INSTANCE_SLOT_LOCATION, 1, GL_UNSIGNED_INT,
+                         sizeof(GLuint), (const GLvoid *)0);
+  glVertexAttribDivisor(INSTANCE_SLOT_LOCATION, 1);
+  glState().bindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  m_MaxInstances = MaxInstances;
+}
+
+void SkeletalModel::BuildSkeleton(const aiNode *pNode, int Parent,
+                                  std::map<std::string, int> &JointMapping) {
+  std::string NodeName(pNode->mName.data);
+
+  Joint joint;
+  joint.Parent = Parent;
+  joint.LocalTransform = Matrix4f(pNode->mTransformation);
+  joint.Minor = (Parent >= 0 && m_Joints[Parent].Minor) ||
+                IsMinorJointName(NodeName);
+
+  std::map<std::string, unsigned int>::const_iterator Bone =
+      m_BoneMapping.find(NodeName);
+  joint.Bone = Bone != m_BoneMapping.end() ? (int)Bone->second : -1;
+
+  // The bind pose as constant keys, blended in for the joints a layer
+  // doesn't animate.
+  DualQuaternion Bind;
+  Bind.InitFromTransform(joint.LocalTransform);
+  const Matrix4f &m = joint.LocalTransform;
+  joint.BindKeys.StartRotation = joint.BindKeys.EndRotation = Bind.Real;
+  joint.BindKeys.StartTranslation = joint.BindKeys.EndTranslation =
+      Vector3f(m.m[0][3], m.m[1][3], m.m[2][3]);
+  joint.BindKeys.RotationFactor = joint.BindKeys.TranslationFactor = 0.0f;
+
+  // The children are appended after their parent, so every joint can read
+  // its parent's global transformation when it is evaluated.
+  int Index = (int)m_Joints.size();
+  m_Joints.push_back(joint);
+  JointMapping[NodeName] = Index;
+
+  for (unsigned int i = 0; i < pNode->mNumChildren; i++) {
+    BuildSkeleton(pNode->mChildren[i], Index, JointMapping);
+  }
 }
 
 void SkeletalModel::InitMesh(unsigned int index, const aiMesh *paiMesh,
@@ -204,257 +591,396 @@ void SkeletalModel::LoadBones(unsigned int MeshIndex, const aiMesh *pMesh,
                               pMesh->mBones[i]->mWeights[j].mVertexId;
       // The value of how much this bone influences the vertex.
       float Weight = pMesh->mBones[i]->mWeights[j].mWeight;
-      // Insert bone data for particular vertex ID. A maximum of 4 bones can
-      // influence the same vertex.
+      // Insert bone data for particular vertex ID. Only the strongest
+      // MAX_BONE_INFLUENCES bones are kept.
       Bones[VertexID].AddBoneData(BoneIndex, Weight);
     }
   }
 }
 
+void SkeletalModel::InitBounds(const std::vector<VertexStruct> &Vertices,
+                               const std::vector<VertexBoneData> &Bones) {
+  m_BindMin = Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+  m_BindMax = Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (unsigned int v = 0; v < Vertices.size(); v++) {
+    Vector3f p(Vertices[v].position.x, Vertices[v].position.y,
+               Vertices[v].position.z);
+    GrowBounds(m_BindMin, m_BindMax, p, p);
+
+    // Every bone that moves the vertex must bound it, however small the
+    // weight: the skinned vertex is a blend of where these bones put it.
+    for (unsigned int i = 0; i < MAX_BONE_INFLUENCES; i++) {
+      if (Bones[v].Weights[i] <= 0.0f) {
+        continue;
+      }
+      BoneInfo &Bone = m_BoneInfo[Bones[v].IDs[i]];
+      GrowBounds(Bone.BoundsMin, Bone.BoundsMax, p, p);
+    }
+  }
+
+  if (Vertices.empty()) {
+    m_BindMin = Vector3f(0.0f, 0.0f, 0.0f);
+    m_BindMax = Vector3f(0.0f, 0.0f, 0.0f);
+  }
+}
+
 void SkeletalModel::BoneTransform(float TimeInSeconds,
                                   std::vector<Matrix4f> &Transforms) {
-  Matrix4f Identity;
-  Identity.InitIdentity();
-
-  float TicksPerSecond = pScene->mAnimations[0]->mTicksPerSecond;
-  float TimeInTicks = TimeInSeconds * TicksPerSecond;
-  float AnimationTime = fmod(TimeInTicks, pScene->mAnimations[0]->mDuration);
+  Transforms.resize(m_NumBones);
+  if (m_NumBones > 0) {
+    EvaluatePalette(TimeInSeconds, m_State, &Transforms[0]);
+  }
+}
 
-  ReadNodeHierarchy(AnimationTime, pScene->mRootNode, Identity);
+void SkeletalModel::BoneTransform(float TimeInSeconds,
+                                  std::vector<DualQuaternion> &Transforms) {
+  // The matrices go through the palette sized at load time, only the
+  // output can allocate, the first time.
+  BoneTransform(TimeInSeconds, m_Palette);
 
   Transforms.resize(m_NumBones);
-
-  // Populates transforms vector with new bone transformation matrices.
-  for (unsigned int i = 0; i < m_NumBones; i++) {
-    Transforms[i] = m_BoneInfo[i].FinalTransformation;
+  if (m_NumBones > 0) {
+    ToDualQuaternions(&m_Palette[0], m_NumBones, &Transforms[0]);
   }
 }
 
-unsigned int SkeletalModel::FindRotation(float AnimationTime,
-                                         const aiNodeAnim *pNodeAnim) {
-  // Check if there are rotation keyframes.
-  assert(pNodeAnim->mNumRotationKeys > 0);
-
-  // Find the rotation key just before the current animation time and return the
-  // index.
-  for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++) {
-    if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime) {
-      return i;
-    }
+void SkeletalModel::ToDualQuaternions(const Matrix4f *Palette,
+                                      unsigned int NumBones,
+                                      DualQuaternion *Out) {
+  for (unsigned int i = 0; i < NumBones; i++) {
+    Out[i].InitFromTransform(Palette[i]);
   }
-  assert(0);
+}
 
-  return 0;
+float AnimationLayer::GetWeight(float TimeInSeconds) const {
+  if (FadeTime <= 0.0f) {
+    return Weight;
+  }
+  float Fade = (TimeInSeconds - StartTime) / FadeTime;
+  return Weight * std::min(std::max(Fade, 0.0f), 1.0f);
 }
 
-unsigned int SkeletalModel::FindScale(float AnimationTime,
-                                      const aiNodeAnim *pNodeAnim) {
-  assert(pNodeAnim->mNumScalingKeys > 0);
+void SkeletalModel::InitState(AnimationState &State) const {
+  State.NumLayers = 0;
+  State.Cursors[0].assign(m_Joints.size(), KeyCursor());
+  SeedPose(State.Poses[0], m_Joints, false);
+  State.GlobalTransforms.resize(m_Joints.size());
+}
 
-  // Find the scaling key just before the current animation time and return the
-  // index.
-  for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++) {
-    if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime) {
-      return i;
+void SkeletalModel::EvaluatePalette(float TimeInSeconds, AnimationState &State,
+                                    Matrix4f *Palette,
+                                    bool SkipMinorJoints) const {
+  // Drop the layers hidden by a regular layer that is fully faded in.
+  for (unsigned int i = State.NumLayers; i-- > 1;) {
+    const AnimationLayer &Layer = State.Layers[i];
+    if (!Layer.Additive && Layer.GetWeight(TimeInSeconds) >= 1.0f) {
+      RemoveLayers(State, 0, i);
+      break;
     }
   }
-  assert(0);
 
-  return 0;
+  CalcJointTransforms(TimeInSeconds, State, Palette, SkipMinorJoints);
 }
 
-unsigned int SkeletalModel::FindTranslation(float AnimationTime,
-                                            const aiNodeAnim *pNodeAnim) {
-  assert(pNodeAnim->mNumPositionKeys > 0);
+void SkeletalModel::PlayClip(AnimationState &State, unsigned int Clip,
+                             float TimeInSeconds, float FadeTime) const {
+  // The first clip, played without layers, is faded out like any other.
+  if (State.NumLayers == 0) {
+    AnimationLayer First = {0, 0.0f, 1.0f, 0.0f, false};
+    InsertLayer(State, 0, First, m_Joints);
+  }
+  if (State.NumLayers == MAX_ANIMATION_LAYERS) {
+    RemoveLayers(State, 0, 1);
+  }
 
-  // Find the translation key just before the current animation time and return
-  // the index.
-  for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++) {
-    if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime) {
-      return i;
-    }
+  // The regular layers stay below the additive ones, which keep adding to
+  // the cross-faded pose.
+  unsigned int Index = 0;
+  while (Index < State.NumLayers && !State.Layers[Index].Additive) {
+    Index++;
   }
-  assert(0);
 
-  return 0;
+  AnimationLayer Layer = {Clip, TimeInSeconds, 1.0f, FadeTime, false};
+  InsertLayer(State, Index, Layer, m_Joints);
 }
 
-void SkeletalModel::CalcInterpolatedRotation(aiQuaternion &Out,
-                                             float AnimationTime,
-                                             const aiNodeAnim *pNodeAnim) {
-  // we need at least two values to interpolate...
-  if (pNodeAnim->mNumRotationKeys == 1) {
-    Out = pNodeAnim->mRotationKeys[0].mValue;
-    return;
+void SkeletalModel::AddLayer(AnimationState &State, unsigned int Clip,
+                             float TimeInSeconds, float Weight) const {
+  if (State.NumLayers == 0) {
+    AnimationLayer First = {0, 0.0f, 1.0f, 0.0f, false};
+    InsertLayer(State, 0, First, m_Joints);
+  }
+  if (State.NumLayers == MAX_ANIMATION_LAYERS) {
+    RemoveLayers(State, State.NumLayers - 1, 1);
   }
-  // Obtain the current rotation keyframe.
-  unsigned int RotationIndex = FindRotation(AnimationTime, pNodeAnim);
-
-  // Calculate the next rotation keyframe and check bounds.
-  unsigned int NextRotationIndex = (RotationIndex + 1);
-  assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
 
-  // Calculate delta time, i.e time between the two keyframes.
-  float DeltaTime = pNodeAnim->mRotationKeys[NextRotationIndex].mTime -
-                    pNodeAnim->mRotationKeys[RotationIndex].mTime;
+  AnimationLayer Layer = {Clip, TimeInSeconds, Weight, 0.0f, true};
+  InsertLayer(State, State.NumLayers, Layer, m_Joints);
+}
 
-  // Calculate the elapsed time within the delta time.
-  float Factor =
-      (AnimationTime - (float)pNodeAnim->mRotationKeys[RotationIndex].mTime) /
-      DeltaTime;
-  // assert(Factor >= 0.0f && Factor <= 1.0f);
+float SkeletalModel::GetDuration(unsigned int Clip) const {
+  if (!m_pLibrary || Clip >= m_pLibrary->GetNumClips()) {
+    return 0.0f;
+  }
+  return m_pLibrary->GetDuration(Clip);
+}
 
-  // Obtain the quaternions values for the current and next keyframe.
-  const aiQuaternion &StartRotationQ =
-      pNodeAnim->mRotationKeys[RotationIndex].mValue;
-  const aiQuaternion &EndRotationQ =
-      pNodeAnim->mRotationKeys[NextRotationIndex].mValue;
+void SkeletalModel::SetBoneInfluences(unsigned int NumInfluences,
+                                      bool WideWeights) {
+  assert(NumInfluences == 1 || NumInfluences == 2 || NumInfluences == 4 ||
+         NumInfluences == MAX_BONE_INFLUENCES);
+  m_BoneFormat.NumInfluences = NumInfluences;
+  m_BoneFormat.WideWeights = WideWeights;
+}
 
-  // Interpolate between them using the Factor.
-  aiQuaternion::Interpolate(Out, StartRotationQ, EndRotationQ, Factor);
+void SkeletalModel::CalcBounds(const Matrix4f *Palette, Vector3f &Min,
+                               Vector3f &Max) const {
+  Min = Vector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+  Max = Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (unsigned int b = 0; b < m_NumBones; b++) {
+    const BoneInfo &Bone = m_BoneInfo[b];
+    if (Bone.BoundsMin.x > Bone.BoundsMax.x) {
+      continue;
+    }
 
-  // Normalise and set the reference.
-  Out = Out.Normalize();
-}
+    // The box moved by the bone transformation (Arvo): its center is
+    // transformed, its half extents go through the absolute values of the
+    // 3x3 part, the smallest axis aligned box around the rotated one.
+    const Matrix4f &m = Palette[b];
+    Vector3f Center((Bone.BoundsMin.x + Bone.BoundsMax.x) * 0.5f,
+                    (Bone.BoundsMin.y + Bone.BoundsMax.y) * 0.5f,
+                    (Bone.BoundsMin.z + Bone.BoundsMax.z) * 0.5f);
+    Vector3f Extent((Bone.BoundsMax.x - Bone.BoundsMin.x) * 0.5f,
+                    (Bone.BoundsMax.y - Bone.BoundsMin.y) * 0.5f,
+                    (Bone.BoundsMax.z - Bone.BoundsMin.z) * 0.5f);
+    Vector3f c = m.TransformPoint(Center);
+    Vector3f e(fabsf(m.m[0][0]) * Extent.x + fabsf(m.m[0][1]) * Extent.y +
+                   fabsf(m.m[0][2]) * Extent.z,
+               fabsf(m.m[1][0]) * Extent.x + fabsf(m.m[1][1]) * Extent.y +
+                   fabsf(m.m[1][2]) * Extent.z,
+               fabsf(m.m[2][0]) * Extent.x + fabsf(m.m[2][1]) * Extent.y +
+                   fabsf(m.m[2][2]) * Extent.z);
+    GrowBounds(Min, Max, Vector3f(c.x - e.x, c.y - e.y, c.z - e.z),
+               Vector3f(c.x + e.x, c.y + e.y, c.z + e.z));
+  }
 
-void SkeletalModel::CalcInterpolatedScaling(aiVector3D &Out,
-                                            float AnimationTime,
-                                            const aiNodeAnim *pNodeAnim) {
-  // we need at least two values to interpolate...
-  if (pNodeAnim->mNumScalingKeys == 1) {
-    Out = pNodeAnim->mScalingKeys[0].mValue;
-    return;
+  // No skinned vertex: the mesh doesn't move.
+  if (Min.x > Max.x) {
+    GetBindBounds(Min, Max);
   }
+}
 
-  unsigned int ScalingIndex = FindScale(AnimationTime, pNodeAnim);
-  unsigned int NextScalingIndex = (ScalingIndex + 1);
-  assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
-  float DeltaTime = pNodeAnim->mScalingKeys[NextScalingIndex].mTime -
-                    pNodeAnim->mScalingKeys[ScalingIndex].mTime;
-  float Factor =
-      (AnimationTime - (float)pNodeAnim->mScalingKeys[ScalingIndex].mTime) /
-      DeltaTime;
-  // assert(Factor >= 0.0f && Factor <= 1.0f);
-  const aiVector3D &Start = pNodeAnim->mScalingKeys[ScalingIndex].mValue;
-  const aiVector3D &End = pNodeAnim->mScalingKeys[NextScalingIndex].mValue;
-
-  aiVector3D Delta = End - Start;
-  Out = Start + Factor * Delta;
-}
-
-void SkeletalModel::CalcInterpolatedTranslation(aiVector3D &Out,
-                                                float AnimationTime,
-                                                const aiNodeAnim *pNodeAnim) {
-  // we need at least two values to interpolate...
-  if (pNodeAnim->mNumPositionKeys == 1) {
-    Out = pNodeAnim->mPositionKeys[0].mValue;
+void SkeletalModel::CalcMotionBounds(float SamplesPerSecond, Vector3f &Min,
+                                     Vector3f &Max) const {
+  GetBindBounds(Min, Max);
+  if (!m_pLibrary || m_NumBones == 0) {
     return;
   }
 
-  unsigned int PositionIndex = FindTranslation(AnimationTime, pNodeAnim);
-  unsigned int NextPositionIndex = (PositionIndex + 1);
-  assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
-  float DeltaTime = pNodeAnim->mPositionKeys[NextPositionIndex].mTime -
-                    pNodeAnim->mPositionKeys[PositionIndex].mTime;
-  float Factor =
-      (AnimationTime - (float)pNodeAnim->mPositionKeys[PositionIndex].mTime) /
-      DeltaTime;
-  // assert(Factor >= 0.0f && Factor <= 1.0f);
-  const aiVector3D &Start = pNodeAnim->mPositionKeys[PositionIndex].mValue;
-  const aiVector3D &End = pNodeAnim->mPositionKeys[NextPositionIndex].mValue;
+  AnimationState State;
+  InitState(State);
+  std::vector<Matrix4f> Palette(m_NumBones);
+  for (unsigned int c = 0; c < m_pLibrary->GetNumClips(); c++) {
+    // Additive clips only make sense on top of another one.
+    if (m_pLibrary->GetClip(c).Additive) {
+      continue;
+    }
 
-  aiVector3D Delta = End - Start;
-  Out = Start + Factor * Delta;
+    PlayClip(State, c, 0.0f);
+    float Duration = GetDuration(c);
+    unsigned int NumSamples =
+        std::max(1u, (unsigned int)ceilf(Duration * SamplesPerSecond));
+    for (unsigned int s = 0; s <= NumSamples; s++) {
+      Vector3f PoseMin, PoseMax;
+      EvaluatePalette(Duration * s / NumSamples, State, &Palette[0]);
+      CalcBounds(&Palette[0], PoseMin, PoseMax);
+      GrowBounds(Min, Max, PoseMin, PoseMax);
+    }
+  }
 }
 
-void SkeletalModel::SetBoneTransform(unsigned int Index,
-                                     const Matrix4f &Transform) {
-  assert(Index < 100);
-
-  m_pShaderProg->setUniformIndex(Index, Transform);
+void SkeletalModel::ResampleAnimation(float SamplesPerSecond) {
+  if (m_pLibrary) {
+    m_pLibrary->Resample(SamplesPerSecond);
+  }
 }
 
-void SkeletalModel::render() const {
-  glBindVertexArray(m_VAO);
+void SkeletalModel::CompressAnimation(float RotationTolerance,
+                                      float TranslationTolerance) {
+  if (!m_pLibrary) {
+    return;
+  }
 
-  // Render all the model's meshes.
-  for (unsigned int i = 0; i < m_Entries.size(); i++) {
+  for (unsigned int Clip = 0; Clip < m_pLibrary->GetNumClips(); Clip++) {
+    const LibraryClip &Library = m_pLibrary->GetClip(Clip);
+    const AnimationClip &Source = Library.Source;
+    if (!Library.Compressed.IsEmpty() || Source.GetNumJoints() == 0) {
+      continue;
+    }
 
-    const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
+    CompressedClip Compressed;
+    Compressed.Compress(Source, RotationTolerance, TranslationTolerance);
+
+    // Compare the joint positions of the two clips in model space, where the
+    // errors of the whole chain add up, at 120 samples per second.
+    std::vector<KeyCursor> SourceCursors(m_Joints.size());
+    std::vector<KeyCursor> CompressedCursors(m_Joints.size());
+    std::vector<Matrix4f> SourceGlobals, CompressedGlobals;
+    float Step = Source.GetTicksPerSecond() / 120.0f;
+    float MaxError = 0.0f;
+    double ErrorSum = 0.0;
+    unsigned int NumErrors = 0;
+
+    for (float Time = 0.0f; Step > 0.0f && Time <= Source.GetDuration();
+         Time += Step) {
+      SampleGlobalTransforms(Source, m_Joints, Time, SourceCursors,
+                             SourceGlobals);
+      SampleGlobalTransforms(Compressed, m_Joints, Time, CompressedCursors,
+                             CompressedGlobals);
+
+      for (unsigned int i = 0; i < m_Joints.size(); i++) {
+        const Matrix4f &s = SourceGlobals[i];
+        const Matrix4f &c = CompressedGlobals[i];
+        Vector3f Delta(s.m[0][3] - c.m[0][3], s.m[1][3] - c.m[1][3],
+                       s.m[2][3] - c.m[2][3]);
+        float Error = sqrtf(Delta.x * Delta.x + Delta.y * Delta.y +
+                            Delta.z * Delta.z);
+        MaxError = std::max(MaxError, Error);
+        ErrorSum += Error;
+        NumErrors++;
+      }
+    }
 
-    glDrawElementsBaseVertex(
-        GL_TRIANGLES, m_Entries[i].NumIndices, GL_UNSIGNED_INT,
-        (void *)(sizeof(unsigned int) * m_Entries[i].BaseIndex),
-        m_Entries[i].BaseVertex);
-  }
+    CompressionStats Stats;
+    Stats.SourceBytes = (unsigned int)Source.GetMemoryUsage();
+    Stats.CompressedBytes = (unsigned int)Compressed.GetMemoryUsage();
+    Stats.NumKeys = Compressed.GetNumKeys();
+    Stats.MaxError = MaxError;
+    Stats.MeanError = NumErrors > 0 ? (float)(ErrorSum / NumErrors) : 0.0f;
 
-  // Make sure the VAO is not changed from the outside
-  glBindVertexArray(0);
+    // Only the compressed keys are kept.
+    m_pLibrary->SetCompressed(Clip, Compressed, Stats);
+  }
+  InitState(m_State);
 }
 
-void SkeletalModel::ReadNodeHierarchy(float AnimationTime, const aiNode *pNode,
-                                      const Matrix4f &ParentTransform) {
-  Matrix4f IdentityTest;
-  IdentityTest.InitIdentity();
-
-  // Obtain the name of the current node
-  std::string NodeName(pNode->mName.data);
+void SkeletalModel::render(unsigned int NumInstances,
+                           unsigned int FirstInstance) const {
+  if (m_DrawCommands.empty() || NumInstances == 0) {
+    return;
+  }
 
-  // Use the first animation
-  const aiAnimation *pAnimation = pScene->mAnimations[0];
+  // Render all the model's meshes with the same instances. Orphaned, the
+  // previous draw may still be reading the commands.
+  for (unsigned int i = 0; i < m_DrawCommands.size(); i++) {
+    m_DrawCommands[i].InstanceCount = NumInstances;
+    m_DrawCommands[i].BaseInstance = FirstInstance;
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,
+               m_DrawCommands.size() * sizeof(DrawElementsIndirectCommand),
+               &m_DrawCommands[0], GL_STREAM_DRAW);
 
-  // Obtain transformation relative to node's parent.
-  Matrix4f NodeTransformation(pNode->mTransformation);
+  glState().bindVertexArray(m_VAO);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void *)0,
+                              (GLsizei)m_DrawCommands.size(), 0);
 
-  const aiNodeAnim *pNodeAnim = NULL;
+  // Make sure the VAO is not changed from the outside
+  glState().bindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
 
-  // Find the animation channel of the current node.
-  for (unsigned i = 0; i < pAnimation->mNumChannels; i++) {
-    const aiNodeAnim *pNodeAnimIndex = pAnimation->mChannels[i];
+void SkeletalModel::SampleLayer(const AnimationLayer &Layer,
+                                float TimeInSeconds,
+                                std::vector<KeyCursor> &Cursors,
+                                PoseEvaluator &Pose, bool Blended,
+                                bool SkipMinorJoints) const {
+  float AnimationTime =
+      m_pLibrary->GetAnimationTime(Layer.Clip, TimeInSeconds - Layer.StartTime);
+
+  for (unsigned int i = 0; i < m_Joints.size(); i++) {
+    if (SkipMinorJoints && m_Joints[i].Minor) {
+      continue;
+    }
 
-    // If there is a match for a channel with the current node's name, then
-    // we've found the animation channel.
-    if (std::string(pNodeAnimIndex->mNodeName.data) == NodeName) {
-      pNodeAnim = pNodeAnimIndex;
+    if (m_pLibrary->IsAnimated(Layer.Clip, i)) {
+      JointKeys Keys;
+      m_pLibrary->SampleKeys(Layer.Clip, i, AnimationTime, Cursors[i], Keys);
+      Pose.SetKeys(i, Keys);
+    } else if (Blended) {
+      // The joint still takes part in the blend, with its bind pose.
+      Pose.SetKeys(i, Layer.Additive ? IdentityKeys : m_Joints[i].BindKeys);
     }
   }
+}
 
-  if (pNodeAnim) {
-
-    //// Interpolate scaling and generate scaling transformation matrix
-    // aiVector3D Scaling;
-    // CalcInterpolatedScaling(Scaling, AnimationTime, pNodeAnim);
-    // Matrix4f ScalingM;
-    // ScalingM.InitScaleTransform(Scaling.x, Scaling.y, Scaling.z);
-
-    // Interpolate rotation and generate rotation transformation matrix
-    aiQuaternion RotationQ;
-    CalcInterpolatedRotation(RotationQ, AnimationTime, pNodeAnim);
-    Matrix4f RotationM = Matrix4f(RotationQ.GetMatrix());
-
-    // Interpolate translation and generate translation transformation matrix
-    aiVector3D Translation;
-    CalcInterpolatedTranslation(Translation, AnimationTime, pNodeAnim);
-    Matrix4f TranslationM;
-    TranslationM.InitTranslationTransform(Translation.x, Translation.y,
-                                          Translation.z);
+void SkeletalModel::CalcJointTransforms(float TimeInSeconds,
+                                        AnimationState &State,
+                                        Matrix4f *Palette,
+                                        bool SkipMinorJoints) const {
+  // Without layers the first clip is played from the start.
+  AnimationLayer First = {0, 0.0f, 1.0f, 0.0f, false};
+  const AnimationLayer *Layers = State.NumLayers > 0 ? State.Layers : &First;
+  unsigned int NumLayers = 0;
+  if (m_pLibrary && m_pLibrary->GetNumClips() > 0) {
+    NumLayers = State.NumLayers > 0 ? State.NumLayers : 1;
+  }
 
-    // Combine the above transformations
-    NodeTransformation = TranslationM * RotationM; /* *ScalingM;*/
+  // Fetch the keys of the animated joints first, then interpolate them
+  // several joints at a time. The layers are blended in joint space, on the
+  // interpolated poses, so the hierarchy below is walked once whatever the
+  // number of layers. The skipped joints keep their previous keys.
+  bool Blended = NumLayers > 1;
+  for (unsigned int l = 0; l < NumLayers; l++) {
+    SampleLayer(Layers[l], TimeInSeconds, State.Cursors[l], State.Poses[l],
+                Blended, SkipMinorJoints);
+  }
+  if (Blended) {
+    for (unsigned int l = 0; l < NumLayers; l++) {
+      State.Poses[l].Interpolate();
+    }
+    for (unsigned int l = 1; l < NumLayers; l++) {
+      float Weight = Layers[l].GetWeight(TimeInSeconds);
+      if (Layers[l].Additive) {
+        State.Poses[0].AddPose(State.Poses[l], Weight);
+      } else {
+        State.Poses[0].BlendPose(State.Poses[l], Weight);
+      }
+    }
+    State.Poses[0].BuildLocalTransforms();
+  } else if (NumLayers == 1) {
+    State.Poses[0].Evaluate();
   }
 
-  Matrix4f GlobalTransformation = ParentTransform * NodeTransformation;
+  for (unsigned int i = 0; i < m_Joints.size(); i++) {
+    const Joint &joint = m_Joints[i];
 
-  // Apply the final transformation to the indexed bone in the array.
-  if (m_BoneMapping.find(NodeName) != m_BoneMapping.end()) {
-    unsigned int BoneIndex = m_BoneMapping[NodeName];
-    m_BoneInfo[BoneIndex].FinalTransformation =
-        m_GlobalInverseTransform * GlobalTransformation *
-        m_BoneInfo[BoneIndex].BoneOffset;
-  }
+    bool Animated = false;
+    for (unsigned int l = 0; l < NumLayers && !Animated; l++) {
+      Animated = m_pLibrary->IsAnimated(Layers[l].Clip, i);
+    }
 
-  // Do the same for all the node's children.
-  for (unsigned i = 0; i < pNode->mNumChildren; i++) {
-    ReadNodeHierarchy(AnimationTime, pNode->mChildren[i], GlobalTransformation);
+    // Obtain transformation relative to node's parent.
+    Matrix4f NodeTransformation;
+    if (Animated) {
+      State.Poses[0].GetLocalTransform(i, NodeTransformation);
+    } else {
+      NodeTransformation = joint.LocalTransform;
+    }
+
+    // Parents come first, so their global transformation is already known.
+    // The inverse of the root transformation is applied once, to the root.
+    const Matrix4f &Parent = joint.Parent < 0
+                                 ? m_GlobalInverseTransform
+                                 : State.GlobalTransforms[joint.Parent];
+    Matrix4f::MultiplyAffine(Parent, NodeTransformation,
+                             State.GlobalTransforms[i]);
+
+    // Apply the final transformation to the indexed bone in the array.
+    if (joint.Bone >= 0) {
+      Matrix4f::MultiplyAffine(State.GlobalTransforms[i],
+                               m_BoneInfo[joint.Bone].BoneOffset,
+                               Palette[joint.Bone]);
+    }
   }
-}
\ No newline at end of file
+}
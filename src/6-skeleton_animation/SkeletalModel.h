@@ -1,12 +1,15 @@
 #ifndef SKELETALMODEL_H
 #define SKELETALMODEL_H
 
+#include "AnimationLibrary.h"
 #include "Math3D.h"
+#include "PoseEvaluator.h"
 #include "glslprogram.h"
 #include <assimp/Importer.hpp>  // C++ importer interface
 #include <assimp/postprocess.h> // Post processing fla
 #include <assimp/scene.h>       // Output data structure
 #include <glad/glad.h>
+#include <float.h>
 #include <glm/glm.hpp>
 #include <map>
 #include <vector>
@@ -17,10 +20,14 @@ struct VertexStruct {
   glm::vec2 uvs;      //!< Vertex uv's
 };
 
+// Most bone influences a vertex can keep.
+#define MAX_BONE_INFLUENCES 8
+
+// The bone influences of a vertex while importing, strongest first. Only
+// the MAX_BONE_INFLUENCES strongest are kept, the unused slots weigh 0.
 struct VertexBoneData {
-  unsigned int
-      IDs[4];       //!< An array of 4 bone Ids that influence a single vertex.
-  float Weights[4]; //!< An array of the weight influence per bone.
+  unsigned int IDs[MAX_BONE_INFLUENCES]; //!< Bones influencing the vertex.
+  float Weights[MAX_BONE_INFLUENCES];    //!< Influence of each bone.
 
   VertexBoneData() {
     // 0's out the arrays.
@@ -28,39 +35,144 @@ struct VertexBoneData {
   }
 
   void Reset() {
-    memset(IDs, 0, 4 * sizeof(IDs[0]));
-    memset(Weights, 0, 4 * sizeof(Weights[0]));
+    memset(IDs, 0, MAX_BONE_INFLUENCES * sizeof(IDs[0]));
+    memset(Weights, 0, MAX_BONE_INFLUENCES * sizeof(Weights[0]));
   }
 
   void AddBoneData(unsigned int BoneID, float Weight) {
-    for (unsigned int i = 0; i < 4; i++) {
-
-      // Check to see if there are any empty weight values.
-      if (Weights[i] == 0.0) {
-        // Add ID of bone.
-        IDs[i] = BoneID;
+    // Insert in decreasing weight order, the weakest influence falls off the
+    // end when they are all taken.
+    unsigned int i = MAX_BONE_INFLUENCES;
+    while (i > 0 && Weights[i - 1] < Weight) {
+      if (i < MAX_BONE_INFLUENCES) {
+        IDs[i] = IDs[i - 1];
+        Weights[i] = Weights[i - 1];
+      }
+      i--;
+    }
+    if (i < MAX_BONE_INFLUENCES) {
+      IDs[i] = BoneID;
+      Weights[i] = Weight;
+    }
+  }
 
-        // Set the vertex weight influence for this bone ID.
-        Weights[i] = Weight;
-        return;
+  void Limit(unsigned int NumInfluences) {
+    // Drop the weakest influences and scale the others back to a sum of 1.
+    float Sum = 0.0f;
+    for (unsigned int i = 0; i < MAX_BONE_INFLUENCES; i++) {
+      if (i >= NumInfluences) {
+        IDs[i] = 0;
+        Weights[i] = 0.0f;
       }
+      Sum += Weights[i];
+    }
+    for (unsigned int i = 0; i < NumInfluences && Sum > 0.0f; i++) {
+      Weights[i] /= Sum;
     }
-    // should never get here - more bones than we have space for
-    assert(0);
   }
 };
 
+// How the bone influences of the vertices are packed in the bone buffer. Per
+// vertex, the bone indices then the weights, each block padded to 4 bytes:
+// 8 bytes for 4 influences with 8 bit indices and weights.
+struct BoneInfluenceFormat {
+  unsigned int NumInfluences; //!< 1, 2, 4 or 8.
+  bool WideIDs;     //!< 16 bit bone indices, more than 256 bones.
+  bool WideWeights; //!< 16 bit unsigned normalized weights instead of 8.
+
+  BoneInfluenceFormat()
+      : NumInfluences(4), WideIDs(false), WideWeights(false) {}
+
+  unsigned int GetIDsSize() const {
+    return (NumInfluences * (WideIDs ? 2 : 1) + 3) / 4 * 4;
+  } //!< Bytes of the indices of a vertex, the offset of its weights.
+  unsigned int GetWeightsSize() const {
+    return (NumInfluences * (WideWeights ? 2 : 1) + 3) / 4 * 4;
+  }
+  unsigned int GetStride() const { return GetIDsSize() + GetWeightsSize(); }
+
+  void Pack(const VertexBoneData &Bones,
+            unsigned char *pOut) const; //!< Writes GetStride() bytes. The
+                                        //!< weights are rounded to sum to
+                                        //!< exactly 1.
+};
+
 // Stores bone information
 struct BoneInfo {
-  Matrix4f FinalTransformation; // Final transformation to apply to vertices
-  Matrix4f BoneOffset;          // Initial offset from local to bone space.
+  Matrix4f BoneOffset; // Initial offset from local to bone space.
+  Vector3f BoundsMin, BoundsMax; // Bind pose box of the vertices the bone
+                                 // moves, empty if Min > Max.
 
-  BoneInfo() {
+  BoneInfo()
+      : BoundsMin(FLT_MAX, FLT_MAX, FLT_MAX),
+        BoundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX) {
     BoneOffset.SetZero();
-    FinalTransformation.SetZero();
   }
 };
 
+// A node of the scene hierarchy, flattened at load time. Joints are stored
+// parent-before-child so the whole skeleton is evaluated in one forward loop,
+// without names, map lookups or recursion.
+struct Joint {
+  int Parent; //!< Index of the parent joint, -1 for the root.
+  int Bone;   //!< Index in the bone info array, -1 if no vertex uses it.
+  Matrix4f LocalTransform; //!< Node transformation relative to its parent,
+                           //!< used when the joint is not animated.
+  bool Minor; //!< Finger or face joint, skipped by the far animation LODs.
+  JointKeys BindKeys; //!< LocalTransform as keys, for the blended layers
+                      //!< that don't animate the joint.
+};
+
+// Most clips an AnimationState blends at once.
+#define MAX_ANIMATION_LAYERS 4
+
+// A clip played by an AnimationState. The layers are applied in order on top
+// of the first one: a regular layer cross-fades from the pose below it, an
+// additive layer adds the differences stored in its clip.
+struct AnimationLayer {
+  unsigned int Clip; //!< Index in the AnimationLibrary.
+  float StartTime;   //!< Playback time the clip started at, in seconds.
+  float Weight;      //!< Blend weight once faded in.
+  float FadeTime;    //!< Seconds to go from 0 to Weight.
+  bool Additive;     //!< The clip was made additive.
+
+  float GetWeight(float TimeInSeconds) const; //!< Weight at the given
+                                              //!< playback time, ramped up
+                                              //!< over FadeTime.
+};
+
+// Playback state of one animated character. The skeleton and the animations
+// belong to the SkeletalModel and its AnimationLibrary and are shared, so
+// many characters can play them at different times, each one with its own
+// state. Without layers the first clip of the library is played.
+struct AnimationState {
+  AnimationLayer Layers[MAX_ANIMATION_LAYERS]; //!< Clips being blended.
+  unsigned int NumLayers;                      //!< 0 for the first clip.
+
+  std::vector<KeyCursor>
+      Cursors[MAX_ANIMATION_LAYERS]; //!< Per layer, per joint key cursors.
+  PoseEvaluator Poses[MAX_ANIMATION_LAYERS]; //!< Per layer SIMD
+                                             //!< interpolation of the keys,
+                                             //!< blended into the first one.
+  std::vector<Matrix4f>
+      GlobalTransforms; //!< Per joint transformation relative to the root of
+                        //!< the model.
+
+  AnimationState() : NumLayers(0) {}
+};
+
+// Arguments of one draw of glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+  GLuint Count;         //!< Indices of the mesh.
+  GLuint InstanceCount; //!< Instances drawn.
+  GLuint FirstIndex;    //!< In the index buffer of the model.
+  GLint BaseVertex;     //!< Added to the indices.
+  GLuint BaseInstance;  //!< First element of the per instance attributes.
+};
+
+// Vertex attribute of the instance slot, fetched once per instance.
+#define INSTANCE_SLOT_LOCATION 6
+
 // A mesh entry for each mesh read in from the Assimp scene. A model is usually
 // consisted of a collection of these.
 #define INVALID_MATERIAL 0xFFFFFFFF
@@ -90,8 +202,18 @@ public:
 
   ~SkeletalModel(); //!< Destructor
 
-  void LoadMesh(const std::string &Filename); //!< Loads an animated mesh from a
-                                              //!< given file path
+  void LoadMesh(const std::string &Filename,
+                AnimationLibrary *pLibrary =
+                    NULL); //!< Loads an animated mesh from a given file path.
+                           //!< Its animations go to the given library, shared
+                           //!< with other models, or to a library of its own.
+
+  void LoadSkeleton(const std::string &Filename,
+                    AnimationLibrary *pLibrary =
+                        NULL); //!< Same as LoadMesh without any GL call: only
+                               //!< the skeleton, the bones and the
+                               //!< animations, for evaluating poses without a
+                               //!< GL context. The model can't be rendered.
 
   void BoneTransform(
       float TimeInSeconds,
@@ -99,60 +221,162 @@ public:
           &Transforms); //!< Traverses the scene hierarchy and fetches the
                         //!< matrix transformation for each bone given the time.
 
-  void SetBoneTransform(
-      unsigned int Index,
-      const Matrix4f &Transform); //!< Inserts a bone transformation in the
-                                  //!< uniform array at the given index.
-
-  void render() const; //!< Renders each mesh in the model.
+  void BoneTransform(
+      float TimeInSeconds,
+      std::vector<DualQuaternion>
+          &Transforms); //!< Same as above, as dual quaternions.
+
+  static void ToDualQuaternions(
+      const Matrix4f *Palette, unsigned int NumBones,
+      DualQuaternion *Out); //!< Converts a palette for dual quaternion
+                            //!< skinning. The bone transformations must be
+                            //!< rigid, any scale is lost.
+
+  void InitState(AnimationState &State) const; //!< Sizes a playback state
+                                               //!< for this skeleton.
+
+  void EvaluatePalette(
+      float TimeInSeconds, AnimationState &State, Matrix4f *Palette,
+      bool SkipMinorJoints = false) const; //!< Writes the GetNumBones() bone
+                                           //!< transformations at the given
+                                           //!< time. Safe to call from
+                                           //!< several threads with
+                                           //!< different states. Skipped
+                                           //!< joints keep their last pose,
+                                           //!< the bind pose in a new layer.
+
+  void PlayClip(AnimationState &State, unsigned int Clip, float TimeInSeconds,
+                float FadeTime = 0.0f) const; //!< Cross-fades from the
+                                              //!< current pose to the clip,
+                                              //!< starting at the given
+                                              //!< playback time.
+
+  void AddLayer(AnimationState &State, unsigned int Clip, float TimeInSeconds,
+                float Weight) const; //!< Plays an additive clip on top of
+                                     //!< the others.
+
+  void CalcBounds(const Matrix4f *Palette, Vector3f &Min,
+                  Vector3f &Max) const; //!< Box around the model posed by
+                                        //!< the palette, in model space. It
+                                        //!< bounds the bone boxes, so it's
+                                        //!< larger than the mesh but never
+                                        //!< smaller.
+  void CalcMotionBounds(float SamplesPerSecond, Vector3f &Min,
+                        Vector3f &Max) const; //!< Box around every pose of
+                                              //!< the clips of the library,
+                                              //!< sampled at the given rate.
+  void GetBindBounds(Vector3f &Min, Vector3f &Max) const {
+    Min = m_BindMin;
+    Max = m_BindMax;
+  } //!< Box around the mesh in the bind pose.
+
+  void SetBoneInfluences(unsigned int NumInfluences,
+                         bool WideWeights =
+                             false); //!< Influences kept per vertex by the
+                                     //!< next load: 1, 2, 4 or 8, the
+                                     //!< strongest ones.
+  const BoneInfluenceFormat &GetBoneInfluenceFormat() const {
+    return m_BoneFormat;
+  } //!< Layout of the bone buffer, for the shaders.
+
+  void SetKeepVertices(bool Keep) {
+    m_KeepVertices = Keep;
+  } //!< Keep a copy of the vertices and their bone influences after the
+    //!< next load, for CpuSkinning.
+  const std::vector<VertexStruct> &GetVertices() const { return m_Vertices; }
+  const std::vector<VertexBoneData> &GetVertexBones() const {
+    return m_VertexBones;
+  } //!< Limited to the influences kept, in decreasing weight order.
+
+  unsigned int GetNumBones() const { return m_NumBones; }
+  unsigned int GetNumJoints() const { return (unsigned int)m_Joints.size(); }
+  const std::vector<Joint> &GetJoints() const { return m_Joints; }
+  const Matrix4f &GetBoneOffset(unsigned int Bone) const {
+    return m_BoneInfo[Bone].BoneOffset;
+  }
+  const Matrix4f &GetGlobalInverseTransform() const {
+    return m_GlobalInverseTransform;
+  } //!< Applied to the root joint.
+
+  float GetDuration(unsigned int Clip = 0) const; //!< Length of an animation
+                                                  //!< in seconds.
+
+  AnimationLibrary *GetAnimationLibrary() const { return m_pLibrary; }
+
+  unsigned int GetNumVertices() const { return m_NumVertices; }
+  GLuint GetVertexBuffer() const { return vbo; }  //!< VertexStruct array.
+  GLuint GetBoneBuffer() const { return boneBo; } //!< Packed influences,
+                                                   //!< see
+                                                   //!< BoneInfluenceFormat.
+  GLuint GetIndexBuffer() const { return ebo; }
+  const std::vector<MeshEntry> &GetMeshEntries() const { return m_Entries; }
+
+  void ResampleAnimation(
+      float SamplesPerSecond); //!< Resamples the animation tracks on a
+                               //!< uniform time grid.
+
+  void CompressAnimation(
+      float RotationTolerance,
+      float TranslationTolerance); //!< Switches playback to a compressed copy
+                                   //!< of the animation, keeps the memory
+                                   //!< saved and the error introduced in
+                                   //!< the clip's CompressionStats.
+
+  void SetMaxInstances(unsigned int MaxInstances); //!< Sizes the instance
+                                                   //!< slots, FirstInstance +
+                                                   //!< NumInstances of a
+                                                   //!< render must not exceed
+                                                   //!< it.
+
+  void render(unsigned int NumInstances = 1,
+              unsigned int FirstInstance = 0) const; //!< Renders every mesh
+                                                     //!< of the model in one
+                                                     //!< indirect draw. The
+                                                     //!< instances read the
+                                                     //!< slots from
+                                                     //!< FirstInstance on.
 
 private:
   void LoadBones(unsigned int MeshIndex, const aiMesh *pMesh,
                  std::vector<VertexBoneData>
                      &Bones); //!< Loads the bone data from a given mesh.
-  void CalcInterpolatedRotation(
-      aiQuaternion &Out, float AnimationTime,
-      const aiNodeAnim *pNodeAnim); //!< Calculates the interpolated quaternion
-                                    //!< between two keyframes.
-  void CalcInterpolatedScaling(
-      aiVector3D &Out, float AnimationTime,
-      const aiNodeAnim *pNodeAnim); //!< Calculates the interpolated scaling
-                                    //!< vector between two keyframes.
-  void CalcInterpolatedTranslation(
-      aiVector3D &Out, float AnimationTime,
-      const aiNodeAnim *pNodeAnim); //!< Calculates the interpolated translation
-                                    //!< vector between two keyframes.
-
-  unsigned int
-  FindRotation(float AnimationTime,
-               const aiNodeAnim *pNodeAnim); //!< Finds a rotation key given the
-                                             //!< current animation time.
-  unsigned int FindScale(
-      float AnimationTime,
-      const aiNodeAnim
-          *pNodeAnim); // Finds a scaling key given the current animation time.
-  unsigned int
-  FindTranslation(float AnimationTime,
-                  const aiNodeAnim *pNodeAnim); // Finds a translation key given
-                                                // the current animation time.
-
-  void ReadNodeHierarchy(
-      float AnimationTime, const aiNode *pNode,
-      const Matrix4f
-          &ParentTransform); //!< Recursive function that traverses the scene's
-                             //!< node hierarchy and combines the matrix
-                             //!< transformations.
-
-  void InitFromScene(
-      const aiScene *pScene,
-      const std::string &Filename); //!< Prepares the model for rendering.
+  void BuildSkeleton(const aiNode *pNode, int Parent,
+                     std::map<std::string, int>
+                         &JointMapping); //!< Appends the node and its children
+                                         //!< to the flattened joint array.
+
+  void SampleLayer(const AnimationLayer &Layer, float TimeInSeconds,
+                   std::vector<KeyCursor> &Cursors, PoseEvaluator &Pose,
+                   bool Blended,
+                   bool SkipMinorJoints) const; //!< Keys of one layer.
+
+  void CalcJointTransforms(float TimeInSeconds, AnimationState &State,
+                           Matrix4f *Palette, bool SkipMinorJoints)
+      const; //!< Computes the global transformation of every joint and the
+             //!< final bone transformations.
+
+  void Load(const std::string &Filename, AnimationLibrary *pLibrary,
+            bool CreateBuffers); //!< Reads the file for LoadMesh and
+                                 //!< LoadSkeleton.
+  void InitFromScene(const aiScene *pScene, const std::string &Filename,
+                     bool CreateBuffers); //!< Prepares the model for
+                                          //!< animation, and for rendering
+                                          //!< with CreateBuffers.
+  void InitBuffers(const std::vector<VertexStruct> &Vertices,
+                   const std::vector<GLuint> &Indices,
+                   const std::vector<VertexBoneData>
+                       &Bones); //!< The only GL resources of the model.
   void InitMesh(unsigned int index, const aiMesh *paiMesh,
                 std::vector<VertexStruct> &Vertices,
                 std::vector<GLuint> &Indices,
                 std::vector<VertexBoneData>
                     &Bones); //!< Fetches mesh data from given Assimp mesh.
 
-  void Clear(); //!< Deletes the vertex array object.
+  void InitBounds(const std::vector<VertexStruct> &Vertices,
+                  const std::vector<VertexBoneData>
+                      &Bones); //!< Fits the bone boxes around the vertices.
+
+  void Clear(); //!< Deletes the vertex array object and the draw buffers.
 
   GLSLProgram *m_pShaderProg;
 
@@ -161,23 +385,41 @@ private:
   GLuint ebo;    //!< Indices buffer object.
   GLuint boneBo; //!< Bone data buffer object.
 
-  const aiScene *pScene; //!< The Assimp aiScene object.
+  GLuint m_SlotBuffer;         //!< 0, 1, 2... one per instance, at location
+                               //!< INSTANCE_SLOT_LOCATION.
+  unsigned int m_MaxInstances; //!< Size of m_SlotBuffer.
+  GLuint m_IndirectBuffer;     //!< One command per mesh entry, rewritten by
+                               //!< every render.
+  mutable std::vector<DrawElementsIndirectCommand>
+      m_DrawCommands; //!< Staging of m_IndirectBuffer.
 
-  Assimp::Importer Importer; //!< Assimp importer object for reading in files
-                             //!< into the aiScene.
+  unsigned int m_NumBones;    //!< Total number of bones in the model.
+  unsigned int m_NumVertices; //!< Total number of vertices in the model.
+  Vector3f m_BindMin, m_BindMax; //!< Mesh box in the bind pose.
+  BoneInfluenceFormat m_BoneFormat; //!< Packing of the bone buffer.
 
-  unsigned int m_NumBones; //!< Total number of bones in the model.
+  bool m_KeepVertices;                       //!< See SetKeepVertices.
+  std::vector<VertexStruct> m_Vertices;      //!< Empty unless kept.
+  std::vector<VertexBoneData> m_VertexBones; //!< Empty unless kept.
 
   std::map<std::string, unsigned int>
       m_BoneMapping; //!< Map of bone names to ids
 
   std::vector<BoneInfo>
-      m_BoneInfo; //!< Array containing bone information such as offset matrix
-                  //!< and final transformation.
+      m_BoneInfo; //!< Array containing bone information such as offset
+                  //!< matrix.
 
   Matrix4f GlobalTransformation; //!< Root node transformation.
   Matrix4f m_GlobalInverseTransform;
 
+  std::vector<Joint> m_Joints; //!< Scene nodes in parent-before-child order.
+
+  AnimationLibrary *m_pLibrary; //!< Animations of the skeleton.
+  bool m_OwnsLibrary;           //!< m_pLibrary was created by LoadMesh.
+
+  AnimationState m_State; //!< Playback state used by BoneTransform.
+  std::vector<Matrix4f> m_Palette; //!< Scratch palette of BoneTransform.
+
   std::vector<MeshEntry> m_Entries; //!< Array of mesh entries
 };
 
@@ -0,0 +1,140 @@
+#include "SkinningPass.h"
+
+#include "learnopengl/gl_state.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+// Must match local_size_x in skinning.cs.
+#define SKINNING_GROUP_SIZE 64
+
+// A skinned vertex as written by skinning.cs: std430 packs the vec3 position
+// and the uint normal in 16 bytes.
+struct SkinnedVertex {
+  float Position[3];
+  GLuint Normal; //!< snorm 4x8
+};
+
+SkinningPass::SkinningPass() {
+  m_pModel = NULL;
+  m_NumInstances = 0;
+  m_VAO = 0;
+  m_SkinnedVBO = 0;
+}
+
+SkinningPass::~SkinningPass() { Clear(); }
+
+void SkinningPass::Clear() {
+  if (m_VAO != 0) {
+    glState().deleteVertexArrays(1, &m_VAO);
+    m_VAO = 0;
+  }
+  if (m_SkinnedVBO != 0) {
+    glDeleteBuffers(1, &m_SkinnedVBO);
+    m_SkinnedVBO = 0;
+  }
+}
+
+void SkinningPass::Init(const SkeletalModel *pModel,
+                        unsigned int NumInstances) {
+  Clear();
+
+  m_pModel = pModel;
+  m_NumInstances = NumInstances;
+
+  if (!m_Program.isLinked()) {
+    // Specialized for the packing of the model's bone influences.
+    const BoneInfluenceFormat &Format = pModel->GetBoneInfluenceFormat();
+    m_Program.addDefine("NUM_BONE_INFLUENCES", (int)Format.NumInfluences);
+    m_Program.addDefine("WIDE_BONE_IDS", Format.WideIDs ? 1 : 0);
+    m_Program.addDefine("WIDE_BONE_WEIGHTS", Format.WideWeights ? 1 : 0);
+    try {
+      m_Program.compileShader(PROJECT_DIR
+                              "/src/6-skeleton_animation/shaders/skinning.cs");
+      m_Program.link();
+    } catch (GLSLProgramException &e) {
+      std::cerr << e.what() << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  unsigned int NumVertices = pModel->GetNumVertices();
+
+  glGenBuffers(1, &m_SkinnedVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_SkinnedVBO);
+  glBufferData(GL_ARRAY_BUFFER,
+               (GLsizeiptr)NumInstances * NumVertices * sizeof(SkinnedVertex),
+               NULL, GL_DYNAMIC_COPY);
+
+  // Same attribute locations as the skinned vertex shader, the indices are
+  // the model's ones.
+  glGenVertexArrays(1, &m_VAO);
+  glState().bindVertexArray(m_VAO);
+
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex),
+                        (const GLvoid *)0);
+
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_BYTE, GL_TRUE, sizeof(SkinnedVertex),
+                        (const GLvoid *)offsetof(SkinnedVertex, Normal));
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pModel->GetIndexBuffer());
+  glState().bindVertexArray(0);
+
+  // The instances are stored one after the other, each one is drawn by
+  // offsetting the base vertex of every mesh.
+  const std::vector<MeshEntry> &Entries = pModel->GetMeshEntries();
+  m_Counts.clear();
+  m_Offsets.clear();
+  m_BaseVertices.clear();
+  for (unsigned int i = 0; i < NumInstances; i++) {
+    for (unsigned int j = 0; j < Entries.size(); j++) {
+      m_Counts.push_back(Entries[j].NumIndices);
+      m_Offsets.push_back(
+          (const void *)(sizeof(unsigned int) * Entries[j].BaseIndex));
+      m_BaseVertices.push_back(Entries[j].BaseVertex + i * NumVertices);
+    }
+  }
+}
+
+void SkinningPass::Dispatch(int CrowdColumns, float CrowdSpacing,
+                            unsigned int NumVisible) {
+  unsigned int NumVertices = m_pModel->GetNumVertices();
+  if (NumVisible == 0) {
+    return;
+  }
+
+  m_Program.use();
+  m_Program.setUniform("NumVertices", (int)NumVertices);
+  m_Program.setUniform("NumBones", (int)m_pModel->GetNumBones());
+  m_Program.setUniform("CrowdColumns", CrowdColumns);
+  m_Program.setUniform("CrowdSpacing", CrowdSpacing);
+
+  // The model's vertex buffers are read as storage buffers.
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_pModel->GetVertexBuffer());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_pModel->GetBoneBuffer());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_SkinnedVBO);
+
+  glDispatchCompute(
+      (NumVertices + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE,
+      NumVisible, 1);
+
+  // The draws read the output as vertex attributes.
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void SkinningPass::render(unsigned int NumVisible) const {
+  if (m_Counts.empty() || NumVisible == 0) {
+    return;
+  }
+
+  // The draws are grouped by instance: the visible ones are the first
+  // NumVisible groups, skinned into the first slots of the output.
+  GLsizei NumDraws = (GLsizei)(NumVisible * m_pModel->GetMeshEntries().size());
+  glState().bindVertexArray(m_VAO);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, &m_Counts[0], GL_UNSIGNED_INT,
+                                &m_Offsets[0], NumDraws, &m_BaseVertices[0]);
+  glState().bindVertexArray(0);
+}
@@ -0,0 +1,50 @@
+#ifndef SKINNINGPASS_H
+#define SKINNINGPASS_H
+
+#include "SkeletalModel.h"
+#include "glslprogram.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Skins the vertices of a SkeletalModel on the GPU with a compute shader, once
+// per frame for every instance of the crowd. The output buffer is drawn as a
+// static mesh (shaders/skinned.vert), so a depth prepass, a shadow pass and
+// the shading pass all reuse the same skinned vertices.
+class SkinningPass {
+public:
+  SkinningPass();  //!< Constructor
+  ~SkinningPass(); //!< Destructor
+
+  void Init(const SkeletalModel *pModel,
+            unsigned int NumInstances); //!< Compiles the compute shader and
+                                        //!< creates the output buffer.
+
+  void Dispatch(int CrowdColumns, float CrowdSpacing,
+                unsigned int NumVisible); //!< Skins the first NumVisible
+                                          //!< instances of the list bound
+                                          //!< at binding 5, with the
+                                          //!< palettes bound at binding 0.
+
+  void render(unsigned int NumVisible) const; //!< Draws the instances
+                                              //!< skinned by Dispatch with
+                                              //!< the currently bound
+                                              //!< program.
+
+private:
+  void Clear(); //!< Deletes the buffers.
+
+  const SkeletalModel *m_pModel;
+  unsigned int m_NumInstances;
+
+  GLSLProgram m_Program; //!< skinning.cs
+
+  GLuint m_VAO;        //!< Skinned positions and normals plus the indices.
+  GLuint m_SkinnedVBO; //!< NumInstances * NumVertices skinned vertices.
+
+  // glMultiDrawElementsBaseVertex arguments: every mesh of every instance.
+  std::vector<GLsizei> m_Counts;
+  std::vector<const void *> m_Offsets;
+  std::vector<GLint> m_BaseVertices;
+};
+
+#endif
@@ -0,0 +1,213 @@
+// Headless benchmark of the animation evaluation: loads the skeleton and the
+// animations without any window or GL context, then evaluates the palettes
+// of a crowd over a fixed set of times, on one thread and on the JobSystem.
+//
+//   xmake build animation_bench
+//   xmake run animation_bench [instances] [samples] [model]
+//
+// The instances, times and repetitions are fixed, and the best repetition is
+// reported, so the numbers of two commits built with the same options can be
+// compared. The last line sums everything up for scripts. The exit code is 1
+// if the steady state evaluation allocated memory.
+
+#include "AllocationTracker.h"
+#include "AnimationCrowd.h"
+#include "JobSystem.h"
+#include "SkeletalModel.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_INSTANCES 256
+#define BENCH_SAMPLES 240
+#define BENCH_REPETITIONS 5
+
+// Same compression as the application.
+#define ROTATION_TOLERANCE 0.001f
+#define TRANSLATION_TOLERANCE 0.01f
+
+namespace {
+// Hardware cache misses of the calling thread, through perf on Linux. Not
+// available elsewhere, nor where the kernel forbids it (containers, VMs,
+// perf_event_paranoid).
+class CacheMissCounter {
+public:
+  CacheMissCounter() {
+    m_Fd = -1;
+#ifdef __linux__
+    perf_event_attr Attr;
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.type = PERF_TYPE_HARDWARE;
+    Attr.size = sizeof(Attr);
+    Attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    Attr.disabled = 1;
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    m_Fd = (int)syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~CacheMissCounter() {
+#ifdef __linux__
+    if (m_Fd >= 0) {
+      close(m_Fd);
+    }
+#endif
+  }
+
+  void Start() {
+#ifdef __linux__
+    if (m_Fd >= 0) {
+      ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  long long Stop() {
+    long long Count = -1;
+#ifdef __linux__
+    if (m_Fd >= 0) {
+      ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(m_Fd, &Count, sizeof(Count)) != sizeof(Count)) {
+        Count = -1;
+      }
+    }
+#endif
+    return Count;
+  }
+
+private:
+  int m_Fd;
+};
+
+double Now() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned int NumInstances = argc > 1 ? atoi(argv[1]) : BENCH_INSTANCES;
+  unsigned int NumSamples = argc > 2 ? atoi(argv[2]) : BENCH_SAMPLES;
+  std::string Filename =
+      argc > 3 ? argv[3]
+               : PROJECT_DIR "/src/6-skeleton_animation/assets/Dying.fbx";
+
+  // No shader program: the model is never rendered.
+  SkeletalModel Model(NULL);
+  Model.LoadSkeleton(Filename);
+  if (Model.GetNumBones() == 0 || Model.GetDuration() <= 0.0f) {
+    printf("No animated skeleton in '%s'\n", Filename.c_str());
+    return 1;
+  }
+  Model.CompressAnimation(ROTATION_TOLERANCE, TRANSLATION_TOLERANCE);
+
+  unsigned int NumJoints = Model.GetNumJoints();
+  unsigned int NumBones = Model.GetNumBones();
+  float Duration = Model.GetDuration();
+  float Step = Duration / NumSamples;
+  double JointEvaluations = (double)NumInstances * NumSamples * NumJoints;
+
+  printf("%u instances, %u samples, %u joints, %u bones, SIMD width %d\n",
+         NumInstances, NumSamples, NumJoints, NumBones, POSE_SIMD_WIDTH);
+  if (!AllocationTracker::IsEnabled()) {
+    printf("Allocations not tracked, build with TRACK_ALLOCATIONS\n");
+  }
+
+  // Everything the evaluation touches is allocated here, the instances are
+  // spread evenly over the animation.
+  std::vector<AnimationState> States(NumInstances);
+  std::vector<float> Offsets(NumInstances);
+  for (unsigned int i = 0; i < NumInstances; i++) {
+    Model.InitState(States[i]);
+    Offsets[i] = Duration * i / NumInstances;
+  }
+  std::vector<Matrix4f> Palettes(NumInstances * NumBones);
+
+  // One thread, instance after instance for every time, as a frame would.
+  CacheMissCounter Counter;
+  double SingleTime = 0.0;
+  long long SingleMisses = -1;
+  unsigned long long SingleAllocations = 0;
+  for (unsigned int r = 0; r <= BENCH_REPETITIONS; r++) {
+    AllocationTracker::BeginFrame();
+    Counter.Start();
+    double Start = Now();
+    for (unsigned int s = 0; s < NumSamples; s++) {
+      for (unsigned int i = 0; i < NumInstances; i++) {
+        Model.EvaluatePalette(s * Step + Offsets[i], States[i],
+                              &Palettes[i * NumBones]);
+      }
+    }
+    double Time = Now() - Start;
+    long long Misses = Counter.Stop();
+
+    // The first pass warms the cursors and the caches up.
+    if (r == 0) {
+      continue;
+    }
+    SingleAllocations += AllocationTracker::GetFrameStats().Count;
+    if (r == 1 || Time < SingleTime) {
+      SingleTime = Time;
+      SingleMisses = Misses;
+    }
+  }
+
+  // The same crowd updated by the JobSystem, one Update per time.
+  JobSystem Jobs;
+  AnimationCrowd Crowd(&Model, &Jobs);
+  for (unsigned int i = 0; i < NumInstances; i++) {
+    Crowd.AddInstance(Offsets[i], 1.0f);
+  }
+  double CrowdTime = 0.0;
+  unsigned long long CrowdAllocations = 0;
+  for (unsigned int r = 0; r <= BENCH_REPETITIONS; r++) {
+    AllocationTracker::BeginFrame();
+    double Start = Now();
+    for (unsigned int s = 0; s < NumSamples; s++) {
+      Crowd.Update(s * Step);
+    }
+    double Time = Now() - Start;
+
+    if (r == 0) {
+      continue;
+    }
+    CrowdAllocations += AllocationTracker::GetFrameStats().Count;
+    if (r == 1 || Time < CrowdTime) {
+      CrowdTime = Time;
+    }
+  }
+
+  double SingleNs = SingleTime / JointEvaluations;
+  double CrowdNs = CrowdTime / JointEvaluations;
+  printf("Single thread: %.2f ns/joint, %.1f us/instance\n", SingleNs,
+         SingleTime / ((double)NumInstances * NumSamples) / 1000.0);
+  if (SingleMisses >= 0) {
+    printf("Cache misses: %.3f per joint\n", SingleMisses / JointEvaluations);
+  } else {
+    printf("Cache misses: not available\n");
+  }
+  printf("JobSystem, %u threads: %.2f ns/joint (%.2fx)\n",
+         Jobs.GetNumThreads(), CrowdNs, SingleNs / CrowdNs);
+  printf("Allocations after warm up: %llu single thread, %llu JobSystem\n",
+         SingleAllocations, CrowdAllocations);
+
+  printf("RESULT ns_per_joint=%.3f mt_ns_per_joint=%.3f "
+         "cache_misses_per_joint=%.4f allocations=%llu\n",
+         SingleNs, CrowdNs,
+         SingleMisses >= 0 ? SingleMisses / JointEvaluations : -1.0,
+         SingleAllocations + CrowdAllocations);
+
+  return SingleAllocations + CrowdAllocations > 0 ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+// Microbenchmark of the Matrix4f operations used to build the skinning
+// palettes: the SIMD paths of Math3D against the scalar code they replaced.
+//
+//   xmake build math3d_bench && xmake run math3d_bench
+//   xmake f --avx=y for the AVX products.
+
+#include "Math3D.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+
+// Joints of the benchmark skeleton, about a humanoid with fingers.
+#define BENCH_JOINTS 64
+#define BENCH_PALETTES 20000
+
+namespace {
+// The scalar product Matrix4f had before the SIMD one.
+void MultiplyScalar(const Matrix4f &Left, const Matrix4f &Right,
+                    Matrix4f &Out) {
+  for (unsigned int i = 0; i < 4; i++) {
+    for (unsigned int j = 0; j < 4; j++) {
+      Out.m[i][j] =
+          Left.m[i][0] * Right.m[0][j] + Left.m[i][1] * Right.m[1][j] +
+          Left.m[i][2] * Right.m[2][j] + Left.m[i][3] * Right.m[3][j];
+    }
+  }
+}
+
+float Random() { return (float)rand() / RAND_MAX * 2.0f - 1.0f; }
+
+Matrix4f RandomAffine() {
+  Matrix4f m;
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int j = 0; j < 4; j++) {
+      m.m[i][j] = Random() + (i == j ? 2.0f : 0.0f);
+    }
+  }
+  m.m[3][0] = m.m[3][1] = m.m[3][2] = 0.0f;
+  m.m[3][3] = 1.0f;
+  return m;
+}
+
+struct BenchSkeleton {
+  std::vector<int> Parents;
+  std::vector<Matrix4f> Locals, Offsets, Globals, Palette;
+};
+
+// Same loop as SkeletalModel::CalcJointTransforms, with the product to
+// measure.
+template <typename Product>
+double BuildPalettes(BenchSkeleton &s, Product Multiply, float &Checksum) {
+  std::chrono::high_resolution_clock::time_point Start =
+      std::chrono::high_resolution_clock::now();
+
+  for (unsigned int n = 0; n < BENCH_PALETTES; n++) {
+    for (unsigned int i = 0; i < BENCH_JOINTS; i++) {
+      if (s.Parents[i] < 0) {
+        s.Globals[i] = s.Locals[i];
+      } else {
+        Multiply(s.Globals[s.Parents[i]], s.Locals[i], s.Globals[i]);
+      }
+      Multiply(s.Globals[i], s.Offsets[i], s.Palette[i]);
+    }
+    Checksum += s.Palette[n % BENCH_JOINTS].m[0][3];
+  }
+
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::high_resolution_clock::now() - Start)
+             .count() /
+         BENCH_PALETTES;
+}
+
+template <typename Function>
+double Measure(unsigned int Count, Function f) {
+  std::chrono::high_resolution_clock::time_point Start =
+      std::chrono::high_resolution_clock::now();
+  for (unsigned int i = 0; i < Count; i++) {
+    f(i);
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::high_resolution_clock::now() - Start)
+             .count() /
+         Count;
+}
+} // namespace
+
+int main() {
+#if defined(MATH3D_SIMD_AVX)
+  printf("Matrix4f products with AVX\n");
+#elif defined(MATH3D_SIMD_SSE)
+  printf("Matrix4f products with SSE\n");
+#else
+  printf("Matrix4f products without SIMD\n");
+#endif
+
+  BenchSkeleton s;
+  for (unsigned int i = 0; i < BENCH_JOINTS; i++) {
+    s.Parents.push_back(i == 0 ? -1 : rand() % i);
+    s.Locals.push_back(RandomAffine());
+    s.Offsets.push_back(RandomAffine());
+  }
+  s.Globals.resize(BENCH_JOINTS);
+  s.Palette.resize(BENCH_JOINTS);
+
+  // Palette build of one skeleton.
+  float Checksum = 0.0f;
+  double Scalar = BuildPalettes(s, MultiplyScalar, Checksum);
+  double Simd = BuildPalettes(
+      s,
+      [](const Matrix4f &l, const Matrix4f &r, Matrix4f &o) { o = l * r; },
+      Checksum);
+  double Affine = BuildPalettes(s, Matrix4f::MultiplyAffine, Checksum);
+  printf("Palette of %u joints: scalar %.0f ns, operator* %.0f ns (%.2fx), "
+         "MultiplyAffine %.0f ns (%.2fx)\n",
+         BENCH_JOINTS, Scalar, Simd, Scalar / Simd, Affine, Scalar / Affine);
+
+  // Inverse of the affine matrices, e.g. the bind pose.
+  std::vector<Matrix4f> Inverses(s.Locals);
+  double General = Measure(BENCH_PALETTES * BENCH_JOINTS, [&](unsigned int i) {
+    Inverses[i % BENCH_JOINTS].Inverse();
+  });
+  double InverseAffine =
+      Measure(BENCH_PALETTES * BENCH_JOINTS, [&](unsigned int i) {
+        Inverses[i % BENCH_JOINTS].InverseAffine();
+      });
+  Checksum += Inverses[0].m[0][0];
+  printf("Inverse: general %.1f ns, affine %.1f ns (%.2fx)\n", General,
+         InverseAffine, General / InverseAffine);
+
+  // Points through one joint matrix, e.g. the corners of the bone bounds.
+  std::vector<Vector3f> Points(BENCH_JOINTS * 8);
+  for (unsigned int i = 0; i < Points.size(); i++) {
+    Points[i] = Vector3f(Random(), Random(), Random());
+  }
+  std::vector<Vector3f> Out(Points.size());
+  unsigned int NumPoints = (unsigned int)Points.size();
+  double Vector4 = Measure(BENCH_PALETTES, [&](unsigned int n) {
+    const Matrix4f &m = s.Palette[n % BENCH_JOINTS];
+    for (unsigned int i = 0; i < NumPoints; i++) {
+      Vector4f v;
+      v.x = Points[i].x;
+      v.y = Points[i].y;
+      v.z = Points[i].z;
+      v.w = 1.0f;
+      Vector4f r = m * v;
+      Out[i] = Vector3f(r.x, r.y, r.z);
+    }
+  });
+  double Transform = Measure(BENCH_PALETTES, [&](unsigned int n) {
+    s.Palette[n % BENCH_JOINTS].TransformPoints(&Points[0], NumPoints,
+                                                &Out[0]);
+  });
+  Checksum += Out[0].x;
+  printf("%u points: operator*(Vector4f) %.0f ns, TransformPoints %.0f ns "
+         "(%.2fx)\n",
+         NumPoints, Vector4, Transform, Vector4 / Transform);
+
+  // Keeps the results alive.
+  printf("(checksum %f)\n", Checksum);
+  return 0;
+}
@@ -0,0 +1,133 @@
+// Headless benchmark of the CPU skinning: loads the mesh and the skeleton
+// without any window or GL context, evaluates a few poses of the animation,
+// then skins every vertex with them, on one thread and on the JobSystem.
+//
+//   xmake build skinning_bench
+//   xmake run skinning_bench [poses] [model]
+//
+// The poses and repetitions are fixed and the best repetition is reported,
+// as in animation_bench. The skinned positions are also checked against a
+// plain Matrix4f blend with the unquantized weights: the difference is the
+// error of the weight quantization, shared with the shaders.
+
+#include "CpuSkinning.h"
+#include "JobSystem.h"
+#include "SkeletalModel.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_POSES 16
+#define BENCH_REPETITIONS 5
+
+namespace {
+double Now() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::high_resolution_clock::now().time_since_epoch())
+      .count();
+}
+
+// Best time, in nanoseconds, to skin the mesh with every pose.
+double TimeSkinning(CpuSkinning &Skinning,
+                    const std::vector<Matrix4f> &Palettes,
+                    unsigned int NumPoses, unsigned int NumBones,
+                    JobSystem *pJobs) {
+  double Best = 0.0;
+  for (unsigned int r = 0; r <= BENCH_REPETITIONS; r++) {
+    double Start = Now();
+    for (unsigned int p = 0; p < NumPoses; p++) {
+      Skinning.Skin(&Palettes[p * NumBones], pJobs);
+    }
+    double Time = Now() - Start;
+
+    // The first pass warms the caches up.
+    if (r == 1 || (r > 1 && Time < Best)) {
+      Best = Time;
+    }
+  }
+  return Best;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned int NumPoses = argc > 1 ? atoi(argv[1]) : BENCH_POSES;
+  std::string Filename =
+      argc > 2 ? argv[2]
+               : PROJECT_DIR "/src/6-skeleton_animation/assets/Dying.fbx";
+  if (NumPoses == 0) {
+    NumPoses = 1;
+  }
+
+  // No shader program: the model is never rendered.
+  SkeletalModel Model(NULL);
+  Model.SetKeepVertices(true);
+  Model.LoadSkeleton(Filename);
+  unsigned int NumBones = Model.GetNumBones();
+  if (NumBones == 0 || Model.GetVertices().empty()) {
+    printf("No skinned mesh in '%s'\n", Filename.c_str());
+    return 1;
+  }
+
+  // Poses spread evenly over the animation.
+  AnimationState State;
+  Model.InitState(State);
+  std::vector<Matrix4f> Palettes(NumPoses * NumBones);
+  for (unsigned int p = 0; p < NumPoses; p++) {
+    Model.EvaluatePalette(Model.GetDuration() * p / NumPoses, State,
+                          &Palettes[p * NumBones]);
+  }
+
+  CpuSkinning Skinning;
+  Skinning.Init(&Model);
+  unsigned int NumVertices = Skinning.GetNumVertices();
+  printf("%u vertices, %u bones, %u influences, %u poses\n", NumVertices,
+         NumBones, Model.GetBoneInfluenceFormat().NumInfluences, NumPoses);
+
+  JobSystem Jobs;
+  double SingleTime =
+      TimeSkinning(Skinning, Palettes, NumPoses, NumBones, NULL);
+  double JobsTime =
+      TimeSkinning(Skinning, Palettes, NumPoses, NumBones, &Jobs);
+  double SkinnedVertices = (double)NumVertices * NumPoses;
+  double SingleRate = SkinnedVertices / SingleTime * 1e9;
+  double JobsRate = SkinnedVertices / JobsTime * 1e9;
+
+  // The last pose, as skinned by the last Skin.
+  const std::vector<VertexStruct> &Vertices = Model.GetVertices();
+  const std::vector<VertexBoneData> &Bones = Model.GetVertexBones();
+  const Matrix4f *Palette = &Palettes[(NumPoses - 1) * NumBones];
+  float MaxError = 0.0f;
+  for (unsigned int v = 0; v < NumVertices; v++) {
+    Matrix4f Blend;
+    Blend.SetZero();
+    for (unsigned int i = 0; i < MAX_BONE_INFLUENCES; i++) {
+      const Matrix4f &Bone = Palette[Bones[v].IDs[i]];
+      for (unsigned int r = 0; r < 3; r++) {
+        for (unsigned int c = 0; c < 4; c++) {
+          Blend.m[r][c] += Bones[v].Weights[i] * Bone.m[r][c];
+        }
+      }
+    }
+
+    const glm::vec3 &p = Vertices[v].position;
+    Vector3f Skinned = Skinning.GetPosition(v);
+    float Expected[3], Actual[3] = {Skinned.x, Skinned.y, Skinned.z};
+    for (unsigned int r = 0; r < 3; r++) {
+      Expected[r] = Blend.m[r][0] * p.x + Blend.m[r][1] * p.y +
+                    Blend.m[r][2] * p.z + Blend.m[r][3];
+      MaxError = fmaxf(MaxError, fabsf(Expected[r] - Actual[r]));
+    }
+  }
+
+  printf("Single thread: %.1f M vertices/s\n", SingleRate / 1e6);
+  printf("JobSystem, %u threads: %.1f M vertices/s (%.2fx)\n",
+         Jobs.GetNumThreads(), JobsRate / 1e6, JobsRate / SingleRate);
+  printf("Largest difference to the unquantized weights: %g\n", MaxError);
+
+  printf("RESULT vertices_per_second=%.0f mt_vertices_per_second=%.0f "
+         "max_error=%g\n",
+         SingleRate, JobsRate, MaxError);
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include "glslprogram.h"
 
+#include "learnopengl/gl_state.h"
+
 #include <fstream>
 using std::ifstream;
 using std::ios;
@@ -21,7 +23,7 @@ struct shader_file_extension extensions[] = {
     {".cs", GLSLShader::COMPUTE}};
 } // namespace GLSLShaderInfo
 
-GLSLProgram::GLSLProgram() : handle(0), linked(false) {}
+GLSLProgram::GLSLProgram() : handle(0), linked(false), separable(false) {}
 
 GLSLProgram::~GLSLProgram() {
   if (handle == 0)
@@ -71,6 +73,12 @@ void GLSLProgram::compileShader(const char *fileName) {
   compileShader(fileName, type);
 }
 
+void GLSLProgram::addDefine(const char *name, int value) {
+  std::ostringstream line;
+  line << "#define " << name << " " << value << "\n";
+  defines += line.str();
+}
+
 string GLSLProgram::getExtension(const char *name) {
   string nameStr(name);
 
@@ -121,7 +129,24 @@ void GLSLProgram::compileShader(const string &source,
 
   GLuint shaderHandle = glCreateShader(type);
 
-  const char *c_code = source.c_str();
+  // The defines go right after the #version line, which must come first,
+  // and the errors keep the line numbers of the file.
+  string code = source;
+  if (!defines.empty()) {
+    size_t pos = 0;
+    if (code.compare(0, 8, "#version") == 0) {
+      pos = code.find('\n');
+      if (pos == string::npos) {
+        code += '\n';
+        pos = code.size();
+      } else {
+        pos++;
+      }
+    }
+    code.insert(pos, defines + (pos > 0 ? "#line 2\n" : "#line 1\n"));
+  }
+
+  const char *c_code = code.c_str();
   glShaderSource(shaderHandle, 1, &c_code, NULL);
 
   // Compile the shader
@@ -158,12 +183,22 @@ void GLSLProgram::compileShader(const string &source,
   }
 }
 
+void GLSLProgram::setSeparable(bool value) {
+  if (linked)
+    throw GLSLProgramException("Program has already been linked");
+  separable = value;
+}
+
 void GLSLProgram::link() {
   if (linked)
     return;
   if (handle <= 0)
     throw GLSLProgramException("Program has not been compiled.");
 
+  // A separable program holds only some of the stages, the others are
+  // provided by the pipeline it gets bound to (see ProgramPipelineCache).
+  glProgramParameteri(handle, GL_PROGRAM_SEPARABLE,
+                      separable ? GL_TRUE : GL_FALSE);
   glLinkProgram(handle);
 
   int status = 0;
@@ -186,6 +221,7 @@ void GLSLProgram::link() {
     throw GLSLProgramException(string("Program link failed:\n") + logString);
   } else {
     uniformLocations.clear();
+    uniformValues.clear();
     linked = true;
   }
 }
@@ -193,13 +229,17 @@ void GLSLProgram::link() {
 void GLSLProgram::use() {
   if (handle <= 0 || (!linked))
     throw GLSLProgramException("Shader has not been linked");
-  glUseProgram(handle);
+  // Through the state cache, which ProgramPipelineCache::bind relies on to
+  // clear it.
+  glState().useProgram(handle);
 }
 
 int GLSLProgram::getHandle() { return handle; }
 
 bool GLSLProgram::isLinked() { return linked; }
 
+bool GLSLProgram::isSeparable() { return separable; }
+
 void GLSLProgram::bindAttribLocation(GLuint location, const char *name) {
   glBindAttribLocation(handle, location, name);
 }
@@ -209,68 +249,72 @@ void GLSLProgram::bindFragDataLocation(GLuint location, const char *name) {
 }
 
 void GLSLProgram::setUniform(const char *name, float x, float y, float z) {
-  GLint loc = getUniformLocation(name);
-  glUniform3f(loc, x, y, z);
+  this->setUniform(name, vec3(x, y, z));
 }
 
 void GLSLProgram::setUniform(const char *name, const vec3 &v) {
-  this->setUniform(name, v.x, v.y, v.z);
+  GLint loc = getUniformLocation(name);
+  if (uniformValues.update(loc, &v[0], sizeof(v)))
+    glProgramUniform3f(handle, loc, v.x, v.y, v.z);
 }
 
 void GLSLProgram::setUniform(const char *name, const vec4 &v) {
   GLint loc = getUniformLocation(name);
-  glUniform4f(loc, v.x, v.y, v.z, v.w);
+  if (uniformValues.update(loc, &v[0], sizeof(v)))
+    glProgramUniform4f(handle, loc, v.x, v.y, v.z, v.w);
 }
 
 void GLSLProgram::setUniform(const char *name, const vec2 &v) {
   GLint loc = getUniformLocation(name);
-  glUniform2f(loc, v.x, v.y);
+  if (uniformValues.update(loc, &v[0], sizeof(v)))
+    glProgramUniform2f(handle, loc, v.x, v.y);
 }
 
 void GLSLProgram::setUniform(const char *name, const mat4 &m) {
   GLint loc = getUniformLocation(name);
-  glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
+  if (uniformValues.update(loc, &m[0][0], sizeof(m)))
+    glProgramUniformMatrix4fv(handle, loc, 1, GL_FALSE, &m[0][0]);
 }
 
 void GLSLProgram::setUniform(const char *name, const mat3 &m) {
   GLint loc = getUniformLocation(name);
-  glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]);
+  if (uniformValues.update(loc, &m[0][0], sizeof(m)))
+    glProgramUniformMatrix3fv(handle, loc, 1, GL_FALSE, &m[0][0]);
 }
 
 void GLSLProgram::setUniform(const char *name, float val) {
   GLint loc = getUniformLocation(name);
-  glUniform1f(loc, val);
+  if (uniformValues.update(loc, &val, sizeof(val)))
+    glProgramUniform1f(handle, loc, val);
 }
 
 void GLSLProgram::setUniform(const char *name, int val) {
   GLint loc = getUniformLocation(name);
-  glUniform1i(loc, val);
+  if (uniformValues.update(loc, &val, sizeof(val)))
+    glProgramUniform1i(handle, loc, val);
 }
 
 void GLSLProgram::setUniform(const char *name, GLuint val) {
   GLint loc = getUniformLocation(name);
-  glUniform1ui(loc, val);
+  if (uniformValues.update(loc, &val, sizeof(val)))
+    glProgramUniform1ui(handle, loc, val);
 }
 
-void GLSLProgram::setUniform(const char *name, bool val) {
-  int loc = getUniformLocation(name);
-  glUniform1i(loc, val);
+void GLSLProgram::setUniform(const char *name, const GLint *vals,
+                             GLsizei count) {
+  GLint loc = getUniformLocation(name);
+  if (uniformValues.update(loc, vals, count * sizeof(GLint)))
+    glProgramUniform1iv(handle, loc, count, vals);
 }
 
-void GLSLProgram::setUniformIndex(unsigned int Index, const Matrix4f &matIn) {
-  // Pass transformation matrix to uniform array.
-  glUniformMatrix4fv(m_boneLocation[Index], 1, GL_TRUE,
-                     (const GLfloat *)matIn.m);
+void GLSLProgram::setUniform(const char *name, bool val) {
+  this->setUniform(name, (int)val);
 }
 
-void GLSLProgram::initialiseBoneUniforms() {
-  for (unsigned int i = 0; i < ui_BoneArraySize; i++) {
+unsigned int GLSLProgram::getUniformUploads() { return uniformValues.uploads; }
 
-    char Name[128];
-    memset(Name, 0, sizeof(Name));
-    snprintf(Name, sizeof(Name), "gBones[%d]", i);
-    m_boneLocation[i] = glGetUniformLocation(handle, Name);
-  }
+unsigned int GLSLProgram::getSkippedUniformUploads() {
+  return uniformValues.skippedUploads;
 }
 
 void GLSLProgram::printActiveUniforms() {
@@ -421,14 +465,17 @@ void GLSLProgram::validate() {
 }
 
 int GLSLProgram::getUniformLocation(const char *name) {
-  std::map<string, int>::iterator pos;
+  std::map<string, int, std::less<>>::iterator pos;
   pos = uniformLocations.find(name);
 
   if (pos == uniformLocations.end()) {
-    uniformLocations[name] = glGetUniformLocation(handle, name);
+    pos = uniformLocations
+              .insert(std::make_pair(string(name),
+                                     glGetUniformLocation(handle, name)))
+              .first;
   }
 
-  return uniformLocations[name];
+  return pos->second;
 }
 
 bool GLSLProgram::fileExists(const string &fileName) {
@@ -14,7 +14,7 @@
 
 #include <string>
 using std::string;
-#include "Math3D.h"
+#include "learnopengl/uniform_cache.h"
 #include <map>
 
 using glm::mat3;
@@ -43,13 +43,13 @@ enum GLSLShaderType {
 
 class GLSLProgram {
 private:
-  static const unsigned int ui_BoneArraySize = 70;
-
-  GLint m_boneLocation[ui_BoneArraySize]; //!< Bone uniform locations
-
   int handle;
   bool linked;
-  std::map<string, int> uniformLocations;
+  bool separable;
+  std::map<string, int, std::less<>>
+      uniformLocations; //!< Looked up by const char *, no string built
+  UniformCache uniformValues; //!< Last value uploaded to each uniform
+  string defines; //!< Inserted after the #version of every shader compiled
 
   GLint getUniformLocation(const char *name);
   bool fileExists(const string &fileName);
@@ -68,12 +68,21 @@ public:
   void compileShader(const string &source, GLSLShader::GLSLShaderType type,
                      const char *fileName = NULL);
 
+  void addDefine(const char *name, int value); //!< For the shaders compiled
+                                               //!< afterwards, to specialize
+                                               //!< them.
+
+  void setSeparable(bool value); //!< Links the stages alone, for a program
+                                 //!< pipeline (see ProgramPipelineCache).
+                                 //!< Its shaders must redeclare the
+                                 //!< gl_PerVertex outputs they write.
   void link();
   void validate();
   void use();
 
   int getHandle();
   bool isLinked();
+  bool isSeparable();
 
   void bindAttribLocation(GLuint location, const char *name);
   void bindFragDataLocation(GLuint location, const char *name);
@@ -88,9 +97,10 @@ public:
   void setUniform(const char *name, int val);
   void setUniform(const char *name, bool val);
   void setUniform(const char *name, GLuint val);
-  void setUniformIndex(unsigned int Index, const Matrix4f &matIn);
+  void setUniform(const char *name, const GLint *vals, GLsizei count);
 
-  void initialiseBoneUniforms();
+  unsigned int getUniformUploads();
+  unsigned int getSkippedUniformUploads();
 
   void printActiveUniforms();
   void printActiveUniformBlocks();
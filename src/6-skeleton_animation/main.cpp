@@ -27,7 +27,11 @@ double lastCursorPositionX, lastCursorPositionY, cursorPositionX,
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Callback function for keypress use to toggle animate (not used at the moment)
-//  and to check for R to reset camera
+//  and to check for R to reset camera, C to toggle the compute skinning,
+//  Q to toggle the dual quaternion skinning, B to toggle the baked animation,
+//  G to toggle the GPU animation, P to toggle the pose cache, F to toggle the
+//  frustum culling, N to cross-fade to the next clip and L to print the crowd
+//  statistics
 /////////////////////////////////////////////////////////////////////////////////////////////
 static void key_callback(GLFWwindow *window, int key, int cancode, int action,
                          int mods) {
@@ -36,6 +40,30 @@ static void key_callback(GLFWwindow *window, int key, int cancode, int action,
       scene->animate(!(scene->animating()));
   if (key == 'R' && action == GLFW_RELEASE)
     camera.reset();
+  if (key == 'C' && action == GLFW_RELEASE)
+    if (scene)
+      scene->computeSkinning(!(scene->computeSkinning()));
+  if (key == 'Q' && action == GLFW_RELEASE)
+    if (scene)
+      scene->dualQuaternions(!(scene->dualQuaternions()));
+  if (key == 'B' && action == GLFW_RELEASE)
+    if (scene)
+      scene->bakedAnimation(!(scene->bakedAnimation()));
+  if (key == 'G' && action == GLFW_RELEASE)
+    if (scene)
+      scene->gpuAnimation(!(scene->gpuAnimation()));
+  if (key == 'P' && action == GLFW_RELEASE)
+    if (scene)
+      scene->poseCache(!(scene->poseCache()));
+  if (key == 'F' && action == GLFW_RELEASE)
+    if (scene)
+      scene->culling(!(scene->culling()));
+  if (key == 'N' && action == GLFW_RELEASE)
+    if (scene)
+      scene->nextClip();
+  if (key == 'L' && action == GLFW_RELEASE)
+    if (scene)
+      scene->printStats();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,290 @@
+#version 430
+
+// Evaluates the bone palettes of the visible instances from the compressed
+// clips, one work group per instance. Every joint samples and interpolates
+// its keys, then the hierarchy is walked one level at a time, the joints of
+// a level in parallel.
+layout (local_size_x = 64) in;
+
+#ifndef MAX_JOINTS
+#define MAX_JOINTS 256
+#endif
+#ifndef MAX_LEVELS
+#define MAX_LEVELS 64
+#endif
+
+// Range of the three smallest quaternion components, see CompressedClip.
+const float SmallestThreeRange = 0.70710678;
+
+// The affine transformations are stored as their first three rows.
+struct Joint
+{
+	vec4 Local[3]; // Relative to the parent, when not animated
+	vec4 Offset[3]; // Bone offset
+	vec4 BindRotation; // Local as keys, for the blends
+	vec4 BindTranslation;
+	int Index; // Of the joint in the tracks of a clip, before sorting
+	int Parent; // In this array, -1 for the roots
+	int Bone; // -1 if no vertex uses it
+	int Padding;
+};
+
+struct Track
+{
+	uint First; // In the keys of all the clips
+	uint Count; // 0 if the joint is not animated
+	float Min[3]; // Translation range
+	float Extent[3];
+};
+
+// Rotation: three 16 bit words, then translation: three 16 bit words.
+struct PackedKey
+{
+	float Time;
+	uint Packed[3];
+};
+
+// Cross-fade from the first clip to the second one.
+struct Instance
+{
+	uint Clips[2];
+	float Times[2]; // Ticks, wrapped around the clip duration
+	float Blend; // Weight of the second clip
+};
+
+// Bone transformations of the visible instances, NumBones per instance.
+layout (std430, binding = 0, row_major) writeonly buffer BonePalettes
+{
+	mat4 gBones[];
+};
+
+// Joints sorted by level, parents first.
+layout (std430, binding = 1) readonly buffer Skeleton
+{
+	vec4 gGlobalInverse[3]; // Applied to the roots
+	Joint gJoints[];
+};
+
+// NumJoints tracks per clip.
+layout (std430, binding = 2) readonly buffer Tracks
+{
+	Track gTracks[];
+};
+
+layout (std430, binding = 3) readonly buffer Keys
+{
+	PackedKey gKeys[];
+};
+
+// One per visible instance.
+layout (std430, binding = 4) readonly buffer Instances
+{
+	Instance gInstances[];
+};
+
+uniform int NumJoints;
+uniform int NumBones;
+uniform int NumLevels;
+uniform int LevelStart[MAX_LEVELS + 1]; // First joint of every level
+
+// Global transformation of every joint of the instance.
+shared vec4 sGlobal[MAX_JOINTS * 3];
+
+vec4 unpackRotation(uint Word0, uint Word1)
+{
+	uvec3 In = uvec3(Word0 & 0xFFFFu, Word0 >> 16, Word1 & 0xFFFFu);
+	uint Largest = (In.x >> 15) | ((In.y >> 15) << 1);
+	vec3 Small = vec3(In & 0x7FFFu) * (2.0 * SmallestThreeRange / 32767.0) -
+			SmallestThreeRange;
+	float Big = sqrt(max(1.0 - dot(Small, Small), 0.0));
+
+	if (Largest == 0u)
+		return vec4(Big, Small);
+	if (Largest == 1u)
+		return vec4(Small.x, Big, Small.yz);
+	if (Largest == 2u)
+		return vec4(Small.xy, Big, Small.z);
+	return vec4(Small, Big);
+}
+
+void unpackKey(Track t, uint Key, out vec4 Rotation, out vec3 Translation)
+{
+	PackedKey k = gKeys[Key];
+	Rotation = unpackRotation(k.Packed[0], k.Packed[1]);
+	vec3 q = vec3(k.Packed[1] >> 16, k.Packed[2] & 0xFFFFu, k.Packed[2] >> 16);
+	Translation = vec3(t.Min[0], t.Min[1], t.Min[2]) +
+			vec3(t.Extent[0], t.Extent[1], t.Extent[2]) * (q / 65535.0);
+}
+
+// Same as Quaternion::Interpolate.
+vec4 slerp(vec4 a, vec4 b, float Factor)
+{
+	float c = dot(a, b);
+	if (c < 0.0)
+	{
+		c = -c;
+		b = -b;
+	}
+	if (1.0 - c > 0.0001)
+	{
+		float Omega = acos(c);
+		return (sin((1.0 - Factor) * Omega) * a + sin(Factor * Omega) * b) /
+				sin(Omega);
+	}
+	return normalize(mix(a, b, Factor));
+}
+
+// Pose of a joint in a clip, false if the clip doesn't animate it.
+bool sampleTrack(uint Clip, int Index, float Time, out vec4 Rotation,
+		out vec3 Translation)
+{
+	Track t = gTracks[Clip * uint(NumJoints) + uint(Index)];
+	if (t.Count == 0u)
+		return false;
+
+	if (t.Count == 1u)
+	{
+		unpackKey(t, t.First, Rotation, Translation);
+		return true;
+	}
+
+	// Last key at or before the time, the interval is [Lo, Lo + 1].
+	uint Lo = 0u, Hi = t.Count - 1u;
+	while (Hi - Lo > 1u)
+	{
+		uint Mid = (Lo + Hi) / 2u;
+		if (gKeys[t.First + Mid].Time <= Time)
+			Lo = Mid;
+		else
+			Hi = Mid;
+	}
+
+	float t0 = gKeys[t.First + Lo].Time;
+	float t1 = gKeys[t.First + Lo + 1u].Time;
+	float Factor = clamp((Time - t0) / (t1 - t0), 0.0, 1.0);
+
+	vec4 R0, R1;
+	vec3 T0, T1;
+	unpackKey(t, t.First + Lo, R0, T0);
+	unpackKey(t, t.First + Lo + 1u, R1, T1);
+	Rotation = slerp(R0, R1, Factor);
+	Translation = mix(T0, T1, Factor);
+	return true;
+}
+
+// C = A * B, affine.
+void multiplyAffine(vec4 A[3], vec4 B[3], out vec4 C[3])
+{
+	for (int r = 0; r < 3; r++)
+	{
+		C[r] = A[r].x * B[0] + A[r].y * B[1] + A[r].z * B[2];
+		C[r].w += A[r].w;
+	}
+}
+
+void loadGlobal(int j, out vec4 Rows[3])
+{
+	for (int r = 0; r < 3; r++)
+		Rows[r] = sGlobal[j * 3 + r];
+}
+
+void storeGlobal(int j, vec4 Rows[3])
+{
+	for (int r = 0; r < 3; r++)
+		sGlobal[j * 3 + r] = Rows[r];
+}
+
+void main()
+{
+	int Slot = int(gl_WorkGroupID.x);
+	int First = int(gl_LocalInvocationIndex);
+	int Stride = int(gl_WorkGroupSize.x);
+	Instance Inst = gInstances[Slot];
+	bool Blended = Inst.Blend < 1.0;
+
+	// Local transformation of every joint, the roots placed in model space.
+	for (int j = First; j < NumJoints; j += Stride)
+	{
+		Joint J = gJoints[j];
+		vec4 R0, R1;
+		vec3 T0, T1;
+		bool Animated1 = sampleTrack(Inst.Clips[1], J.Index, Inst.Times[1],
+				R1, T1);
+		bool Animated0 = Blended && sampleTrack(Inst.Clips[0], J.Index,
+				Inst.Times[0], R0, T0);
+
+		vec4 Local[3] = J.Local;
+		if (Animated0 || Animated1)
+		{
+			// The clip that doesn't animate the joint blends its bind pose.
+			if (!Animated1)
+			{
+				R1 = J.BindRotation;
+				T1 = J.BindTranslation.xyz;
+			}
+			if (Blended)
+			{
+				if (!Animated0)
+				{
+					R0 = J.BindRotation;
+					T0 = J.BindTranslation.xyz;
+				}
+				// nlerp along the shortest arc, as PoseEvaluator::BlendPose
+				R1 = normalize(mix(R0, dot(R0, R1) < 0.0 ? -R1 : R1,
+						Inst.Blend));
+				T1 = mix(T0, T1, Inst.Blend);
+			}
+
+			vec4 q = R1;
+			Local[0] = vec4(1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+					2.0 * (q.x * q.y - q.w * q.z),
+					2.0 * (q.x * q.z + q.w * q.y), T1.x);
+			Local[1] = vec4(2.0 * (q.x * q.y + q.w * q.z),
+					1.0 - 2.0 * (q.x * q.x + q.z * q.z),
+					2.0 * (q.y * q.z - q.w * q.x), T1.y);
+			Local[2] = vec4(2.0 * (q.x * q.z - q.w * q.y),
+					2.0 * (q.y * q.z + q.w * q.x),
+					1.0 - 2.0 * (q.x * q.x + q.y * q.y), T1.z);
+		}
+
+		if (J.Parent < 0)
+		{
+			vec4 Global[3];
+			multiplyAffine(gGlobalInverse, Local, Global);
+			storeGlobal(j, Global);
+		}
+		else
+			storeGlobal(j, Local);
+	}
+	memoryBarrierShared();
+	barrier();
+
+	// The parents of a level are all in the levels above, already global.
+	for (int Level = 1; Level < NumLevels; Level++)
+	{
+		for (int j = LevelStart[Level] + First; j < LevelStart[Level + 1];
+				j += Stride)
+		{
+			vec4 Parent[3], Local[3], Global[3];
+			loadGlobal(gJoints[j].Parent, Parent);
+			loadGlobal(j, Local);
+			multiplyAffine(Parent, Local, Global);
+			storeGlobal(j, Global);
+		}
+		memoryBarrierShared();
+		barrier();
+	}
+
+	for (int j = First; j < NumJoints; j += Stride)
+	{
+		int Bone = gJoints[j].Bone;
+		if (Bone < 0)
+			continue;
+
+		vec4 Global[3], Final[3];
+		loadGlobal(j, Global);
+		multiplyAffine(Global, gJoints[j].Offset, Final);
+		gBones[Slot * NumBones + Bone] = transpose(mat4(Final[0], Final[1],
+				Final[2], vec4(0.0, 0.0, 0.0, 1.0)));
+	}
+}
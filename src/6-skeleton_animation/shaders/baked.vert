@@ -0,0 +1,121 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Stream of vertex positions
+layout (location = 1) in vec3 VertexNormal; // Stream of vertex normals
+
+// Bone influences of the vertex, NUM_BONE_INFLUENCES of them. The IDs and
+// weights 4 to 7 come from locations 4 and 5.
+#ifndef NUM_BONE_INFLUENCES
+#define NUM_BONE_INFLUENCES 4
+#endif
+
+layout (location=2) in uvec4 BoneIDs; // Stream of vertex bone IDs
+layout (location=3) in vec4 Weights; // Stream of vertex weights
+#if NUM_BONE_INFLUENCES > 4
+layout (location=4) in uvec4 BoneIDs1; // Stream of vertex bone IDs 4 to 7
+layout (location=5) in vec4 Weights1; // Stream of vertex weights 4 to 7
+#endif
+
+// Per instance: slot of the visible list, which also places its palette.
+layout (location=6) in uint InstanceSlot;
+
+layout (location=0) out vec3 vertPos; // Vertex position in eye coords
+layout (location=1) out vec3 N; // Transformed normal
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+uniform mat3 NormalMatrix; // Normal matrix
+uniform mat4 M; // Model matrix
+uniform mat4 V; // View matrix
+uniform mat4 P; // Projection matrix
+
+// Baked animation: one row per frame, three texels per bone holding the
+// first three rows of the bone transformation.
+uniform sampler2D AnimationTexture;
+uniform int NumFrames; // Texture height
+uniform float Duration; // Length of the loop in seconds
+uniform float Time; // Seconds since the start
+
+// Time offset and speed of every instance.
+layout (std430, binding = 4) readonly buffer InstancePlayback
+{
+	vec2 gPlayback[];
+};
+
+// Crowd index of every visible instance, one draw instance each.
+layout (std430, binding = 5) readonly buffer VisibleInstances
+{
+	uint gVisible[];
+};
+
+uniform int CrowdColumns; // Instances per row of the crowd
+uniform float CrowdSpacing; // Distance between two instances
+
+// ID and weight of the i-th strongest bone.
+int boneID(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return int(i < 4 ? BoneIDs[i & 3] : BoneIDs1[i & 3]);
+#else
+	return int(BoneIDs[i]);
+#endif
+}
+
+float boneWeight(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return i < 4 ? Weights[i & 3] : Weights1[i & 3];
+#else
+	return Weights[i];
+#endif
+}
+
+void main()
+{
+	// Frames around the time of this instance, the animation loops.
+	int Instance = int(gVisible[InstanceSlot]);
+	vec2 Playback = gPlayback[Instance];
+	float Frame = fract((Time * Playback.y + Playback.x) / Duration) *
+			float(NumFrames);
+	int Frame0 = min(int(Frame), NumFrames - 1);
+	int Frame1 = (Frame0 + 1) % NumFrames;
+	float Factor = Frame - float(Frame0);
+
+	// Blend the rows of the bone transformations, interpolated between
+	// the two frames.
+	vec4 Rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+	for (int i = 0; i < NUM_BONE_INFLUENCES; i++)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			int Texel = boneID(i) * 3 + r;
+			vec4 Row0 = texelFetch(AnimationTexture, ivec2(Texel, Frame0), 0);
+			vec4 Row1 = texelFetch(AnimationTexture, ivec2(Texel, Frame1), 0);
+			Rows[r] += mix(Row0, Row1, Factor) * boneWeight(i);
+		}
+	}
+
+	// Transformed vertex position
+	vec4 Position = vec4(VertexPosition, 1.0);
+	vec4 tPos = vec4(dot(Rows[0], Position), dot(Rows[1], Position),
+			dot(Rows[2], Position), 1.0);
+
+	// Place the instance on the crowd grid
+	tPos.xz += vec2(Instance % CrowdColumns - CrowdColumns / 2,
+			-(Instance / CrowdColumns)) * CrowdSpacing;
+
+	gl_Position = (P * V * M) * tPos;
+
+	// Transformed normal
+	vec3 tNormal = vec3(dot(Rows[0].xyz, VertexNormal),
+			dot(Rows[1].xyz, VertexNormal), dot(Rows[2].xyz, VertexNormal));
+
+	N = normalize(NormalMatrix * tNormal);
+
+	vec4 worldPos = M * tPos;
+
+	vertPos = worldPos.xyz;
+}
@@ -1,7 +1,7 @@
 #version 430
 
-in vec3 vertPos;
-in vec3 N;
+layout( location = 0 ) in vec3 vertPos;
+layout( location = 1 ) in vec3 N;
 
 uniform vec3 lightPos;
 uniform vec3 lightIntensity;
@@ -3,32 +3,102 @@
 layout (location = 0) in vec3 VertexPosition; // Stream of vertex positions 
 layout (location = 1) in vec3 VertexNormal; // Stream of vertex normals 
 
-layout (location=2) in ivec4 BoneIDs; // Stream of vertex bone IDs
+// Bone influences of the vertex, strongest first: NUM_BONE_INFLUENCES are
+// stored, the first NUM_BLENDED_INFLUENCES are blended. The IDs and weights
+// 4 to 7 come from locations 4 and 5.
+#ifndef NUM_BONE_INFLUENCES
+#define NUM_BONE_INFLUENCES 4
+#endif
+#ifndef NUM_BLENDED_INFLUENCES
+#define NUM_BLENDED_INFLUENCES NUM_BONE_INFLUENCES
+#endif
+
+layout (location=2) in uvec4 BoneIDs; // Stream of vertex bone IDs
 layout (location=3) in vec4 Weights; // Stream of vertex weights
+#if NUM_BONE_INFLUENCES > 4
+layout (location=4) in uvec4 BoneIDs1; // Stream of vertex bone IDs 4 to 7
+layout (location=5) in vec4 Weights1; // Stream of vertex weights 4 to 7
+#endif
+
+// Per instance: slot of the visible list, which also places its palette.
+layout (location=6) in uint InstanceSlot;
 
-out vec3 vertPos; // Vertex position in eye coords
-out vec3 N; // Transformed normal
+layout (location=0) out vec3 vertPos; // Vertex position in eye coords
+layout (location=1) out vec3 N; // Transformed normal
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
 
 uniform mat3 NormalMatrix; // Normal matrix 
 uniform mat4 M; // Model matrix 
 uniform mat4 V; // View matrix 
 uniform mat4 P; // Projection matrix 
 
-const int MAX_BONES = 70; // Max number of bones
-uniform mat4 gBones[MAX_BONES]; // Bone transformations 
+// Bone transformations of the visible instances, NumBones per instance, in
+// the order of the list below. Written row major by the CPU.
+layout (std430, binding = 0, row_major) readonly buffer BonePalettes
+{
+	mat4 gBones[];
+};
+uniform int NumBones; // Bones per instance
+
+// Crowd index of every visible instance, one draw instance each.
+layout (std430, binding = 5) readonly buffer VisibleInstances
+{
+	uint gVisible[];
+};
+
+uniform int CrowdColumns; // Instances per row of the crowd
+uniform float CrowdSpacing; // Distance between two instances
+
+// ID and weight of the i-th strongest bone.
+int boneID(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return int(i < 4 ? BoneIDs[i & 3] : BoneIDs1[i & 3]);
+#else
+	return int(BoneIDs[i]);
+#endif
+}
+
+float boneWeight(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return i < 4 ? Weights[i & 3] : Weights1[i & 3];
+#else
+	return Weights[i];
+#endif
+}
 
 void main()
 {
 	// Multiply each bone transformation by the particular weight
 	// and combine them. 
-   	mat4 BoneTransform = gBones[ BoneIDs[0] ] * Weights[0];
-	BoneTransform += gBones[ BoneIDs[1] ] * Weights[1];
-    BoneTransform += gBones[ BoneIDs[2] ] * Weights[2];
-    BoneTransform += gBones[ BoneIDs[3] ] * Weights[3];
+	int Slot = int(InstanceSlot);
+	int Palette = Slot * NumBones;
+	mat4 BoneTransform = mat4(0.0);
+	float WeightSum = 0.0;
+	for (int i = 0; i < NUM_BLENDED_INFLUENCES; i++)
+	{
+		float Weight = boneWeight(i);
+		BoneTransform += gBones[ Palette + boneID(i) ] * Weight;
+		WeightSum += Weight;
+	}
+#if NUM_BLENDED_INFLUENCES < NUM_BONE_INFLUENCES
+	// The weight of the bones left out goes to the others.
+	BoneTransform /= WeightSum;
+#endif
 
 	// Transformed vertex position 
 	vec4 tPos = BoneTransform * vec4(VertexPosition, 1.0);
 
+	// Place the instance on the crowd grid
+	int Instance = int(gVisible[Slot]);
+	tPos.xz += vec2(Instance % CrowdColumns - CrowdColumns / 2,
+			-(Instance / CrowdColumns)) * CrowdSpacing;
+
 	gl_Position = (P * V * M) * tPos;
 
 	// Transformed normal 
@@ -0,0 +1,122 @@
+#version 430
+
+layout (location = 0) in vec3 VertexPosition; // Stream of vertex positions
+layout (location = 1) in vec3 VertexNormal; // Stream of vertex normals
+
+// Bone influences of the vertex, NUM_BONE_INFLUENCES of them. The IDs and
+// weights 4 to 7 come from locations 4 and 5.
+#ifndef NUM_BONE_INFLUENCES
+#define NUM_BONE_INFLUENCES 4
+#endif
+
+layout (location=2) in uvec4 BoneIDs; // Stream of vertex bone IDs
+layout (location=3) in vec4 Weights; // Stream of vertex weights
+#if NUM_BONE_INFLUENCES > 4
+layout (location=4) in uvec4 BoneIDs1; // Stream of vertex bone IDs 4 to 7
+layout (location=5) in vec4 Weights1; // Stream of vertex weights 4 to 7
+#endif
+
+// Per instance: slot of the visible list, which also places its palette.
+layout (location=6) in uint InstanceSlot;
+
+layout (location=0) out vec3 vertPos; // Vertex position in eye coords
+layout (location=1) out vec3 N; // Transformed normal
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+uniform mat3 NormalMatrix; // Normal matrix
+uniform mat4 M; // Model matrix
+uniform mat4 V; // View matrix
+uniform mat4 P; // Projection matrix
+
+// Bone transformations of the visible instances as dual quaternions, in the
+// order of the list below, NumBones per instance: the real part (rotation)
+// followed by the dual part (translation), xyz vector and w scalar.
+layout (std430, binding = 0) readonly buffer BoneDualQuaternions
+{
+	vec4 gDualQuats[];
+};
+uniform int NumBones; // Bones per instance
+
+// Crowd index of every visible instance, one draw instance each.
+layout (std430, binding = 5) readonly buffer VisibleInstances
+{
+	uint gVisible[];
+};
+
+uniform int CrowdColumns; // Instances per row of the crowd
+uniform float CrowdSpacing; // Distance between two instances
+
+// ID and weight of the i-th strongest bone.
+int boneID(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return int(i < 4 ? BoneIDs[i & 3] : BoneIDs1[i & 3]);
+#else
+	return int(BoneIDs[i]);
+#endif
+}
+
+float boneWeight(int i)
+{
+#if NUM_BONE_INFLUENCES > 4
+	return i < 4 ? Weights[i & 3] : Weights1[i & 3];
+#else
+	return Weights[i];
+#endif
+}
+
+// Rotates v by the unit quaternion q.
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	int Palette = int(InstanceSlot) * NumBones;
+
+	// Blend the dual quaternions of the bones. q and -q are the same
+	// rotation, the ones in the other hemisphere of the first bone are
+	// flipped so that the blend doesn't go the long way around.
+	vec4 Real0 = gDualQuats[2 * (Palette + boneID(0))];
+	vec4 Real = Real0 * boneWeight(0);
+	vec4 Dual = gDualQuats[2 * (Palette + boneID(0)) + 1] * boneWeight(0);
+	for (int i = 1; i < NUM_BONE_INFLUENCES; i++)
+	{
+		int Bone = 2 * (Palette + boneID(i));
+		vec4 r = gDualQuats[Bone];
+		float w = dot(Real0, r) < 0.0 ? -boneWeight(i) : boneWeight(i);
+		Real += r * w;
+		Dual += gDualQuats[Bone + 1] * w;
+	}
+
+	// Back to a unit dual quaternion: a rigid transformation, no volume
+	// loss at the joints.
+	float Length = length(Real);
+	Real /= Length;
+	Dual /= Length;
+
+	vec3 Translation = 2.0 * (Real.w * Dual.xyz - Dual.w * Real.xyz +
+			cross(Real.xyz, Dual.xyz));
+
+	// Transformed vertex position
+	vec4 tPos = vec4(rotate(Real, VertexPosition) + Translation, 1.0);
+
+	// Place the instance on the crowd grid
+	int Instance = int(gVisible[InstanceSlot]);
+	tPos.xz += vec2(Instance % CrowdColumns - CrowdColumns / 2,
+			-(Instance / CrowdColumns)) * CrowdSpacing;
+
+	gl_Position = (P * V * M) * tPos;
+
+	// Transformed normal
+	N = normalize(NormalMatrix * rotate(Real, VertexNormal));
+
+	vec4 worldPos = M * tPos;
+
+	vertPos = worldPos.xyz;
+}
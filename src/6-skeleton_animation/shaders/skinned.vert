@@ -0,0 +1,31 @@
+#version 430
+
+// Draws the vertices skinned by skinning.cs, no bone work left to do.
+layout (location = 0) in vec3 VertexPosition; // Skinned model space position
+layout (location = 1) in vec3 VertexNormal; // Skinned model space normal
+
+layout (location=0) out vec3 vertPos; // Vertex position in eye coords
+layout (location=1) out vec3 N; // Transformed normal
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+uniform mat3 NormalMatrix; // Normal matrix
+uniform mat4 M; // Model matrix
+uniform mat4 V; // View matrix
+uniform mat4 P; // Projection matrix
+
+void main()
+{
+	vec4 tPos = vec4(VertexPosition, 1.0);
+
+	gl_Position = (P * V * M) * tPos;
+
+	N = normalize(NormalMatrix * VertexNormal);
+
+	vec4 worldPos = M * tPos;
+
+	vertPos = worldPos.xyz;
+}
@@ -0,0 +1,126 @@
+#version 430
+
+// Skins every vertex of every instance once, the result is drawn as a static
+// mesh by all the passes of the frame.
+layout (local_size_x = 64) in;
+
+struct Vertex
+{
+	float Position[3];
+	float Normal[3];
+	float UV[2];
+};
+
+struct SkinnedVertex
+{
+	vec3 Position; // Model space position, placed on the crowd grid
+	uint Normal; // Model space normal, packed snorm 4x8
+};
+
+// Bone transformations of the visible instances, NumBones per instance, in
+// the order of the list below.
+layout (std430, binding = 0, row_major) readonly buffer BonePalettes
+{
+	mat4 gBones[];
+};
+
+layout (std430, binding = 1) readonly buffer Vertices
+{
+	Vertex vertices[];
+};
+
+// Bone influences of every vertex as packed by BoneInfluenceFormat: the IDs,
+// 8 or 16 bits each, then the unsigned normalized weights, 8 or 16 bits each,
+// both blocks padded to whole words.
+#ifndef NUM_BONE_INFLUENCES
+#define NUM_BONE_INFLUENCES 4
+#endif
+#ifndef WIDE_BONE_IDS
+#define WIDE_BONE_IDS 0
+#endif
+#ifndef WIDE_BONE_WEIGHTS
+#define WIDE_BONE_WEIGHTS 0
+#endif
+
+#if WIDE_BONE_IDS
+#define BONE_ID_BITS 16
+#else
+#define BONE_ID_BITS 8
+#endif
+#if WIDE_BONE_WEIGHTS
+#define BONE_WEIGHT_BITS 16
+#else
+#define BONE_WEIGHT_BITS 8
+#endif
+#define BONE_ID_WORDS ((NUM_BONE_INFLUENCES * BONE_ID_BITS + 31) / 32)
+#define BONE_WEIGHT_WORDS ((NUM_BONE_INFLUENCES * BONE_WEIGHT_BITS + 31) / 32)
+
+layout (std430, binding = 2) readonly buffer Bones
+{
+	uint bones[];
+};
+
+layout (std430, binding = 3) writeonly buffer SkinnedVertices
+{
+	SkinnedVertex skinned[];
+};
+
+// Crowd index of every visible instance.
+layout (std430, binding = 5) readonly buffer VisibleInstances
+{
+	uint gVisible[];
+};
+
+uniform int NumVertices; // Vertices per instance
+uniform int NumBones; // Bones per instance
+
+uniform int CrowdColumns; // Instances per row of the crowd
+uniform float CrowdSpacing; // Distance between two instances
+
+// The i-th field of Bits bits of the words starting at Base, the first field
+// in the low bits.
+uint unpackField(int Base, int i, int Bits)
+{
+	int PerWord = 32 / Bits;
+	return bitfieldExtract(bones[Base + i / PerWord], (i % PerWord) * Bits,
+			Bits);
+}
+
+void main()
+{
+	int VertexID = int(gl_GlobalInvocationID.x);
+	if (VertexID >= NumVertices)
+		return;
+
+	// One row of work groups per visible instance
+	int Slot = int(gl_WorkGroupID.y);
+	int Instance = int(gVisible[Slot]);
+	int Palette = Slot * NumBones;
+
+	Vertex v = vertices[VertexID];
+
+	int IDs = VertexID * (BONE_ID_WORDS + BONE_WEIGHT_WORDS);
+	int Weights = IDs + BONE_ID_WORDS;
+	mat4 BoneTransform = mat4(0.0);
+	for (int i = 0; i < NUM_BONE_INFLUENCES; i++)
+	{
+		int ID = int(unpackField(IDs, i, BONE_ID_BITS));
+		float Weight = float(unpackField(Weights, i, BONE_WEIGHT_BITS)) /
+				float((1 << BONE_WEIGHT_BITS) - 1);
+		BoneTransform += gBones[ Palette + ID ] * Weight;
+	}
+
+	vec4 tPos = BoneTransform *
+			vec4(v.Position[0], v.Position[1], v.Position[2], 1.0);
+	vec3 tNormal = (BoneTransform *
+			vec4(v.Normal[0], v.Normal[1], v.Normal[2], 0.0)).xyz;
+
+	// Place the instance on the crowd grid
+	tPos.xz += vec2(Instance % CrowdColumns - CrowdColumns / 2,
+			-(Instance / CrowdColumns)) * CrowdSpacing;
+
+	SkinnedVertex Out;
+	Out.Position = tPos.xyz;
+	Out.Normal = packSnorm4x8(vec4(normalize(tNormal), 0.0));
+	skinned[Slot * NumVertices + VertexID] = Out;
+}
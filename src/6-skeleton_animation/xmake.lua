@@ -1,6 +1,72 @@
+option("avx")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Use AVX for the skeleton poses and the Matrix4f products")
+option_end()
+
+option("track_allocations")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count the heap allocations of every frame")
+    add_defines("TRACK_ALLOCATIONS")
+option_end()
+
 target("skeleton_animation")
     set_kind("binary")
     add_files("*.cpp")
     add_includedirs(".")
     add_packages("glfw", "glad", "glm", "stb", "assimp")
+    add_options("track_allocations")
     add_defines("PROJECT_DIR=\"$(projectdir)\"")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+    if is_arch("x86_64", "x64", "i386", "x86") then
+        add_vectorexts(has_config("avx") and "avx" or "sse2")
+    end
+
+target("math3d_bench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/math3d_bench.cpp", "Math3D.cpp")
+    add_includedirs(".")
+    add_packages("assimp")
+    if is_arch("x86_64", "x64", "i386", "x86") then
+        add_vectorexts(has_config("avx") and "avx" or "sse2")
+    end
+
+-- No window and no GL context: the GL functions are linked, never called.
+target("animation_bench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/animation_bench.cpp", "AllocationTracker.cpp",
+              "AnimationClip.cpp", "AnimationCrowd.cpp",
+              "AnimationLibrary.cpp", "CompressedClip.cpp", "JobSystem.cpp",
+              "Math3D.cpp", "PoseCache.cpp", "PoseEvaluator.cpp",
+              "SkeletalModel.cpp")
+    add_includedirs(".")
+    add_packages("glad", "glm", "assimp")
+    add_defines("PROJECT_DIR=\"$(projectdir)\"", "TRACK_ALLOCATIONS")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+    if is_arch("x86_64", "x64", "i386", "x86") then
+        add_vectorexts(has_config("avx") and "avx" or "sse2")
+    end
+
+target("skinning_bench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/skinning_bench.cpp", "AllocationTracker.cpp",
+              "AnimationClip.cpp", "AnimationLibrary.cpp",
+              "CompressedClip.cpp", "CpuSkinning.cpp", "JobSystem.cpp",
+              "Math3D.cpp", "PoseEvaluator.cpp", "SkeletalModel.cpp")
+    add_includedirs(".")
+    add_packages("glad", "glm", "assimp")
+    add_defines("PROJECT_DIR=\"$(projectdir)\"")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+    if is_arch("x86_64", "x64", "i386", "x86") then
+        add_vectorexts(has_config("avx") and "avx" or "sse2")
+    end
@@ -0,0 +1,66 @@
+// Lights and material of lighting.fs, shared by the shader and main.cpp: the
+// same text is a GLSL uniform block and the C++ struct uploaded into it.
+//
+// The layout is std140. Every vec3 is followed by a float so that the C++
+// members land on the offsets std140 gives them, and every struct is aligned
+// to 16 bytes as std140 structs are. main.cpp checks the offsets against the
+// ones the driver reports before the first frame.
+#ifndef LIGHTS_GLSL
+#define LIGHTS_GLSL
+
+#ifdef __cplusplus
+#include <glm/glm.hpp>
+
+namespace lights {
+using glm::vec3;
+
+#define STD140_STRUCT struct alignas(16)
+#define UNIFORM_BLOCK(name) STD140_STRUCT name
+#else
+#define STD140_STRUCT struct
+#define UNIFORM_BLOCK(name) layout(std140) uniform name
+#endif
+
+#define MAX_POINT_LIGHTS 16
+
+STD140_STRUCT PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+STD140_STRUCT SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+STD140_STRUCT Material {
+    float shininess;
+};
+
+// one write per frame, only the first numPointLights lights are read
+UNIFORM_BLOCK(Lights) {
+    vec3 viewPos;
+    int numPointLights;
+    Material material;
+    SpotLight spotLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+#ifdef __cplusplus
+} // namespace lights
+#endif
+
+#endif
@@ -3,23 +3,34 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "learnopengl/camera.h"
+#include "learnopengl/gl_state.h"
 #include "learnopengl/model.h"
 #include "learnopengl/shader.h"
 
+#include "lights.glsl"
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action,
                   int mods);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+std::string insertAfterVersion(const char *source, const char *header);
+bool checkLightsLayout(unsigned int program);
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// uniform buffer binding point of the Lights block
+const unsigned int LIGHTS_BINDING = 0;
+
 const char v_lighting[] = {
 #include "lighting.vs.h"
 };
@@ -28,6 +39,10 @@ const char f_lighting[] = {
 #include "lighting.fs.h"
 };
 
+const char h_lights[] = {
+#include "lights.glsl.h"
+};
+
 const char v_cube[] = {
 #include "cube.vs.h"
 };
@@ -76,9 +91,10 @@ int main() {
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
-  Shader lightingShader(v_lighting, f_lighting);
+  Shader lightingShader(v_lighting,
+                        insertAfterVersion(f_lighting, h_lights).c_str());
   Shader cubeShader(v_cube, f_cube);
 
   Model ourModel(PROJECT_ROOT_DIR "resources/cyborg/cyborg.obj");
@@ -110,11 +126,49 @@ int main() {
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   glGenVertexArrays(1, &lightCubeVAO);
-  glBindVertexArray(lightCubeVAO);
+  glState().bindVertexArray(lightCubeVAO);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
-  glBindVertexArray(0);
+  glState().bindVertexArray(0);
+
+  // the whole Lights block goes in one uniform buffer, rewritten every frame
+  if (!checkLightsLayout(lightingShader.ID)) {
+    glfwTerminate();
+    return -1;
+  }
+  glUniformBlockBinding(lightingShader.ID,
+                        glGetUniformBlockIndex(lightingShader.ID, "Lights"),
+                        LIGHTS_BINDING);
+  unsigned int lightsUBO;
+  glGenBuffers(1, &lightsUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(lights::Lights), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BINDING, lightsUBO);
+
+  lights::Lights lightsBlock = {};
+  // the block holds MAX_POINT_LIGHTS lights, any past those are not lit
+  lightsBlock.numPointLights =
+      (int)std::min(pointLightPositions.size(), (size_t)MAX_POINT_LIGHTS);
+  lightsBlock.material.shininess = 32.0f;
+  for (int i = 0; i < lightsBlock.numPointLights; i++) {
+    lights::PointLight &light = lightsBlock.pointLights[i];
+    light.position = pointLightPositions[i];
+    light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+    light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+    light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    light.constant = 1.0f;
+    light.linear = 0.09f;
+    light.quadratic = 0.032f;
+  }
+  lights::SpotLight &spot = lightsBlock.spotLight;
+  spot.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+  spot.constant = 1.0f;
+  spot.linear = 0.09f;
+  spot.quadratic = 0.032f;
+  spot.cutOff = glm::cos(glm::radians(12.5f));
+  spot.outerCutOff = glm::cos(glm::radians(15.0f));
 
   // render loop
   while (!glfwWindowShouldClose(window)) {
@@ -129,42 +183,27 @@ int main() {
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    lightingShader.use();
-    lightingShader.setVec3("viewPos", camera.Position);
-    lightingShader.setFloat("material.shininess", 32.0f);
-
     // point light 1
     float light_mov_x = pointLightPositions[0].x + sin(glfwGetTime()) * 1.5;
     float light_mov_z = pointLightPositions[0].z + cos(glfwGetTime()) * 1.5;
-    lightingShader.setVec3("pointLights[0].position", light_mov_x,
-                           pointLightPositions[0].y, light_mov_z);
-    lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[0].constant", 1.0f);
-    lightingShader.setFloat("pointLights[0].linear", 0.09f);
-    lightingShader.setFloat("pointLights[0].quadratic", 0.032f);
-    // point light 2
-    lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-    lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[1].constant", 1.0f);
-    lightingShader.setFloat("pointLights[1].linear", 0.09f);
-    lightingShader.setFloat("pointLights[1].quadratic", 0.032f);
+    lightsBlock.pointLights[0].position =
+        glm::vec3(light_mov_x, pointLightPositions[0].y, light_mov_z);
 
     // spotLight
-    lightingShader.setVec3("spotLight.position", camera.Position);
-    lightingShader.setVec3("spotLight.direction", camera.Front);
-    lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-    lightingShader.setVec3("spotLight.diffuse", spotLight);
-    lightingShader.setVec3("spotLight.specular", spotLight);
-    lightingShader.setFloat("spotLight.constant", 1.0f);
-    lightingShader.setFloat("spotLight.linear", 0.09f);
-    lightingShader.setFloat("spotLight.quadratic", 0.032f);
-    lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-    lightingShader.setFloat("spotLight.outerCutOff",
-                            glm::cos(glm::radians(15.0f)));
+    spot.position = camera.Position;
+    spot.direction = camera.Front;
+    spot.diffuse = spotLight;
+    spot.specular = spotLight;
+
+    lightsBlock.viewPos = camera.Position;
+    // only the lights in use are uploaded
+    glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0,
+                    offsetof(lights::Lights, pointLights) +
+                        lightsBlock.numPointLights * sizeof(lights::PointLight),
+                    &lightsBlock);
+
+    lightingShader.use();
 
     // configure view/projection matrices
     glm::mat4 projection =
@@ -181,7 +220,7 @@ int main() {
     cubeShader.use();
     cubeShader.setMat4("projection", projection);
     cubeShader.setMat4("view", view);
-    glBindVertexArray(lightCubeVAO);
+    glState().bindVertexArray(lightCubeVAO);
     for (unsigned int i = 0; i < pointLightPositions.size(); i++) {
       model = glm::mat4(1.0f);
 
@@ -196,7 +235,6 @@ int main() {
       cubeShader.setMat4("model", model);
       glDrawArrays(GL_TRIANGLES, 0, 36);
     }
-    glBindVertexArray(0);
 
     glfwSwapBuffers(window);
     glfwPollEvents();
@@ -224,6 +262,91 @@ void key_callback(GLFWwindow *window, int key, int, int action, int) {
     glfwSetWindowShouldClose(window, true);
 }
 
+// GLSL has no #include: the header is spliced in right after the #version
+// line of the shader
+std::string insertAfterVersion(const char *source, const char *header) {
+  std::string code(source);
+  size_t line = code.find('\n') + 1;
+  return code.substr(0, line) + header + "\n" + code.substr(line);
+}
+
+// compares the offsets the C++ structs of lights.glsl give to the members of
+// the Lights block with the ones the driver assigned to them
+bool checkLightsLayout(unsigned int program) {
+  struct Member {
+    std::string name;
+    size_t offset;
+  };
+#define LIGHTS_MEMBER(prefix, base, type, field)                               \
+  Member { std::string(prefix) + #field, base + offsetof(type, field) }
+
+  size_t material = offsetof(lights::Lights, material);
+  size_t spot = offsetof(lights::Lights, spotLight);
+  std::vector<Member> members = {
+      LIGHTS_MEMBER("", 0, lights::Lights, viewPos),
+      LIGHTS_MEMBER("", 0, lights::Lights, numPointLights),
+      LIGHTS_MEMBER("material.", material, lights::Material, shininess),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, position),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, constant),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, direction),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, linear),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, ambient),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, quadratic),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, diffuse),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, cutOff),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, specular),
+      LIGHTS_MEMBER("spotLight.", spot, lights::SpotLight, outerCutOff)};
+
+  // the first two lights are enough to check the array stride as well
+  for (int i = 0; i < 2; i++) {
+    std::string light = "pointLights[" + std::to_string(i) + "].";
+    size_t base = offsetof(lights::Lights, pointLights) +
+                  i * sizeof(lights::PointLight);
+    members.insert(
+        members.end(),
+        {LIGHTS_MEMBER(light, base, lights::PointLight, position),
+         LIGHTS_MEMBER(light, base, lights::PointLight, constant),
+         LIGHTS_MEMBER(light, base, lights::PointLight, ambient),
+         LIGHTS_MEMBER(light, base, lights::PointLight, linear),
+         LIGHTS_MEMBER(light, base, lights::PointLight, diffuse),
+         LIGHTS_MEMBER(light, base, lights::PointLight, quadratic),
+         LIGHTS_MEMBER(light, base, lights::PointLight, specular)});
+  }
+#undef LIGHTS_MEMBER
+
+  bool valid = true;
+  GLuint block = glGetUniformBlockIndex(program, "Lights");
+  if (block == GL_INVALID_INDEX) {
+    std::cout << "ERROR::LIGHTS_LAYOUT: no Lights block in the program"
+              << std::endl;
+    return false;
+  }
+  GLint blockSize;
+  glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE,
+                            &blockSize);
+  if ((size_t)blockSize != sizeof(lights::Lights)) {
+    std::cout << "ERROR::LIGHTS_LAYOUT: the Lights block is " << blockSize
+              << " bytes, the struct " << sizeof(lights::Lights) << std::endl;
+    valid = false;
+  }
+
+  for (const Member &member : members) {
+    const char *name = member.name.c_str();
+    GLuint index;
+    glGetUniformIndices(program, 1, &name, &index);
+    GLint offset = -1;
+    if (index != GL_INVALID_INDEX)
+      glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+    if (offset < 0 || (size_t)offset != member.offset) {
+      std::cout << "ERROR::LIGHTS_LAYOUT: " << member.name << " is at offset "
+                << offset << " in the block, " << member.offset
+                << " in the struct" << std::endl;
+      valid = false;
+    }
+  }
+  return valid;
+}
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
   glViewport(0, 0, width, height);
 }
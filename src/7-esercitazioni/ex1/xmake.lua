@@ -1,6 +1,6 @@
 target("7-es1")
     set_kind("binary")
-    add_rules("utils.bin2c", {extensions = {".fs", ".vs"}})
-    add_files("*.vs", "*.fs")
+    add_rules("utils.bin2c", {extensions = {".fs", ".vs", ".glsl"}})
+    add_files("*.vs", "*.fs", "*.glsl")
     add_files("main.cpp")
     add_packages("glfw", "glad", "stb", "glm", "assimp")
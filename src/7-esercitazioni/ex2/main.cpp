@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/model.h"
 #include "learnopengl/shader.h"
 
@@ -80,7 +81,7 @@ int main() {
     return -1;
   }
 
-  glEnable(GL_DEPTH_TEST);
+  glState().setDepthTest(true);
 
   // compile shaders
   Shader shaderGeometryPass(v_geometry, f_geometry);
@@ -95,11 +96,11 @@ int main() {
   // geometry framebuffer
   unsigned int gBuffer;
   glGenFramebuffers(1, &gBuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+  glState().bindFramebuffer(gBuffer);
   unsigned int gPosition, gNormal, gAlbedo;
   // position color buffer
   glGenTextures(1, &gPosition);
-  glBindTexture(GL_TEXTURE_2D, gPosition);
+  glState().bindTexture(GL_TEXTURE_2D, gPosition);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA,
                GL_FLOAT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -110,7 +111,7 @@ int main() {
                          gPosition, 0);
   // normal color buffer
   glGenTextures(1, &gNormal);
-  glBindTexture(GL_TEXTURE_2D, gNormal);
+  glState().bindTexture(GL_TEXTURE_2D, gNormal);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA,
                GL_FLOAT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -119,7 +120,7 @@ int main() {
                          gNormal, 0);
   // color + specular color buffer
   glGenTextures(1, &gAlbedo);
-  glBindTexture(GL_TEXTURE_2D, gAlbedo);
+  glState().bindTexture(GL_TEXTURE_2D, gAlbedo);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA,
                GL_UNSIGNED_BYTE, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -137,16 +138,16 @@ int main() {
                         SCR_HEIGHT);
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
                             GL_RENDERBUFFER, rboDepth);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glState().bindFramebuffer(0);
 
   // ssao framebuffers
   unsigned int ssaoFBO, ssaoBlurFBO;
   glGenFramebuffers(1, &ssaoFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+  glState().bindFramebuffer(ssaoFBO);
   unsigned int ssaoColorBuffer, ssaoColorBufferBlur;
   // SSAO color buffer
   glGenTextures(1, &ssaoColorBuffer);
-  glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+  glState().bindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED,
                GL_FLOAT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -155,16 +156,16 @@ int main() {
                          ssaoColorBuffer, 0);
   // SSAO blur buffer
   glGenFramebuffers(1, &ssaoBlurFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
+  glState().bindFramebuffer(ssaoBlurFBO);
   glGenTextures(1, &ssaoColorBufferBlur);
-  glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+  glState().bindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED,
                GL_FLOAT, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          ssaoColorBufferBlur, 0);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glState().bindFramebuffer(0);
 
   // generate sample kernel
   std::uniform_real_distribution<GLfloat> randomFloat(0.0, 1.0);
@@ -196,7 +197,7 @@ int main() {
   }
   unsigned int noiseTexture;
   glGenTextures(1, &noiseTexture);
-  glBindTexture(GL_TEXTURE_2D, noiseTexture);
+  glState().bindTexture(GL_TEXTURE_2D, noiseTexture);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 4, 4, 0, GL_RGB, GL_FLOAT,
                &ssaoNoise[0]);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -245,7 +246,7 @@ int main() {
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
     // 1. geometry pass
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glState().bindFramebuffer(gBuffer);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     shaderGeometryPass.use();
@@ -266,43 +267,33 @@ int main() {
     model = glm::scale(model, glm::vec3(1.0f));
     shaderGeometryPass.setMat4("model", model);
     backpack.Draw(shaderGeometryPass);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // 2. generate SSAO texture
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+    glState().bindFramebuffer(ssaoFBO);
     glClear(GL_COLOR_BUFFER_BIT);
 
     shaderSSAO.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, noiseTexture);
+    glState().bindTexture(0, GL_TEXTURE_2D, gPosition);
+    glState().bindTexture(1, GL_TEXTURE_2D, gNormal);
+    glState().bindTexture(2, GL_TEXTURE_2D, noiseTexture);
     if (enableSSAO)
       renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // 3. blur SSAO texture
-    glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
+    glState().bindFramebuffer(ssaoBlurFBO);
     glClear(GL_COLOR_BUFFER_BIT);
     shaderSSAOBlur.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+    glState().bindTexture(0, GL_TEXTURE_2D, ssaoColorBuffer);
     renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // 4. lighting pass
+    glState().bindFramebuffer(0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     shaderLightingPass.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, gAlbedo);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+    glState().bindTexture(0, GL_TEXTURE_2D, gPosition);
+    glState().bindTexture(1, GL_TEXTURE_2D, gNormal);
+    glState().bindTexture(2, GL_TEXTURE_2D, gAlbedo);
+    glState().bindTexture(3, GL_TEXTURE_2D, ssaoColorBufferBlur);
     renderQuad();
 
     // glfw: swap buffers
@@ -368,7 +359,7 @@ void renderCube() {
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     // set vertex attributes
-    glBindVertexArray(cubeVAO);
+    glState().bindVertexArray(cubeVAO);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)0);
@@ -379,12 +370,10 @@ void renderCube() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
                           (void *)(6 * sizeof(float)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
   }
   // render
-  glBindVertexArray(cubeVAO);
+  glState().bindVertexArray(cubeVAO);
   glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0);
 }
 
 unsigned int quadVAO = 0;
@@ -401,7 +390,7 @@ void renderQuad() {
     // setup plane VAO
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    glState().bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
                  GL_STATIC_DRAW);
@@ -412,9 +401,8 @@ void renderQuad() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
                           (void *)(3 * sizeof(float)));
   }
-  glBindVertexArray(quadVAO);
+  glState().bindVertexArray(quadVAO);
   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-  glBindVertexArray(0);
 }
 
 void key_callback(GLFWwindow *window, int key, int, int action, int) {
@@ -0,0 +1,141 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#define GL_STATE_MAX_TEXTURE_UNITS 32
+
+// Shadow copy of the GL state that gets rebound the most: current program,
+// active texture unit, textures bound to each unit, VAO, framebuffer and the
+// depth test switch. A call is forwarded to the driver only when it would
+// change something, the redundant ones are skipped and counted.
+//
+// The shadow copy is only correct as long as every change of this state goes
+// through the cache, deleting the bound objects included (GL unbinds them).
+// Code that still binds with raw GL calls has to call invalidate() before
+// going back to the cached functions.
+class GLStateCache {
+public:
+  unsigned int issuedCalls;  // calls forwarded to the driver
+  unsigned int skippedCalls; // redundant calls filtered out
+
+  GLStateCache() {
+    invalidate();
+    resetCounters();
+  }
+
+  // forget everything, the next call of each kind always reaches the driver
+  // ------------------------------------------------------------------------
+  void invalidate() {
+    program = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++) {
+      textureTargets[i] = UNKNOWN;
+      textures[i] = UNKNOWN;
+    }
+    vertexArray = UNKNOWN;
+    framebuffer = UNKNOWN;
+    depthTest = -1;
+  }
+  void resetCounters() {
+    issuedCalls = 0;
+    skippedCalls = 0;
+  }
+
+  // ------------------------------------------------------------------------
+  void useProgram(unsigned int id) {
+    if (changed(program, id))
+      glUseProgram(id);
+  }
+  // ------------------------------------------------------------------------
+  void activeTexture(unsigned int unit) {
+    if (changed(activeUnit, unit))
+      glActiveTexture(GL_TEXTURE0 + unit);
+  }
+  // binds on the currently active unit
+  void bindTexture(GLenum target, unsigned int id) {
+    unsigned int unit = activeUnit;
+    if (unit >= GL_STATE_MAX_TEXTURE_UNITS) {
+      // the active unit is unknown, nothing to compare against
+      glBindTexture(target, id);
+      issuedCalls++;
+      return;
+    }
+    if (textureTargets[unit] != target) {
+      textureTargets[unit] = target;
+      textures[unit] = UNKNOWN;
+    }
+    if (changed(textures[unit], id))
+      glBindTexture(target, id);
+  }
+  // activates the unit (if needed) and binds the texture on it
+  void bindTexture(unsigned int unit, GLenum target, unsigned int id) {
+    if (unit < GL_STATE_MAX_TEXTURE_UNITS && textureTargets[unit] == target &&
+        textures[unit] == id) {
+      skippedCalls++;
+      return;
+    }
+    activeTexture(unit);
+    bindTexture(target, id);
+  }
+  // ------------------------------------------------------------------------
+  void bindVertexArray(unsigned int id) {
+    if (changed(vertexArray, id))
+      glBindVertexArray(id);
+  }
+  // ------------------------------------------------------------------------
+  void bindFramebuffer(unsigned int id) {
+    if (changed(framebuffer, id))
+      glBindFramebuffer(GL_FRAMEBUFFER, id);
+  }
+  // ------------------------------------------------------------------------
+  void setDepthTest(bool enabled) {
+    if (changed(depthTest, enabled ? 1 : 0))
+      enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+  }
+  // GL falls back to 0 for the bindings of a deleted object, and the driver
+  // may hand out the same name again: the copy has to forget it as well
+  // ------------------------------------------------------------------------
+  void deleteTextures(GLsizei n, const unsigned int *ids) {
+    for (GLsizei i = 0; i < n; i++)
+      for (unsigned int unit = 0; unit < GL_STATE_MAX_TEXTURE_UNITS; unit++)
+        if (textures[unit] == ids[i])
+          textures[unit] = 0;
+    glDeleteTextures(n, ids);
+  }
+  void deleteVertexArrays(GLsizei n, const unsigned int *ids) {
+    for (GLsizei i = 0; i < n; i++)
+      if (vertexArray == ids[i])
+        vertexArray = 0;
+    glDeleteVertexArrays(n, ids);
+  }
+
+private:
+  static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+  unsigned int program;
+  unsigned int activeUnit;
+  GLenum textureTargets[GL_STATE_MAX_TEXTURE_UNITS];
+  unsigned int textures[GL_STATE_MAX_TEXTURE_UNITS];
+  unsigned int vertexArray;
+  unsigned int framebuffer;
+  int depthTest;
+
+  // stores the new value and tells whether the driver has to be called
+  template <typename T> bool changed(T &current, T value) {
+    if (current == value) {
+      skippedCalls++;
+      return false;
+    }
+    current = value;
+    issuedCalls++;
+    return true;
+  }
+};
+
+// the state cache of the (single) GL context used by the samples
+inline GLStateCache &glState() {
+  static GLStateCache state;
+  return state;
+}
+#endif
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "learnopengl/gl_state.h"
 #include "learnopengl/shader.h"
 
 #include <string>
@@ -65,8 +66,6 @@ public:
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++) {
-      glActiveTexture(GL_TEXTURE0 +
-                      i); // active proper texture unit before binding
       // retrieve texture number (the N in diffuse_textureN)
       string number;
       string name = textures[i].type;
@@ -81,19 +80,17 @@ public:
         number = std::to_string(heightNr++); // transfer unsigned int to string
 
       // now set the sampler to the correct texture unit
-      glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-      // and finally bind the texture
-      glBindTexture(GL_TEXTURE_2D, textures[i].id);
+      shader.setInt(name + number, i);
+      // and finally bind the texture on its unit, the state cache skips it if
+      // the previous mesh left the same texture there
+      glState().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
     }
 
-    // draw mesh
-    glBindVertexArray(VAO);
+    // draw mesh, the VAO stays bound: resetting it (and the active unit) after
+    // every mesh only costs driver calls now that bindings go through the cache
+    glState().bindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),
                    GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
   }
 
 private:
@@ -107,7 +104,7 @@ private:
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     // A great thing about structs is that their memory layout is sequential for
@@ -150,7 +147,7 @@ private:
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           (void *)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
   }
 };
 #endif
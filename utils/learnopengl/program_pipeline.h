@@ -0,0 +1,85 @@
+#ifndef PROGRAM_PIPELINE_H
+#define PROGRAM_PIPELINE_H
+
+#include <glad/glad.h>
+
+#include "learnopengl/gl_state.h"
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <utility>
+
+// Program pipeline objects keyed by the (vertex, fragment) program pair. Every
+// vertex and fragment variant is linked exactly once, the pipelines combining
+// them are created lazily on first use and reused afterwards. The programs
+// are linked separable, see GLSLProgram::setSeparable.
+//
+// Validation depends on the state the pipeline is drawn with (texture units,
+// buffers), so a pipeline is validated when it is first bound for a draw, and
+// only in debug builds.
+class ProgramPipelineCache {
+public:
+  ProgramPipelineCache() {}
+  ~ProgramPipelineCache() {
+    for (auto &entry : pipelines)
+      glDeleteProgramPipelines(1, &entry.second);
+  }
+
+  ProgramPipelineCache(const ProgramPipelineCache &) = delete;
+  ProgramPipelineCache &operator=(const ProgramPipelineCache &) = delete;
+
+  // returns the pipeline combining the two separable programs, creating it if
+  // this pair has never been requested before
+  // ------------------------------------------------------------------------
+  unsigned int get(unsigned int vertexProgram, unsigned int fragmentProgram) {
+    std::pair<unsigned int, unsigned int> key(vertexProgram, fragmentProgram);
+    auto pos = pipelines.find(key);
+    if (pos != pipelines.end())
+      return pos->second;
+
+    unsigned int pipeline;
+    glGenProgramPipelines(1, &pipeline);
+    glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT, vertexProgram);
+    glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, fragmentProgram);
+
+    pipelines[key] = pipeline;
+    return pipeline;
+  }
+
+  // binds the pipeline for the pair, a program bound with glUseProgram would
+  // take precedence so it is cleared first. Call it once the state of the draw
+  // is set, the first bind of a pipeline validates it against that state
+  // ------------------------------------------------------------------------
+  void bind(unsigned int vertexProgram, unsigned int fragmentProgram) {
+    unsigned int pipeline = get(vertexProgram, fragmentProgram);
+    glState().useProgram(0);
+    glBindProgramPipeline(pipeline);
+#ifndef NDEBUG
+    if (validated.insert(pipeline).second)
+      checkPipeline(pipeline);
+#endif
+  }
+
+  size_t size() const { return pipelines.size(); }
+
+private:
+  std::map<std::pair<unsigned int, unsigned int>, unsigned int> pipelines;
+  std::set<unsigned int> validated; // pipelines already checked by bind
+
+  void checkPipeline(GLuint pipeline) {
+    GLint success;
+    GLchar infoLog[1024];
+    glValidateProgramPipeline(pipeline);
+    glGetProgramPipelineiv(pipeline, GL_VALIDATE_STATUS, &success);
+    if (!success) {
+      glGetProgramPipelineInfoLog(pipeline, 1024, NULL, infoLog);
+      std::cout
+          << "ERROR::PROGRAM_PIPELINE_VALIDATION_ERROR\n"
+          << infoLog
+          << "\n -- --------------------------------------------------- -- "
+          << std::endl;
+    }
+  }
+};
+#endif
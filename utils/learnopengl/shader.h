@@ -4,6 +4,9 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "learnopengl/gl_state.h"
+#include "learnopengl/uniform_cache.h"
+
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -37,61 +40,87 @@ public:
     glDeleteShader(vertex);
     glDeleteShader(fragment);
   }
+  // a copy would keep its own shadow copy of the uniforms, which would no
+  // longer match what the program holds as soon as either one uploads
+  Shader(const Shader &) = delete;
+  Shader &operator=(const Shader &) = delete;
   // activate the shader
   // ------------------------------------------------------------------------
-  void use() const { glUseProgram(ID); }
-  // utility uniform functions
+  void use() const { glState().useProgram(ID); }
+  // utility uniform functions, an upload is skipped when the uniform already
+  // holds the same value. They write to this program whichever program is
+  // bound (glProgramUniform*, GL 4.1)
   // ------------------------------------------------------------------------
   void setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    setInt(name, (int)value);
   }
   // ------------------------------------------------------------------------
   void setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &value, sizeof(value)))
+      glProgramUniform1i(ID, location, value);
   }
   // ------------------------------------------------------------------------
   void setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &value, sizeof(value)))
+      glProgramUniform1f(ID, location, value);
   }
   // ------------------------------------------------------------------------
   void setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &value[0], sizeof(value)))
+      glProgramUniform2fv(ID, location, 1, &value[0]);
   }
   void setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    setVec2(name, glm::vec2(x, y));
   }
   // ------------------------------------------------------------------------
   void setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &value[0], sizeof(value)))
+      glProgramUniform3fv(ID, location, 1, &value[0]);
   }
   void setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    setVec3(name, glm::vec3(x, y, z));
   }
   // ------------------------------------------------------------------------
   void setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &value[0], sizeof(value)))
+      glProgramUniform4fv(ID, location, 1, &value[0]);
   }
   void setVec4(const std::string &name, float x, float y, float z,
                float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    setVec4(name, glm::vec4(x, y, z, w));
   }
   // ------------------------------------------------------------------------
   void setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &mat[0][0], sizeof(mat)))
+      glProgramUniformMatrix2fv(ID, location, 1, GL_FALSE, &mat[0][0]);
   }
   // ------------------------------------------------------------------------
   void setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &mat[0][0], sizeof(mat)))
+      glProgramUniformMatrix3fv(ID, location, 1, GL_FALSE, &mat[0][0]);
   }
   // ------------------------------------------------------------------------
   void setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                       &mat[0][0]);
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    if (uniforms.update(location, &mat[0][0], sizeof(mat)))
+      glProgramUniformMatrix4fv(ID, location, 1, GL_FALSE, &mat[0][0]);
   }
+  // upload counters, to measure how much driver work the shadow copy saves
+  // ------------------------------------------------------------------------
+  unsigned int uniformUploads() const { return uniforms.uploads; }
+  unsigned int skippedUniformUploads() const { return uniforms.skippedUploads; }
 
 private:
+  // last value uploaded to each uniform of this program
+  mutable UniformCache uniforms;
+
   // utility function for checking shader compilation/linking errors.
   // ------------------------------------------------------------------------
   void checkCompileErrors(GLuint shader, std::string type) {
@@ -0,0 +1,63 @@
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <unordered_map>
+
+// Shadow copy of the values last uploaded to the uniforms of one program.
+// Uniforms are program state, so a value that didn't change since the last
+// upload doesn't need another glUniform* call.
+class UniformCache {
+public:
+  unsigned int uploads;        // glUniform* calls issued
+  unsigned int skippedUploads; // glUniform* calls skipped, value unchanged
+
+  UniformCache() : uploads(0), skippedUploads(0) {}
+
+  // compares the value with the shadow copy: returns true (and stores the new
+  // value) when it has to be uploaded, false when the upload can be skipped
+  // ------------------------------------------------------------------------
+  bool update(GLint location, const void *value, unsigned int size) {
+    // -1 is an inactive uniform, glUniform* would silently ignore it
+    if (location < 0 || size > MAX_VALUE_SIZE) {
+      if (location < 0)
+        skippedUploads++;
+      else
+        uploads++;
+      return location >= 0;
+    }
+
+    Value &current = values[location];
+    if (current.size == size && memcmp(current.data, value, size) == 0) {
+      skippedUploads++;
+      return false;
+    }
+    current.size = size;
+    memcpy(current.data, value, size);
+    uploads++;
+    return true;
+  }
+
+  // to be called when the program is relinked, locations and values are lost
+  void clear() { values.clear(); }
+
+  void resetCounters() {
+    uploads = 0;
+    skippedUploads = 0;
+  }
+
+private:
+  static const unsigned int MAX_VALUE_SIZE = 16 * sizeof(float); // a mat4
+
+  struct Value {
+    unsigned char data[MAX_VALUE_SIZE];
+    unsigned int size;
+
+    Value() : size(0) {}
+  };
+
+  std::unordered_map<GLint, Value> values;
+};
+#endif
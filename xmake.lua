@@ -1,7 +1,7 @@
 add_rules("mode.debug", "mode.release")
 
 add_requires("glfw", "stb", "glm", "assimp")
-add_requires("glad", {configs = {api = "gl=4.3", profile = "core", generator = "c"}})
+add_requires("glad", {configs = {api = "gl=4.4", profile = "core", generator = "c"}})
 add_includedirs("utils/")
 
 add_defines("PROJECT_ROOT_DIR=\"$(projectdir)/\"")